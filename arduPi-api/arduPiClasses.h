@@ -31,4 +31,5 @@
 #include "arduPiUtils.h" 
 #include "arduPiMultiprotocol.h"
 #include "arduPiUART.h" 
+#include "arduPiFrame.h"
 #endif
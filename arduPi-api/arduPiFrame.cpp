@@ -0,0 +1,462 @@
+/*
+ *  Copyright (C) 2015 Libelium Comunicaciones Distribuidas S.L.
+ *  http://www.libelium.com
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 2.1 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  Version:             1.8
+ *  Design:              David Gascon
+ *  Ported to Raspberry: Ruben Martin
+ */
+
+#ifndef __WPROGRAM_H__
+    #include "arduPiClasses.h"
+#endif
+
+#include "arduPiFrame.h"
+#include "arduPiUtils.h"
+
+
+arduPiFrame::arduPiFrame()
+{
+    _max = FRAME_MAX_SIZE;
+    clear();
+}
+
+
+/*
+ * 
+ * name: clear
+ * It empties the frame and clears the error flag
+ * 
+ */
+void arduPiFrame::clear()
+{
+    _length = 0;
+    _bits = 0;
+    _error = 0;
+}
+
+
+/*
+ * 
+ * name: setMaxSize
+ * @param   uint16_t size: maximum size of the frame
+ * @return  '0' if ok, '1' if error
+ */
+uint8_t arduPiFrame::setMaxSize(uint16_t size)
+{
+    if ((size > FRAME_MAX_SIZE) || (size < _length)) return 1;
+    
+    _max = size;
+    return 0;
+}
+
+
+uint8_t* arduPiFrame::getBuffer()
+{
+    return _buffer;
+}
+
+
+uint16_t arduPiFrame::getLength()
+{
+    return _length;
+}
+
+
+uint16_t arduPiFrame::getRemaining()
+{
+    return _max - _length;
+}
+
+
+uint8_t arduPiFrame::getError()
+{
+    return _error;
+}
+
+
+/*
+ * 
+ * name: toHex
+ * @param   char* str: destination
+ * @param   uint16_t size: size of 'str'
+ * @return  number of characters written, 0 if 'str' is too small
+ */
+uint16_t arduPiFrame::toHex(char* str, uint16_t size)
+{
+    return Utils.hexEncode(_buffer, _length, str, size);
+}
+
+
+/*
+ * 
+ * name: reserve
+ * This function makes room for a byte field. A bit field in progress is 
+ * closed, its unused bits stay at 0.
+ * 
+ * @param   uint16_t size: size of the field
+ * @return  pointer to the field, NULL if it does not fit
+ */
+uint8_t* arduPiFrame::reserve(uint16_t size)
+{
+    uint8_t* field;
+    
+    if (size > _max - _length)
+    {
+        _error = 1;
+        return NULL;
+    }
+    
+    _bits = 0;
+    field = &_buffer[_length];
+    _length += size;
+    
+    return field;
+}
+
+
+/*
+ * 
+ * name: reserveLPP
+ * This function makes room for a CayenneLPP field and writes its header
+ * 
+ * @param   uint8_t channel: channel of the field
+ * @param   uint8_t type: LPP type
+ * @param   uint16_t size: size of the value
+ * @return  pointer to the value, NULL if the field does not fit
+ */
+uint8_t* arduPiFrame::reserveLPP(uint8_t channel, uint8_t type, uint16_t size)
+{
+    uint8_t* field = reserve(2 + size);
+    
+    if (field == NULL) return NULL;
+    
+    field[0] = channel;
+    field[1] = type;
+    return field + 2;
+}
+
+
+uint8_t arduPiFrame::addUint8(uint8_t value)
+{
+    uint8_t* field = reserve(1);
+    
+    if (field == NULL) return 1;
+    field[0] = value;
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addUint16(uint16_t value)
+{
+    uint8_t* field = reserve(2);
+    
+    if (field == NULL) return 1;
+    field[0] = value >> 8;
+    field[1] = value;
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addUint32(uint32_t value)
+{
+    uint8_t* field = reserve(4);
+    
+    if (field == NULL) return 1;
+    field[0] = value >> 24;
+    field[1] = value >> 16;
+    field[2] = value >> 8;
+    field[3] = value;
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addInt8(int8_t value)
+{
+    return addUint8((uint8_t)value);
+}
+
+
+uint8_t arduPiFrame::addInt16(int16_t value)
+{
+    return addUint16((uint16_t)value);
+}
+
+
+uint8_t arduPiFrame::addInt32(int32_t value)
+{
+    return addUint32((uint32_t)value);
+}
+
+
+uint8_t arduPiFrame::addBytes(const uint8_t* data, uint16_t length)
+{
+    uint8_t* field = reserve(length);
+    
+    if (field == NULL) return 1;
+    memcpy(field, data, length);
+    return 0;
+}
+
+
+/*
+ * 
+ * name: addFixed
+ * @return  '0' if ok, '1' if the field does not fit or it was saturated
+ */
+uint8_t arduPiFrame::addFixed(double value, double resolution, uint8_t bytes, bool sign)
+{
+    uint8_t* field;
+    
+    if ((bytes < 1) || (bytes > 4)) return 1;
+    
+    field = reserve(bytes);
+    if (field == NULL) return 1;
+    
+    return Utils.packFixed(value, resolution, bytes, sign, field);
+}
+
+
+/*
+ * 
+ * name: addBits
+ * This function appends a bit field, MSB first. It continues the last byte 
+ * if the previous field was a bit field too.
+ * 
+ * @param   uint32_t value: the field, only its 'bits' lowest bits are used
+ * @param   uint8_t bits: size of the field in bits
+ * @return  '0' if ok, '1' if the field does not fit
+ */
+uint8_t arduPiFrame::addBits(uint32_t value, uint8_t bits)
+{
+    uint8_t room;
+    uint8_t n;
+    
+    if ((bits < 1) || (bits > 32)) return 1;
+    
+    // bits left in the last byte
+    room = (_bits == 0) ? 0 : 8 - _bits;
+    
+    if (bits > room + 8*(uint32_t)(_max - _length))
+    {
+        _error = 1;
+        return 1;
+    }
+    
+    while (bits > 0)
+    {
+        if (_bits == 0) _buffer[_length++] = 0;
+        
+        n = 8 - _bits;
+        if (n > bits) n = bits;
+        
+        _buffer[_length - 1] |= ((value >> (bits - n)) & ((1 << n) - 1)) << (8 - _bits - n);
+        
+        bits -= n;
+        _bits = (_bits + n) & 0x07;
+    }
+    
+    return 0;
+}
+
+
+/*
+ * 
+ * name: addVarint
+ * This function appends 'value' in groups of 7 bits, least significant 
+ * first. The highest bit of every byte but the last one is set.
+ * 
+ * @return  '0' if ok, '1' if the field does not fit
+ */
+uint8_t arduPiFrame::addVarint(uint32_t value)
+{
+    uint8_t* field;
+    uint8_t size = 1;
+    
+    for (uint32_t aux = value >> 7; aux != 0; aux >>= 7) size++;
+    
+    field = reserve(size);
+    if (field == NULL) return 1;
+    
+    for (uint8_t i = 0; i < size - 1; i++)
+    {
+        field[i] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    field[size - 1] = value;
+    
+    return 0;
+}
+
+
+/*
+ * 
+ * name: addSignedVarint
+ * This function maps 0, -1, 1, -2... to 0, 1, 2, 3... before encoding
+ * 
+ */
+uint8_t arduPiFrame::addSignedVarint(int32_t value)
+{
+    return addVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+
+/*
+ * 
+ * name: addDelta
+ * @param   int32_t value: the new value
+ * @param   int32_t* reference: the previous value, updated if ok
+ * @return  '0' if ok, '1' if the field does not fit
+ */
+uint8_t arduPiFrame::addDelta(int32_t value, int32_t* reference)
+{
+    // the difference wraps around like the receiver's sum does
+    if (addSignedVarint((int32_t)((uint32_t)value - (uint32_t)*reference)) != 0) return 1;
+    
+    *reference = value;
+    return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CayenneLPP fields
+
+
+uint8_t arduPiFrame::addDigitalInput(uint8_t channel, uint8_t value)
+{
+    uint8_t* field = reserveLPP(channel, LPP_DIGITAL_INPUT, 1);
+    
+    if (field == NULL) return 1;
+    field[0] = value;
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addDigitalOutput(uint8_t channel, uint8_t value)
+{
+    uint8_t* field = reserveLPP(channel, LPP_DIGITAL_OUTPUT, 1);
+    
+    if (field == NULL) return 1;
+    field[0] = value;
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addAnalogInput(uint8_t channel, float value)
+{
+    uint8_t* field = reserveLPP(channel, LPP_ANALOG_INPUT, 2);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(value, 0.01, 2, true, field);
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addAnalogOutput(uint8_t channel, float value)
+{
+    uint8_t* field = reserveLPP(channel, LPP_ANALOG_OUTPUT, 2);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(value, 0.01, 2, true, field);
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addLuminosity(uint8_t channel, uint16_t lux)
+{
+    uint8_t* field = reserveLPP(channel, LPP_LUMINOSITY, 2);
+    
+    if (field == NULL) return 1;
+    field[0] = lux >> 8;
+    field[1] = lux;
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addPresence(uint8_t channel, uint8_t value)
+{
+    uint8_t* field = reserveLPP(channel, LPP_PRESENCE, 1);
+    
+    if (field == NULL) return 1;
+    field[0] = value;
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addTemperature(uint8_t channel, float celsius)
+{
+    uint8_t* field = reserveLPP(channel, LPP_TEMPERATURE, 2);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(celsius, 0.1, 2, true, field);
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addRelativeHumidity(uint8_t channel, float rh)
+{
+    uint8_t* field = reserveLPP(channel, LPP_RELATIVE_HUMIDITY, 1);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(rh, 0.5, 1, false, field);
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addAccelerometer(uint8_t channel, float x, float y, float z)
+{
+    uint8_t* field = reserveLPP(channel, LPP_ACCELEROMETER, 6);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(x, 0.001, 2, true, &field[0]);
+    Utils.packFixed(y, 0.001, 2, true, &field[2]);
+    Utils.packFixed(z, 0.001, 2, true, &field[4]);
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addBarometricPressure(uint8_t channel, float hpa)
+{
+    uint8_t* field = reserveLPP(channel, LPP_BAROMETRIC_PRESSURE, 2);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(hpa, 0.1, 2, false, field);
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addGyrometer(uint8_t channel, float x, float y, float z)
+{
+    uint8_t* field = reserveLPP(channel, LPP_GYROMETER, 6);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(x, 0.01, 2, true, &field[0]);
+    Utils.packFixed(y, 0.01, 2, true, &field[2]);
+    Utils.packFixed(z, 0.01, 2, true, &field[4]);
+    return 0;
+}
+
+
+uint8_t arduPiFrame::addGPS(uint8_t channel, float latitude, float longitude, float meters)
+{
+    uint8_t* field = reserveLPP(channel, LPP_GPS, 9);
+    
+    if (field == NULL) return 1;
+    Utils.packFixed(latitude, 0.0001, 3, true, &field[0]);
+    Utils.packFixed(longitude, 0.0001, 3, true, &field[3]);
+    Utils.packFixed(meters, 0.01, 3, true, &field[6]);
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*! \file arduPiFrame.h
+    \brief Library for building compact binary frames for radio payloads
+    
+    Copyright (C) 2015 Libelium Comunicaciones Distribuidas S.L.
+    http://www.libelium.com
+ 
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 2.1 of the License, or
+    (at your option) any later version.
+   
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+  
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+    Version:             1.8
+    Design:              David Gascon
+    Ported to Raspberry: Ruben Martin
+*/
+ 
+#ifndef arduPiFrame_h
+#define arduPiFrame_h
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+#include <inttypes.h>
+
+
+/******************************************************************************
+ * Definitions & Declarations
+ ******************************************************************************/
+
+//! Maximum size of a frame, the largest LoRaWAN payload
+#define FRAME_MAX_SIZE              242
+
+/*! \def FRAME_SIZE_SIGFOX
+    \brief maximum payload of arduPiSigfox::send
+*/
+/*! \def FRAME_SIZE_LORAWAN
+    \brief maximum payload of arduPiLoRaWAN at the lowest data rate
+*/
+#define FRAME_SIZE_SIGFOX           12
+#define FRAME_SIZE_LORAWAN          51
+
+//! CayenneLPP data types
+#define LPP_DIGITAL_INPUT           0
+#define LPP_DIGITAL_OUTPUT          1
+#define LPP_ANALOG_INPUT            2
+#define LPP_ANALOG_OUTPUT           3
+#define LPP_LUMINOSITY              101
+#define LPP_PRESENCE                102
+#define LPP_TEMPERATURE             103
+#define LPP_RELATIVE_HUMIDITY       104
+#define LPP_ACCELEROMETER           113
+#define LPP_BAROMETRIC_PRESSURE     115
+#define LPP_GYROMETER               134
+#define LPP_GPS                     136
+
+
+/******************************************************************************
+ * Class
+ ******************************************************************************/
+ 
+//! arduPiFrame Class
+/*!
+    Builds a binary frame field by field. Integer fields are big endian, 
+    bit fields are packed MSB first and the next byte field starts at a byte 
+    boundary. A field is written completely or not at all: the add functions 
+    return '1' and write nothing when the field does not fit, and getError 
+    reports it until clear is called.
+    
+    The frame can be sent as is with arduPiSigfox::send(uint8_t*, uint16_t), 
+    or converted with toHex for the functions that take hexadecimal strings, 
+    e.g. arduPiLoRaWAN::sendUnconfirmed.
+ */
+class arduPiFrame
+{
+
+private:
+
+    uint8_t     _buffer[FRAME_MAX_SIZE];
+    //! bytes used, including the last byte of a bit field
+    uint16_t    _length;
+    //! bits used in the last byte, 0 if the frame ends at a byte boundary
+    uint8_t     _bits;
+    //! maximum size set by setMaxSize
+    uint16_t    _max;
+    //! '1' if a field did not fit
+    uint8_t     _error;
+    
+    uint8_t* reserve(uint16_t size);
+    uint8_t* reserveLPP(uint8_t channel, uint8_t type, uint16_t size);
+
+public:
+
+    arduPiFrame();
+    
+    //! It empties the frame and clears the error
+    void clear();
+    
+    //! It limits the size of the frame
+    /*!
+    \param uint16_t size : e.g. FRAME_SIZE_SIGFOX, up to FRAME_MAX_SIZE
+    \return '0' if ok, '1' if 'size' is too big or smaller than the frame
+    */
+    uint8_t setMaxSize(uint16_t size);
+    
+    //! It gets the frame
+    uint8_t* getBuffer();
+    //! It gets the size of the frame in bytes
+    uint16_t getLength();
+    //! It gets the bytes that can still be added
+    uint16_t getRemaining();
+    //! It gets '1' if a field did not fit since the last clear
+    uint8_t getError();
+    
+    //! It converts the frame to a hexadecimal string
+    /*!
+    \param char* str : destination, 2*getLength()+1 bytes are needed
+    \param uint16_t size : size of 'str'
+    \return number of characters written, 0 if 'str' is too small
+    */
+    uint16_t toHex(char* str, uint16_t size);
+    
+    //! Raw fields
+    /*!
+    \return '0' if ok, '1' if the field does not fit
+    */
+    uint8_t addUint8(uint8_t value);
+    uint8_t addUint16(uint16_t value);
+    uint8_t addUint32(uint32_t value);
+    uint8_t addInt8(int8_t value);
+    uint8_t addInt16(int16_t value);
+    uint8_t addInt32(int32_t value);
+    uint8_t addBytes(const uint8_t* data, uint16_t length);
+    
+    //! It adds a fixed point field
+    /*!
+    \param double value : the number
+    \param double resolution : value of the least significant bit
+    \param uint8_t bytes : size of the field, from 1 to 4
+    \param bool sign : true for two's complement, false for unsigned
+    \return '0' if ok, '1' if the field does not fit or the value was 
+    saturated
+    \sa arduPiUtils::packFixed
+    */
+    uint8_t addFixed(double value, double resolution, uint8_t bytes, bool sign);
+    
+    //! It adds the 'bits' least significant bits of 'value'
+    /*!
+    \param uint32_t value : the field
+    \param uint8_t bits : from 1 to 32
+    \return '0' if ok, '1' if the field does not fit
+    */
+    uint8_t addBits(uint32_t value, uint8_t bits);
+    
+    //! It adds a variable length integer, 7 bits per byte
+    /*!
+    Values below 128 take 1 byte, below 16384 take 2 bytes and so on.
+    \return '0' if ok, '1' if the field does not fit
+    */
+    uint8_t addVarint(uint32_t value);
+    
+    //! It adds a signed variable length integer (zigzag encoding)
+    /*!
+    Small negative values are as short as small positive ones.
+    \return '0' if ok, '1' if the field does not fit
+    */
+    uint8_t addSignedVarint(int32_t value);
+    
+    //! It adds the difference with a reference value as a signed varint
+    /*!
+    \param int32_t value : the new value
+    \param int32_t* reference : the previous value, it is updated to 'value' 
+    when the field is added
+    \return '0' if ok, '1' if the field does not fit
+    */
+    uint8_t addDelta(int32_t value, int32_t* reference);
+    
+    //! CayenneLPP fields: channel, type and the value
+    /*!
+    Values out of the range of the type are saturated.
+    \return '0' if ok, '1' if the field does not fit
+    */
+    uint8_t addDigitalInput(uint8_t channel, uint8_t value);
+    uint8_t addDigitalOutput(uint8_t channel, uint8_t value);
+    uint8_t addAnalogInput(uint8_t channel, float value);
+    uint8_t addAnalogOutput(uint8_t channel, float value);
+    uint8_t addLuminosity(uint8_t channel, uint16_t lux);
+    uint8_t addPresence(uint8_t channel, uint8_t value);
+    uint8_t addTemperature(uint8_t channel, float celsius);
+    uint8_t addRelativeHumidity(uint8_t channel, float rh);
+    uint8_t addAccelerometer(uint8_t channel, float x, float y, float z);
+    uint8_t addBarometricPressure(uint8_t channel, float hpa);
+    uint8_t addGyrometer(uint8_t channel, float x, float y, float z);
+    uint8_t addGPS(uint8_t channel, float latitude, float longitude, float meters);
+};
+
+#endif
@@ -12,8 +12,10 @@
  ****************************************************/
 
 #include "arduPiMultiprotocol.h"
+#include "arduPiUART.h"
 
 mp_MCP23008 mp;
+mp_Shield mpShield;
 ////////////////////////////////////////////////////////////////////////////////
 // Multiprotocol Shield v2.0 implementation
 
@@ -23,23 +25,20 @@ void mp_MCP23008::begin(uint8_t addr) {
   }
   i2caddr = addr;
 
+  Wire.lock();
   Wire.begin();
 
-  // set defaults!
+  // set defaults! IODIR all inputs, then IPOL to OLAT cleared. The
+  // register pointer increments, so they go out in a single I2C write
+  char defaults[11] = {MCP23008_IODIR, (char)0xFF, 0, 0, 0, 0, 0, 0, 0, 0, 0};
   Wire.beginTransmission(MCP23008_ADDRESS | i2caddr);
-  Wire.write((byte)MCP23008_IODIR);
-  Wire.write((byte)0xFF);  // all inputs
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);
-  Wire.write((byte)0x00);	
+  Wire.write(defaults, sizeof(defaults));
   Wire.endTransmission();
 
+  iodir = 0xFF;
+  gppu = 0x00;
+  olat = 0x00;
+  Wire.unlock();
 }
 
 void mp_MCP23008::begin(void) {
@@ -47,14 +46,12 @@ void mp_MCP23008::begin(void) {
 }
 
 void mp_MCP23008::pinMode(uint8_t p, uint8_t d) {
-  uint8_t iodir;
-  
-
   // only 8 bits!
   if (p > 7)
     return;
-  
-  iodir = read8(MCP23008_IODIR);
+
+  // the copy and the register change together, Wire.lock() is recursive
+  Wire.lock();
 
   // set the pin and direction
   if (d == INPUT) {
@@ -65,6 +62,7 @@ void mp_MCP23008::pinMode(uint8_t p, uint8_t d) {
 
   // write the new IODIR
   write8(MCP23008_IODIR, iodir);
+  Wire.unlock();
 }
 
 uint8_t mp_MCP23008::readGPIO(void) {
@@ -73,39 +71,43 @@ uint8_t mp_MCP23008::readGPIO(void) {
 }
 
 void mp_MCP23008::writeGPIO(uint8_t gpio) {
-  write8(MCP23008_GPIO, gpio);
+  // writing GPIO sets the output latches
+  Wire.lock();
+  olat = gpio;
+  write8(MCP23008_OLAT, olat);
+  Wire.unlock();
 }
 
 
 void mp_MCP23008::digitalWrite(uint8_t p, uint8_t d) {
-  uint8_t gpio;
-  
   // only 8 bits!
   if (p > 7)
     return;
 
-  // read the current GPIO output latches
-  gpio = readGPIO();
+  writePins(1 << p, (d == HIGH) ? 0xFF : 0x00);
+}
 
-  // set the pin and direction
-  if (d == HIGH) {
-    gpio |= 1 << p; 
-  } else {
-    gpio &= ~(1 << p);
-  }
+void mp_MCP23008::writePins(uint8_t mask, uint8_t values) {
+  uint8_t latch;
 
-  // write the new GPIO
-  writeGPIO(gpio);
+  // the output latches are known, no need to read them back. Other
+  // threads must not change them between the copy and the write
+  Wire.lock();
+  latch = (olat & ~mask) | (values & mask);
+  if (latch != olat) {
+    olat = latch;
+    write8(MCP23008_OLAT, olat);
+  }
+  Wire.unlock();
 }
 
 void mp_MCP23008::pullUp(uint8_t p, uint8_t d) {
-  uint8_t gppu;
-  
   // only 8 bits!
   if (p > 7)
     return;
 
-  gppu = read8(MCP23008_GPPU);
+  Wire.lock();
+
   // set the pin and direction
   if (d == HIGH) {
     gppu |= 1 << p; 
@@ -114,6 +116,7 @@ void mp_MCP23008::pullUp(uint8_t p, uint8_t d) {
   }
   // write the new GPIO
   write8(MCP23008_GPPU, gppu);
+  Wire.unlock();
 }
 
 uint8_t mp_MCP23008::digitalRead(uint8_t p) {
@@ -126,20 +129,181 @@ uint8_t mp_MCP23008::digitalRead(uint8_t p) {
 }
 
 uint8_t mp_MCP23008::read8(uint8_t addr) {
+  uint8_t data;
+
+  // other threads must not change the address in the middle
+  Wire.lock();
   Wire.beginTransmission(MCP23008_ADDRESS | i2caddr);
   Wire.write((byte)addr);	
   Wire.endTransmission();
   Wire.requestFrom(MCP23008_ADDRESS | i2caddr, 1);
+  data = Wire.read();
+  Wire.unlock();
 
-  return Wire.read();
+  return data;
 }
 
 
 void mp_MCP23008::write8(uint8_t addr, uint8_t data) {
+  // each Wire.write() is a whole transfer, the register pointer and the
+  // value must go in the same one
+  char buf[2] = {(char)addr, (char)data};
+
+  Wire.lock();
   Wire.beginTransmission(MCP23008_ADDRESS | i2caddr);
-  Wire.write((byte)addr);
-  Wire.write((byte)data);
+  Wire.write(buf, 2);
   Wire.endTransmission();
+  Wire.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Multiprotocol Radio Shield v2.0 state
+
+mp_Shield::mp_Shield() {
+  pthread_mutexattr_t attr;
+
+  ready = false;
+  power = 0;
+  uart = MP_MUX_NONE;
+  scheduler = NULL;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+void mp_Shield::begin(void) {
+  pthread_mutex_lock(&mutex);
+  if (ready) {
+    pthread_mutex_unlock(&mutex);
+    return;
+  }
+
+  // the expander takes each write at once, no settle time is needed
+  mp.begin();
+
+  // I/O configuration
+  mp.pinMode(0, OUTPUT);
+  mp.pinMode(1, OUTPUT);
+  mp.pinMode(2, OUTPUT);
+  mp.pinMode(3, OUTPUT);
+  mp.pinMode(4, OUTPUT);
+  mp.pinMode(5, OUTPUT);
+  mp.pinMode(6, INPUT);
+  mp.pinMode(7, OUTPUT);
+
+  // Initial State: sockets off, CS released, multiplexer disabled
+  // (0, 1, 2 and 5 LOW; 3, 4 and 7 HIGH, 6 is an input)
+  mp.writePins(0xBF, 0x98);
+
+  power = 0;
+  uart = MP_MUX_NONE;
+  ready = true;
+  pthread_mutex_unlock(&mutex);
+}
+
+uint8_t mp_Shield::setPower(uint8_t socket, uint8_t state) {
+  uint8_t mask = 1 << socket;
+  uint8_t pin = (socket == 0) ? MP_PW_SOCKET0 : MP_PW_SOCKET1;
+
+  if (socket > 1)
+    return 0;
+
+  pthread_mutex_lock(&mutex);
+  begin();
+
+  if (((power & mask) != 0) == (state == HIGH)) {
+    pthread_mutex_unlock(&mutex);
+    return 0;
+  }
+
+  mp.digitalWrite(pin, state);
+  if (state == HIGH) {
+    power |= mask;
+  } else {
+    power &= ~mask;
+  }
+  pthread_mutex_unlock(&mutex);
+  return 1;
+}
+
+uint8_t mp_Shield::getPower(uint8_t socket) {
+  if (socket > 1)
+    return 0;
+
+  return (power >> socket) & 0x1;
+}
+
+void mp_Shield::selectUART(uint8_t socket) {
+  if (socket > 1)
+    return;
+
+  pthread_mutex_lock(&mutex);
+  begin();
+
+  if (uart != socket) {
+    // enable and select in one write
+    mp.writePins((1 << MP_MUX_ENABLE) | (1 << MP_MUX_SELECT), 
+                 (socket == 0) ? 0x00 : (1 << MP_MUX_SELECT));
+    delayMicroseconds(MP_MUX_SETTLE_US);
+    uart = socket;
+  }
+  pthread_mutex_unlock(&mutex);
 }
 
+void mp_Shield::disableUART(void) {
+  pthread_mutex_lock(&mutex);
+  begin();
+
+  if (uart != MP_MUX_NONE) {
+    mp.digitalWrite(MP_MUX_ENABLE, HIGH);
+    uart = MP_MUX_NONE;
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+int8_t mp_Shield::getUART(void) {
+  return uart;
+}
 
+void mp_Shield::setScheduler(arduPiUARTScheduler *s) {
+  scheduler = s;
+  if (s != NULL)
+    s->setSelect(mpSelectUART);
+}
+
+void mp_Shield::lock(uint8_t socket) {
+  // the scheduler thread takes 'mutex' to switch the mux, so a user
+  // waiting for a scheduled command must not hold it
+  if (scheduler != NULL) {
+    scheduler->holdSocket(socket);
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  selectUART(socket);
+}
+
+void mp_Shield::unlock(uint8_t socket) {
+  if (scheduler != NULL) {
+    scheduler->releaseSocket(socket);
+    return;
+  }
+
+  pthread_mutex_unlock(&mutex);
+}
+
+mp_UARTGuard::mp_UARTGuard(uint8_t s) {
+  socket = s;
+  mpShield.lock(socket);
+}
+
+mp_UARTGuard::~mp_UARTGuard() {
+  mpShield.unlock(socket);
+}
+
+void mpSelectUART(uint8_t socket) {
+  mpShield.selectUART(socket);
+}
@@ -17,6 +17,8 @@
 #include <inttypes.h>
 #include "../arduPi/arduPi.h" 
 
+class arduPiUARTScheduler;
+
 class mp_MCP23008 {
 public:
 
@@ -30,8 +32,17 @@ public:
   uint8_t readGPIO(void);
   void writeGPIO(uint8_t);
 
+  // changes the outputs in 'mask' to the bits of 'values' in one I2C write
+  void writePins(uint8_t mask, uint8_t values);
+
  private:
   uint8_t i2caddr;
+
+  // copies of the registers written, so pins change without reading them.
+  // They are read and written under Wire.lock()
+  uint8_t iodir;
+  uint8_t gppu;
+  uint8_t olat;
   uint8_t read8(uint8_t addr);
   void write8(uint8_t addr, uint8_t data);
 };
@@ -51,7 +62,80 @@ public:
 #define MCP23008_GPIO 0x09
 #define MCP23008_OLAT 0x0A
 
+// Multiprotocol Radio Shield v2.0 expander pins
+#define MP_PW_SOCKET1 0
+#define MP_PW_SOCKET0 1
+#define MP_CS_SOCKET1 2
+#define MP_CS_SOCKET0 3
+#define MP_MUX_ENABLE 4   // active LOW
+#define MP_MUX_SELECT 5   // LOW: SOCKET0, HIGH: SOCKET1
+
+// Time for the UART multiplexer to switch (us). The analog switch needs 
+// less than a microsecond, the margin covers the lines charging to the 
+// new level
+#define MP_MUX_SETTLE_US 10
+
+// UART multiplexer disabled
+#define MP_MUX_NONE -1
+
+
+// Owner of the Multiprotocol Radio Shield v2.0: it initializes the expander
+// once, remembers the power and multiplexer state so only real changes are
+// written, and serializes the users of the shared UART.
+class mp_Shield {
+public:
+  mp_Shield();
+
+  // initializes the expander the first time it is called
+  void begin(void);
+
+  // switches the power of SOCKET0/SOCKET1, returns 1 if it changed
+  uint8_t setPower(uint8_t socket, uint8_t state);
+  uint8_t getPower(uint8_t socket);
+
+  // connects the UART to SOCKET0/SOCKET1, only if it is not already
+  void selectUART(uint8_t socket);
+  void disableUART(void);
+  // socket connected to the UART, MP_MUX_NONE if disabled
+  int8_t getUART(void);
+
+  // hands the multiplexer to a scheduler: it switches the mux before the
+  // commands of each socket, and lock/unlock become its hold/release
+  void setScheduler(arduPiUARTScheduler *s);
+
+  // waits until no other user owns the UART and connects it to 'socket'.
+  // It can be nested by the same thread. With a scheduler the mux is
+  // switched by the next command of 'socket'
+  void lock(uint8_t socket);
+  void unlock(uint8_t socket);
+
+ private:
+  bool ready;
+  uint8_t power;
+  int8_t uart;
+  pthread_mutex_t mutex;
+  arduPiUARTScheduler *scheduler;
+};
+
+// Scoped ownership of the shared UART, e.g.
+//   { mp_UARTGuard guard(SOCKET1); LoRaWAN.sendUnconfirmed(...); }
+class mp_UARTGuard {
+public:
+  mp_UARTGuard(uint8_t socket);
+  ~mp_UARTGuard();
+
+ private:
+  uint8_t socket;
+
+  mp_UARTGuard(const mp_UARTGuard&);
+  mp_UARTGuard& operator=(const mp_UARTGuard&);
+};
+
 
 extern mp_MCP23008 mp;
+extern mp_Shield mpShield;
+
+// Selector for arduPiUARTScheduler::setSelect, switches the mux of mpShield
+void mpSelectUART(uint8_t socket);
 
 #endif
@@ -26,6 +26,21 @@
 #endif
 
 #include "arduPiUART.h"
+#include <math.h>
+
+
+/*
+ * 
+ * name: ~arduPiUART
+ * It stops the queue, leaves the scheduler and frees the response buffer
+ * 
+ */
+arduPiUART::~arduPiUART()
+{
+    endQueue();
+    if (_scheduler != NULL) _scheduler->detach(this);
+    free(_buffer);
+}
 
 
 /*
@@ -63,6 +78,13 @@ void arduPiUART::setBaudrate(uint32_t baudrate)
  */
 void arduPiUART::beginUART()
 {
+    // the scheduler opens the shared uart when it runs a command
+    if (_scheduler != NULL)
+    {
+        _scheduler->open(this);
+        return;
+    }
+    
     // open UART
     beginSerial(_baudrate, _uart); 
 }
@@ -77,12 +99,38 @@ void arduPiUART::beginUART()
  */
 void arduPiUART::closeUART()
 {
+    // finish the queued commands before closing
+    endQueue();
+    
+    // the other socket may still be using the shared uart
+    if (_scheduler != NULL)
+    {
+        _scheduler->close(this);
+        return;
+    }
+    
     // close UART
     closeSerial(_uart); 
     
 }
 
 
+/*
+ * 
+ * name: serialPort
+ * The scheduler connects the single uart of the Raspberry Pi to the socket 
+ * of this object before running its commands, so an attached object always 
+ * uses UART0
+ * 
+ * @return  port for the transport functions
+ */
+uint8_t arduPiUART::serialPort()
+{
+    if (_scheduler != NULL) return UART0;
+    return _uart;
+}
+
+
 /*
  * 
  * name: setTimeout
@@ -112,7 +160,8 @@ uint32_t arduPiUART::getTimeout()
 /*
  * 
  * name: setDelay
- * @param uint32_t newDelay: new default delay time to wait after command query
+ * @param uint32_t newDelay: minimum time (ms) between the last command or 
+ *                           answer and the next command. '0' disables the gap
  * @return void
  * 
  */
@@ -126,7 +175,7 @@ void arduPiUART::setDelay(uint32_t newDelay)
  * 
  * name: getDelay
  * @param void
- * @return _def_timeout attribute
+ * @return _def_delay attribute
  * 
  */
 uint32_t arduPiUART::getDelay()
@@ -135,6 +184,55 @@ uint32_t arduPiUART::getDelay()
 }
 
 
+/*
+ * 
+ * name: setIdleTimeout
+ * @param uint32_t newTimeout: time (ms) without receiving bytes that ends 
+ *                             readBuffer before all the bytes are read
+ * @return void
+ * 
+ */
+void arduPiUART::setIdleTimeout(uint32_t newTimeout)
+{
+    _idle_timeout = newTimeout;
+}
+
+
+/*
+ * 
+ * name: getIdleTimeout
+ * @param void
+ * @return _idle_timeout attribute
+ * 
+ */
+uint32_t arduPiUART::getIdleTimeout()
+{
+    return _idle_timeout;
+}
+
+
+/*
+ * 
+ * name: setAdaptiveTimeout
+ * @param   uint8_t factor: multiple of the p99 latency, '0' to disable
+ * @param   uint32_t minimum: lowest timeout (ms)
+ * @param   uint16_t samples: answers needed before a timeout is adapted
+ * @return void
+ * 
+ */
+void arduPiUART::setAdaptiveTimeout(uint8_t factor, uint32_t minimum, uint16_t samples)
+{
+    _adaptive_factor = factor;
+    _adaptive_minimum = minimum;
+    _adaptive_samples = samples;
+}
+
+void arduPiUART::setAdaptiveTimeout(uint8_t factor)
+{
+    setAdaptiveTimeout(factor, DEF_ADAPTIVE_MINIMUM, DEF_ADAPTIVE_SAMPLES);
+}
+
+
 /*
  * 
  * name: sendCommand
@@ -223,116 +321,56 @@ uint8_t  arduPiUART::sendCommand(char* command,
                                  char* ans4, 
                                  uint32_t timeout)
 {
-    // index counter
-    uint16_t i = 0;
+    char* answers[4] = { ans1, ans2, ans3, ans4 };
     
-    #if DEBUG_UART > 0
-        printf("[debug] cmd:");  printf(command); printf("\n");     
-    #endif
+    return sendCommand(command, answers, 4, timeout);
+}
 
-    #if DEBUG_UART > 1
-        printf("[debug] ans1:"); printf(ans1); printf("\n");    
-        if(ans2!=NULL) { printf("[debug] ans2:"); printf(ans2);printf("\n");}
-        if(ans3!=NULL) { printf("[debug] ans3:"); printf(ans3);printf("\n");}
-        if(ans4!=NULL) { printf("[debug] ans4:"); printf(ans4);printf("\n");}
-    #endif
+
+/*
+ * 
+ * name: sendCommand
+ * @param   char* command: command to be sent
+ * @param   char** answers: expected answers (NULL entries are skipped)
+ * @param   uint8_t count: number of entries in answers
+ * @param   uint32_t timeout: time to wait for response
+ * @return  '0' if timeout error, 
+ *          'n' if answers[n-1]
+ * 
+ */
+uint8_t  arduPiUART::sendCommand(char* command, 
+                                 char** answers, 
+                                 uint8_t count, 
+                                 uint32_t timeout)
+{
+    struct ATCommand cmd;
     
-    // clear uart buffer before sending command
-    if( _flush_mode == true )
-    {
-        serialFlush(_uart);         
-    }
+    // clear _buffer, it grows while the answer is received
+    _length = 0;
+    _buffer[0] = 0x00;
     
-    /// 1. print command
-    printString( command, _uart ); 
-    delay( _def_delay );
+    memset( &cmd, 0x00, sizeof(cmd) );
+    cmd.command = command;
+    cmd.answers = answers;
+    cmd.count   = count;
+    cmd.timeout = timeout;
+    cmd.rbuf    = _buffer;
+    cmd.rsize   = _capacity-1;
     
-    /// 2. read answer  
-    // clear _buffer
-    memset( _buffer, 0x00, sizeof(_buffer) );
-    _length = 0;
+    /// send command (if any) and read answer as soon as it arrives
+    execute(&cmd);
     
-    // get actual instant
-    unsigned long previous = millis();
+    _length = cmd.length;
+    _buffer[_length] = 0x00;
     
-    // check available data for 'timeout' milliseconds
-    while( (millis() - previous) < timeout )
-    {
-
-        if( serialAvailable(_uart) )
-        {
-            if ( i < (sizeof(_buffer)-1) )
-            {   
-                _buffer[i++] = serialRead(_uart);               
-                _length++;          
-            }
-        }
-            
-        // Check 'ans1'
-        if( find( _buffer, _length, ans1 ) == true )
-        {       
-            #if DEBUG_UART > 0
-                printf("[debug] ans:"); 
-                printf( ans1 );
-                printf("\n");    
-            #endif      
-            return 1;
-        }
-        
-        // Check 'ans2'
-        if( ans2 != NULL )
-        {
-            if( find( _buffer, _length, ans2 ) == true )
-            {   
-                #if DEBUG_UART > 0
-                    printf("[debug] ans:"); 
-                    printf( ans2 ); 
-                    printf("\n");
-                #endif          
-                return 2;
-            }
-        }
-        
-        // Check 'ans3'
-        if( ans3 != NULL )
-        {
-            if( find( _buffer, _length, ans3 ) == true )
-            {   
-                #if DEBUG_UART > 0
-                    printf("[debug] ans:"); 
-                    printf( ans3 ); 
-                    printf("\n");
-                #endif              
-                return 3;
-            }
-        }
-        
-        // Check 'ans4'
-        if( ans4 != NULL )
-        {
-            if( find( _buffer, _length, ans4 ) == true )
-            {   
-                #if DEBUG_UART > 0
-                    printf("[debug] ans:"); 
-                    printf( ans4 ); 
-                    printf("\n");
-                #endif          
-                return 4;
-            }
-        }   
-        
-        // Condition to avoid an overflow (DO NOT REMOVE)
-        if( millis() < previous) previous = millis();
-    }
-        
-    // timeout
-    #if DEBUG_UART > 0
-        printf("[debug] no answer\n");
-    #endif  
-    #if DEBUG_UART > 1
-        printf("[debug] _buffer: %s\n", _buffer);
-    #endif  
-    return 0; 
+    _result.answer = cmd.answer;
+    _result.cme = cmd.cme;
+    _result.cms = cmd.cms;
+    _result.response.data = _buffer;
+    _result.response.length = _length;
+    _result.elapsed = cmd.elapsed;
+    
+    return cmd.answer;
 }
 
 
@@ -349,12 +387,13 @@ uint8_t  arduPiUART::sendCommand(char* command,
 bool arduPiUART::find( uint8_t* buffer, uint16_t length, char* pattern )
 {
     int result;
+    size_t patternLength = strlen(pattern);
     
-    if( length >= strlen(pattern) )
+    if( length >= patternLength )
     {       
-        for(uint16_t i = 0; i <= length-strlen(pattern); i++)
+        for(uint16_t i = 0; i <= length-patternLength; i++)
         {
-            result = memcmp( &buffer[i], pattern, strlen(pattern) );
+            result = memcmp( &buffer[i], pattern, patternLength );
             
             if( result == 0 )
             {
@@ -376,19 +415,16 @@ bool arduPiUART::find( uint8_t* buffer, uint16_t length, char* pattern )
  */
 void  arduPiUART::sendCommand( uint8_t* command, uint16_t length )
 {   
-    // clear uart buffer before sending command
-    if( _flush_mode == true )
-    {
-        serialFlush(_uart);         
-    }
+    struct ATCommand cmd;
     
-    /// print command
-    for (uint16_t i = 0; i < length; i++)
-    {
-        printByte(command[i], _uart); 
-    }   
-
-    delay( _def_delay );    
+    if (length == 0) return;
+    
+    /// print command, nothing is read
+    memset( &cmd, 0x00, sizeof(cmd) );
+    cmd.command = (char*)command;
+    cmd.clength = length;
+    
+    execute(&cmd);
 }
 
 
@@ -455,7 +491,6 @@ uint8_t arduPiUART::waitFor(char* ans1,
  * name: waitFor
  * @brief   This function waits for one of the answers during a certain period 
  *          of time. The result is stored in '_buffer'.
- * @param   char* command: command to be sent
  * @param   char* ans1: expected answer
  * @param   char* ans2: expected answer
  * @param   char* ans3: expected answer
@@ -472,79 +507,31 @@ uint8_t  arduPiUART::waitFor(char* ans1,
                              char* ans4, 
                              uint32_t timeout)
 { 
-    // index counter
-    uint16_t i = 0;
-    
-    // clear _buffer
-    memset( _buffer, 0x00, sizeof(_buffer) );
-    _length = 0;
-    
-    // get actual instant
-    unsigned long previous = millis();
+    char* answers[4] = { ans1, ans2, ans3, ans4 };
     
-    // check available data for 'timeout' milliseconds
-    while( (millis() - previous) < timeout )
-    {
-        if( serialAvailable((_uart)) )
-        {
-            if ( i < (sizeof(_buffer)-1) )
-            {   
-                _buffer[i++] = serialRead(_uart);               
-                _length++;              
-            }
-        }
-            
-        // Check 'ans1'
-        if( find( _buffer, _length, ans1 ) == true )
-        {       
-            #if DEBUG_UART > 0
-                printf("[debug] found: %s\n", ans1);   
-            #endif      
-            return 1;
-        }
-        
-        // Check 'ans2'
-        if( ans2 != NULL )
-        {
-            if( find( _buffer, _length, ans2 ) == true )
-            {   
-                #if DEBUG_UART > 0
-                    printf("[debug] found: %s\n", ans2);   
-                #endif      
-                return 2;
-            }
-        }
-        
-        // Check 'ans3'
-        if( ans3 != NULL )
-        {
-            if( find( _buffer, _length, ans3 ) == true )
-            {   
-                #if DEBUG_UART > 0
-                    printf("[debug] found: %s\n", ans3);   
-                #endif          
-                return 3;
-            }
-        }
-        
-        // Check 'ans4'
-        if( ans4 != NULL )
-        {
-            if( find( _buffer, _length, ans4 ) == true )
-            {   
-                #if DEBUG_UART > 0
-                    printf("[debug] found: %s\n", ans4);   
-                #endif          
-                return 4;
-            }
-        }   
-        
-        // Condition to avoid an overflow (DO NOT REMOVE)
-        if( millis() < previous) previous = millis();
-    }
-        
-    // timeout
-    return 0; 
+    return waitFor(answers, 4, timeout);
+}
+
+
+/*
+ * 
+ * name: waitFor
+ * @brief   This function waits for one of the answers during a certain period 
+ *          of time. The result is stored in '_buffer'.
+ *          All the answers are searched at once by '_matcher', which is 
+ *          advanced with every received byte, so the time spent per byte 
+ *          does not depend on the length of the response.
+ * @param   char** answers: expected answers (NULL entries are skipped)
+ * @param   uint8_t count: number of entries in answers
+ * @param   uint32_t timeout: time to wait for responses
+ * @return  '0' if timeout error, 
+ *          'n' if answers[n-1]
+ */
+uint8_t  arduPiUART::waitFor(char** answers, 
+                             uint8_t count, 
+                             uint32_t timeout)
+{ 
+    return sendCommand(NULL, answers, count, timeout);
 }
 
 
@@ -568,41 +555,67 @@ uint16_t  arduPiUART::readBuffer(uint16_t requestBytes)
  * This function reads from UART rx buffer and stores the contents in _buffer
  * attribute. _length indicates the number of valid bytes in _buffer
  * 
+ * It returns as soon as 'requestBytes' have been read, or when no byte 
+ * arrives for '_idle_timeout' ms. The bytes are taken in bulk, there is no 
+ * delay per byte.
+ * 
  * @param bool clearBuffer: indicates if the buffer has to be cleared before reading
  * 
  * @return  number of bytes read 
  */
 uint16_t  arduPiUART::readBuffer(uint16_t requestBytes, bool clearBuffer)
 { 
-    // index counter
-    uint16_t i = 0;
-    uint16_t nBytes = 0;
+    struct ATCommand cmd;
     
     if( clearBuffer == true )
     {
         // clear _buffer
-        memset( _buffer, 0x00, sizeof(_buffer) );
         _length = 0;
+        _buffer[0] = 0x00;
     }
     
-    // check available data for 'timeout' milliseconds
-    while( serialAvailable(_uart) )
-    {
-        if ( (i < (sizeof(_buffer)-1)) && (requestBytes>0) )
-        {
-            _buffer[i++] = serialRead(_uart);               
-            _length++;
-            nBytes++;
-            requestBytes--; 
-            latencyDelay();
-        }
-        else
-        {
-            break;
-        }
-    }
-        
-    return nBytes;
+    // make room for the whole request if possible
+    reserveBuffer((uint32_t)_length + requestBytes + 1);
+    
+    // read until 'requestBytes' or the line is idle
+    memset( &cmd, 0x00, sizeof(cmd) );
+    cmd.rbuf  = &_buffer[_length];
+    cmd.rsize = _capacity-1-_length;
+    if (requestBytes < cmd.rsize) cmd.rsize = requestBytes;
+    
+    if (cmd.rsize == 0) return 0;
+    
+    execute(&cmd);
+    
+    _length += cmd.length;
+    _buffer[_length] = 0x00;
+    return cmd.length;
+}
+
+
+/*
+ * 
+ * name: readByte
+ * This function reads one byte from the uart
+ * 
+ * @param uint32_t timeout: time to wait for the byte (ms)
+ * 
+ * @return  the byte read, '-1' if no byte arrived 
+ */
+int arduPiUART::readByte(uint32_t timeout)
+{
+    struct ATCommand cmd;
+    uint8_t c;
+    
+    memset( &cmd, 0x00, sizeof(cmd) );
+    cmd.rbuf    = &c;
+    cmd.rsize   = 1;
+    cmd.timeout = timeout;
+    
+    execute(&cmd);
+    
+    if (cmd.length == 0) return -1;
+    return c;
 }
 
 
@@ -619,7 +632,7 @@ void arduPiUART::latencyDelay()
 {
     // In the case there are not any bytes left in the incoming uart
     // wait for the time one byte needs for tranmission regarding the baudrate
-    if (serialAvailable(_uart) == 0)
+    if (serialAvailable(serialPort()) == 0)
     {
         switch (_baudrate)
         {
@@ -640,204 +653,2395 @@ void arduPiUART::latencyDelay()
 }
 
 
-/////////////////////////////////////////////////////////////////////////
-//Parse functions
-
-
-/*!
- * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
- *          For instance _buffer stores: "<response>\r\n"
- *          Then you can call: parseString(data, sizeof(data),"\r\n")
+/*
  * 
- * @param   char* str: pointer to the buffer where parsed data is stored
- * @param   uint16_t size: size of input 'str' buffer
- * @param   char* delimiters: string containing the delimiter characters
+ * name: commandGap
+ * This function waits until '_def_delay' milliseconds have elapsed since the 
+ * last command was sent or the last answer was received. It returns 
+ * immediately when no gap is configured (default), so the command is sent 
+ * without any fixed delay.
  * 
- * @return  
- *  @arg    '0' if ok
- *  @arg    '1' if error
  */
-uint8_t arduPiUART::parseString(char* str, uint16_t size, char* delimiters)
+void arduPiUART::commandGap()
 {
-    // define the pointer to seek for token
-    char* pch;
+    unsigned long elapsed;
     
-    pch = strtok( (char*)_buffer, delimiters);
+    if (_def_delay == 0) return;
     
-    if (pch != NULL)
-    {
-        memset(str,0x00, size);
-        strncpy(str, pch, size);
-        return 0;
-    }
-    else
+    elapsed = millis() - _last_command;
+    
+    if (elapsed < _def_delay)
     {
-        return 1;
+        delay(_def_delay - elapsed);
     }
 }
 
 
-/*!
- * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
- *          For instance _buffer stores: "<response>\r\n"
- *          Then you can call: parseString(data, sizeof(data),"\r\n")
+/////////////////////////////////////////////////////////////////////////
+//Response buffer
+
+
+/*
  * 
- * @param   char* str: pointer to the buffer where parsed data is stored
- * @param   uint16_t size: size of input 'str' buffer
- * @param   char* delimiters: string containing the delimiter characters
- * @param   uint8_t n: number of element to search for in the string of elements
+ * name: getResponse
+ * This function returns a view of the contents of '_buffer'. The view is 
+ * valid until the next command, since '_buffer' may be moved when it grows.
  * 
- * @return  
- *  @arg    '0' if ok
- *  @arg    '1' if error
+ * @return  view of the last response
  */
-uint8_t arduPiUART::parseString(char* str, uint16_t size, char* delimiters, uint8_t n)
+struct UARTView arduPiUART::getResponse()
 {
-    // define the pointer to seek for token
-    char* pch;
-    
-    pch = strtok( (char*)_buffer, delimiters);
-    
-    for (int i = 0; i < n; i++)
-    {
-    
-        if (pch == NULL)
-        {
-            return 1;
-        }
-        
-        // check element
-        if (i+1 == n)
-        {
-            memset(str,0x00, size);
-            strncpy(str, pch, size-1);
-            return 0;
-        }
-        
-        // iterate to next element
-        pch = strtok(NULL, delimiters);
-    }
+    struct UARTView view;
     
-    return 1;
+    view.data = _buffer;
+    view.length = _length;
+    return view;
 }
 
 
-/*!
- * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
- *          For instance _buffer stores: "<value>\r\n"
- *          Then you can call: parseFloat(&variable, "\r\n")
+/*
  * 
- * @param   float* value: pointer to the variable where parsed data is stored
- * @param   char* delimiters: string containing the delimiter characters
+ * name: getResult
+ * This function returns the result of the last command run by sendCommand or 
+ * waitFor. The response view is valid until the next command.
  * 
- * @return  
- *  @arg    '0' if ok
- *  @arg    '1' if error
+ * @return  result of the last command
  */
-uint8_t arduPiUART::parseFloat(float* value, char* delimiters)
+struct ATResult arduPiUART::getResult()
 {
-    // define the pointer to seek for token
-    char* pch;
-    
-    pch = strtok( (char*)_buffer, delimiters);
-    
-    if (pch != NULL)
-    {
-        *value = atof(pch);
-        return 0;
-    }
-    else
-    {
-        return 1;
-    }
+    return _result;
 }
 
 
-/*!
- * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
- *          For instance _buffer stores: "<value>\r\n"
- *          Then you can call: parseUint8(&variable, "\r\n")
+/*
  * 
- * @param   uint8_t* value: pointer to the variable where parsed data is stored
- * @param   char* delimiters: string containing the delimiter characters
- * @param   uint8_t n: number of element to search for in the string of elements
+ * name: setBufferSize
+ * This function sets the capacity of '_buffer'. The current contents are 
+ * kept if they fit in the new capacity.
  * 
- * @return  
- *  @arg    '0' if ok
- *  @arg    '1' if error
+ * @param   uint16_t size: new capacity (bytes)
+ * @return  '0' if ok, '1' if error
  */
-uint8_t arduPiUART::parseUint8(uint8_t* value, char* delimiters, uint8_t n)
+uint8_t arduPiUART::setBufferSize(uint16_t size)
 {
-    // define the pointer to seek for token
-    char* pch;
-    uint32_t aux;
+    uint8_t* buffer;
     
-    pch = strtok( (char*)_buffer, delimiters);
+    if ((size < 2) || (size > UART_BUFFER_MAX)) return 1;
     
-    for (int i = 0; i < n; i++)
-    {
-        if (pch == NULL)
-        {
-            return 1;
-        }       
-        
-        // check element
-        if (i+1 == n)
-        {
-            aux = strtoul( pch, NULL, 10);
-            *value = (uint8_t)aux;
-            return 0;
-        }
-        
-        // iterate to next element
-        pch = strtok(NULL, delimiters);
-    }
+    buffer = (uint8_t*)realloc(_buffer, size);
+    if (buffer == NULL) return 1;
     
-    return 1;
+    _buffer = buffer;
+    _capacity = size;
+    if (_length >= _capacity) _length = _capacity-1;
+    _buffer[_length] = 0x00;
+    return 0;
 }
 
 
-/*!
- * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
+/*
+ * 
+ * name: getBufferSize
+ * @return  capacity of '_buffer'
+ */
+uint16_t arduPiUART::getBufferSize()
+{
+    return _capacity;
+}
+
+
+/*
+ * 
+ * name: reserveBuffer
+ * This function doubles the capacity of '_buffer' until 'size' bytes fit or 
+ * UART_BUFFER_MAX is reached. Nothing is cleared, only '_length' bytes are 
+ * valid.
+ * 
+ * @param   uint32_t size: number of bytes needed
+ * @return  '0' if 'size' bytes fit, '1' otherwise
+ */
+uint8_t arduPiUART::reserveBuffer(uint32_t size)
+{
+    uint32_t capacity = _capacity;
+    uint8_t* buffer;
+    
+    if (size <= _capacity) return 0;
+    if (_capacity >= UART_BUFFER_MAX) return 1;
+    
+    if (capacity == 0) capacity = UART_BUFFER_SIZE;
+    while (capacity < size) capacity *= 2;
+    if (capacity > UART_BUFFER_MAX) capacity = UART_BUFFER_MAX;
+    
+    buffer = (uint8_t*)realloc(_buffer, capacity);
+    if (buffer == NULL) return 1;
+    
+    _buffer = buffer;
+    _capacity = capacity;
+    
+    return (size <= _capacity) ? 0 : 1;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//Command engine
+
+
+/*
+ * 
+ * name: execute
+ * This function runs a command and waits for its completion. When the queue 
+ * is running the command goes through the queue, so it is run in order with 
+ * the queued commands, otherwise it is run in the calling thread.
+ * 
+ * @param   struct ATCommand* cmd: command to run
+ */
+void arduPiUART::execute(struct ATCommand *cmd)
+{
+    if ((_scheduler != NULL) && (_scheduler->submit(this, cmd) == 0))
+    {
+        waitCommand(cmd);
+        return;
+    }
+    
+    if ((_queue_running == true) && (queueCommand(cmd) == 0))
+    {
+        waitCommand(cmd);
+        return;
+    }
+    
+    startCommand(cmd);
+    
+    // sleep until more data arrives instead of spinning
+    while (true)
+    {
+        uint16_t n = rxPoll();
+        
+        if (stepCommand(cmd) == true) break;
+        if (n == 0) serialWait(UART_POLL_TIMEOUT, serialPort());
+    }
+    
+    finishCommand(cmd);
+    cmd->done = true;
+}
+
+
+/*
+ * 
+ * name: startCommand
+ * This function sends the command (if any) and prepares the matcher for its 
+ * answers. The received bytes that were not consumed by the previous command 
+ * are discarded if '_flush_mode' is set. The URCs among them have already 
+ * been dispatched so they are not lost.
+ * 
+ * @param   struct ATCommand* cmd: command to start
+ */
+void arduPiUART::startCommand(struct ATCommand *cmd)
+{
+    cmd->answer = 0;
+    cmd->length = 0;
+    cmd->cme = -1;
+    cmd->cms = -1;
+    cmd->elapsed = 0;
+    cmd->done = false;
+    cmd->tail = false;
+    
+    if (cmd->command != NULL)
+    {
+        #if DEBUG_UART > 0
+            if (cmd->clength == 0) { printf("[debug] cmd:");  printf(cmd->command); printf("\n"); }
+        #endif
+        
+        // respect the minimum gap if the module needs one
+        commandGap();
+        
+        // clear received data before sending command
+        if( _flush_mode == true )
+        {
+            rxFlush();
+        }
+        
+        if (cmd->clength == 0)
+        {
+            printString( cmd->command, serialPort() ); 
+        }
+        else
+        {
+            for (uint16_t i = 0; i < cmd->clength; i++)
+            {
+                printByte(cmd->command[i], serialPort()); 
+            }   
+        }
+        _last_command = millis();
+    }
+    
+    if ((cmd->answers != NULL) && (cmd->count > 0))
+    {
+        #if DEBUG_UART > 1
+            for (uint8_t n = 0; n < cmd->count; n++)
+            {
+                if(cmd->answers[n]!=NULL) { printf("[debug] ans%u:", n+1); printf(cmd->answers[n]); printf("\n");}
+            }
+        #endif
+        
+        // build the automaton for the expected answers
+        _matcher.begin(cmd->answers, cmd->count);
+        cmd->answer = _matcher.match();
+    }
+    
+    adaptTimeout(cmd);
+    
+    _active_start = millis();
+    _active_last = _active_start;
+}
+
+
+/*
+ * 
+ * name: finishCommand
+ * This function records a completed command in the statistics and gives it 
+ * back its own timeout if it was adapted.
+ * 
+ * @param   struct ATCommand* cmd: completed command
+ */
+void arduPiUART::finishCommand(struct ATCommand *cmd)
+{
+    _last_command = millis();
+    _stats.record(cmd);
+    
+    if (_active_adapted != NULL)
+    {
+        // the answer may just be slower than learned: wait it in full next time
+        if (cmd->answer == 0) _active_adapted->backoff = 1;
+        
+        cmd->timeout = _active_timeout;
+        _active_adapted = NULL;
+    }
+}
+
+
+/*
+ * 
+ * name: adaptTimeout
+ * This function sets the timeout of a command to a multiple of the p99 
+ * latency of its previous answers, between '_adaptive_minimum' and the 
+ * timeout of the command.
+ * 
+ * @param   struct ATCommand* cmd: command being started
+ */
+void arduPiUART::adaptTimeout(struct ATCommand *cmd)
+{
+    char prefix[UART_STATS_PREFIX_SIZE];
+    struct UARTCommandStats* entry;
+    uint32_t timeout;
+    
+    _active_adapted = NULL;
+    
+    if (_adaptive_factor == 0) return;
+    if ((cmd->command == NULL) || (cmd->answers == NULL) || (cmd->count == 0)) return;
+    
+    arduPiStats::getPrefix(cmd, prefix);
+    entry = _stats.find(prefix, false);
+    if (entry == NULL) return;
+    
+    if (entry->backoff != 0)
+    {
+        entry->backoff = 0;
+        return;
+    }
+    
+    if ((entry->count - entry->timeouts) < _adaptive_samples) return;
+    
+    timeout = arduPiStats::percentile(entry, 99) * _adaptive_factor;
+    if (timeout < _adaptive_minimum) timeout = _adaptive_minimum;
+    if (timeout >= cmd->timeout) return;
+    
+    #if DEBUG_UART > 1
+        printf("[debug] timeout %s: %lu ms\n", prefix, (unsigned long)timeout);
+    #endif
+    
+    _active_adapted = entry;
+    _active_timeout = cmd->timeout;
+    cmd->timeout = timeout;
+}
+
+
+/*
+ * 
+ * name: stepCommand
+ * This function moves the received bytes to the response of the command, 
+ * advancing '_matcher' with every byte, and checks if the command has been 
+ * completed. When the answer found starts an error line ("+CME ERROR:" or 
+ * "+CMS ERROR:") the rest of the line is received too, so the error number 
+ * is parsed without waiting for it again.
+ * 
+ * @param   struct ATCommand* cmd: command in progress
+ * @return  'true' if the command has been completed
+ */
+bool arduPiUART::stepCommand(struct ATCommand *cmd)
+{
+    bool answers = (cmd->answers != NULL) && (cmd->count > 0);
+    unsigned long idle;
+    uint8_t c;
+    
+    while (((cmd->answer == 0) || (cmd->tail == true)) && (_rx_tail != _rx_head))
+    {
+        if ((answers == false) && (cmd->length >= cmd->rsize)) break;
+        
+        c = _rx_ring[_rx_tail];
+        _rx_tail = (_rx_tail + 1) & (UART_RX_RING_SIZE - 1);
+        
+        // answers stored in '_buffer' make it grow instead of being truncated
+        if ((cmd->length >= cmd->rsize) && (cmd->rbuf == _buffer))
+        {
+            if (reserveBuffer((uint32_t)cmd->length + 2) == 0)
+            {
+                cmd->rbuf = _buffer;
+                cmd->rsize = _capacity-1;
+            }
+        }
+        
+        if (cmd->length < cmd->rsize) cmd->rbuf[cmd->length++] = c;
+        _active_last = millis();
+        
+        if (answers == false) continue;
+        
+        if (cmd->tail == true)
+        {
+            // the error line ends with "\r\n"
+            if (c == '\n') cmd->tail = false;
+        }
+        else
+        {
+            cmd->answer = _matcher.feed(c);
+            if (cmd->answer != 0) cmd->tail = errorLine(cmd);
+        }
+    }
+    
+    if (answers == true)
+    {
+        // the error line is left incomplete if no more bytes arrive
+        if ((cmd->tail == true) && ((millis() - _active_last) >= _idle_timeout))
+        {
+            cmd->tail = false;
+        }
+        
+        if ((cmd->answer != 0) && (cmd->tail == false))
+        {
+            #if DEBUG_UART > 0
+                printf("[debug] found: %s\n", cmd->answers[cmd->answer-1]);   
+            #endif
+            parseError(cmd);
+            cmd->elapsed = millis() - _active_start;
+            return true;
+        }
+        
+        if ((millis() - _active_start) < cmd->timeout) return false;
+        
+        // timeout
+        #if DEBUG_UART > 0
+            printf("[debug] no answer\n");
+        #endif  
+        #if DEBUG_UART > 1
+            printf("[debug] response: %.*s\n", cmd->length, (char*)cmd->rbuf);
+        #endif
+        if (cmd->answer != 0) parseError(cmd);
+        cmd->tail = false;
+        cmd->elapsed = millis() - _active_start;
+        return true;
+    }
+    
+    // inter-byte timeout
+    idle = (cmd->timeout != 0) ? cmd->timeout : _idle_timeout;
+    
+    if ((cmd->length < cmd->rsize) && ((millis() - _active_last) < idle))
+    {
+        return false;
+    }
+    
+    cmd->elapsed = millis() - _active_start;
+    return true;
+}
+
+
+/*
+ * 
+ * name: errorLine
+ * This function checks if the answer just found is the start of an error 
+ * line: "+CME ERROR:" or "+CMS ERROR:", with or without the colon.
+ * 
+ * @param   struct ATCommand* cmd: command in progress
+ * @return  'true' if the rest of the line has to be received
+ */
+bool arduPiUART::errorLine(struct ATCommand *cmd)
+{
+    const char* end = (const char*)cmd->rbuf + cmd->length;
+    uint16_t n = cmd->length;
+    
+    if ((n > 0) && (end[-1] == ':')) { end--; n--; }
+    if (n < 10) return false;
+    
+    return (memcmp(end-10, "+CME ERROR", 10) == 0) 
+        || (memcmp(end-10, "+CMS ERROR", 10) == 0);
+}
+
+
+/*
+ * 
+ * name: parseError
+ * This function looks for the last "+CME ERROR: <n>" or "+CMS ERROR: <n>" 
+ * of the response and stores <n> in the command. Verbose errors (AT+CMEE=2) 
+ * have no number and are left as -1.
+ * 
+ * @param   struct ATCommand* cmd: completed command
+ */
+void arduPiUART::parseError(struct ATCommand *cmd)
+{
+    const char* data = (const char*)cmd->rbuf;
+    const char* last = data + cmd->length;
+    const char* first;
+    const char* p;
+    int32_t value;
+    
+    if (cmd->length < 10) return;
+    
+    for (p = last - 10; p >= data; p--)
+    {
+        if ((p[0] != '+') || (p[1] != 'C') || (p[2] != 'M')) continue;
+        if ((p[3] != 'E') && (p[3] != 'S')) continue;
+        if (memcmp(p+4, " ERROR", 6) != 0) continue;
+        
+        first = p + 10;
+        if ((first < last) && (*first == ':')) first++;
+        while ((first < last) && (*first == ' ')) first++;
+        
+        if (arduPiParser::toInt32(first, last, &value) == first) return;
+        if ((value < 0) || (value > 0x7FFF)) return;
+        
+        if (p[3] == 'E') cmd->cme = (int16_t)value;
+        else cmd->cms = (int16_t)value;
+        return;
+    }
+}
+
+
+/*
+ * 
+ * name: rxPoll
+ * This function reads the bytes available in the uart. Unsolicited lines are 
+ * dispatched to their handlers and the rest is kept in '_rx_ring' until a 
+ * command consumes it.
+ * 
+ * @return  number of bytes read from the uart
+ */
+uint16_t arduPiUART::rxPoll()
+{
+    uint8_t chunk[UART_READ_CHUNK];
+    uint16_t n = 0;
+    int count;
+    
+    pthread_mutex_lock(&_queue_mutex);
+    do
+    {
+        // take everything received so far in one read
+        count = serialReadBuffer(chunk, sizeof(chunk), serialPort());
+        
+        for (int i = 0; i < count; i++) rxFilter(chunk[i]);
+        n += count;
+    } while (count == (int)sizeof(chunk));
+    pthread_mutex_unlock(&_queue_mutex);
+    
+    return n;
+}
+
+
+/*
+ * 
+ * name: rxFilter
+ * This function separates the unsolicited lines from the responses. The start 
+ * of every line is held while it may still be one of the registered prefixes.
+ * 
+ * @param   uint8_t c: received byte
+ */
+void arduPiUART::rxFilter(uint8_t c)
+{
+    bool partial = false;
+    uint16_t n;
+    
+    if (_urc_state == URC_LINE_DATA)
+    {
+        rxPush(c);
+        if (c == '\n') _urc_state = URC_LINE_START;
+        return;
+    }
+    
+    if (_urc_length < (URC_LINE_SIZE-1)) _urc_line[_urc_length++] = c;
+    
+    if (_urc_state != URC_LINE_URC)
+    {
+        for (uint8_t i = 0; i < _urc_count; i++)
+        {
+            n = (_urc_length < _urc[i].length) ? _urc_length : _urc[i].length;
+            
+            if (memcmp(_urc_line, _urc[i].prefix, n) != 0) continue;
+            
+            if (_urc_length >= _urc[i].length)
+            {
+                _urc_state = URC_LINE_URC;
+                _urc_match = i;
+                break;
+            }
+            partial = true;
+        }
+        
+        if (_urc_state != URC_LINE_URC)
+        {
+            if (partial == true)
+            {
+                _urc_state = URC_LINE_PREFIX;
+                return;
+            }
+            
+            // not an unsolicited line, release the held bytes
+            for (n = 0; n < _urc_length; n++) rxPush(_urc_line[n]);
+            _urc_length = 0;
+            _urc_state = (c == '\n') ? URC_LINE_START : URC_LINE_DATA;
+            return;
+        }
+    }
+    
+    if (c != '\n') return;
+    
+    if (_urc_match < _urc_count)
+    {
+        // remove the "\r\n" and dispatch the line
+        n = _urc_length;
+        while ((n > 0) && ((_urc_line[n-1] == '\r') || (_urc_line[n-1] == '\n'))) n--;
+        _urc_line[n] = 0x00;
+        
+        #if DEBUG_UART > 0
+            printf("[debug] urc: %s\n", _urc_line);
+        #endif
+        _urc[_urc_match].handler(_urc_line, n, _urc[_urc_match].arg);
+    }
+    else
+    {
+        // its handler has been removed meanwhile
+        for (n = 0; n < _urc_length; n++) rxPush(_urc_line[n]);
+    }
+    
+    _urc_length = 0;
+    _urc_state = URC_LINE_START;
+}
+
+
+/*
+ * 
+ * name: rxPush
+ * This function stores a byte in '_rx_ring'. The byte is dropped if the 
+ * ring is full
+ * 
+ */
+void arduPiUART::rxPush(uint8_t c)
+{
+    uint16_t next = (_rx_head + 1) & (UART_RX_RING_SIZE - 1);
+    
+    if (next == _rx_tail)
+    {
+        #if DEBUG_UART > 0
+            printf("[debug] rx ring full\n");
+        #endif
+        return;
+    }
+    
+    _rx_ring[_rx_head] = c;
+    _rx_head = next;
+}
+
+
+/*
+ * 
+ * name: rxFlush
+ * This function discards the received bytes. Unlike serialFlush, the bytes 
+ * are read first so the unsolicited lines among them are dispatched.
+ * 
+ */
+void arduPiUART::rxFlush()
+{
+    rxPoll();
+    _rx_tail = _rx_head;
+}
+
+
+/*
+ * 
+ * name: beginQueue
+ * This function starts the thread that runs the queued commands and keeps 
+ * reading the uart between commands, so unsolicited lines are dispatched 
+ * as soon as they arrive.
+ * 
+ * @return  '0' if ok, '1' if error
+ */
+uint8_t arduPiUART::beginQueue()
+{
+    if (_queue_running == true) return 0;
+    
+    // the scheduler already runs the commands of this object
+    if (_scheduler != NULL) return 1;
+    
+    _queue_running = true;
+    if (pthread_create(&_queue_thread, NULL, uartQueueFunction, (void *)this) != 0)
+    {
+        #if DEBUG_UART > 0
+            printf("[debug] unable to start the queue thread\n");
+        #endif
+        _queue_running = false;
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+/*
+ * 
+ * name: endQueue
+ * This function runs the pending commands and stops the queue thread
+ * 
+ */
+void arduPiUART::endQueue()
+{
+    pthread_mutex_lock(&_queue_mutex);
+    if (_queue_running == false)
+    {
+        pthread_mutex_unlock(&_queue_mutex);
+        return;
+    }
+    _queue_running = false;
+    pthread_mutex_unlock(&_queue_mutex);
+    
+    pthread_join(_queue_thread, NULL);
+}
+
+
+/*
+ * 
+ * name: queueCommand
+ * This function adds a command at the end of the queue
+ * 
+ * @param   struct ATCommand* cmd: command to add
+ * @return  '0' if ok, '1' if the queue is not running
+ */
+uint8_t arduPiUART::queueCommand(struct ATCommand *cmd)
+{
+    if (_scheduler != NULL) return _scheduler->submit(this, cmd);
+    
+    pthread_mutex_lock(&_queue_mutex);
+    if (_queue_running == false)
+    {
+        pthread_mutex_unlock(&_queue_mutex);
+        return 1;
+    }
+    
+    cmd->next = NULL;
+    cmd->answer = 0;
+    cmd->length = 0;
+    cmd->done = false;
+    
+    if (_queue_tail == NULL) _queue_head = cmd;
+    else _queue_tail->next = cmd;
+    _queue_tail = cmd;
+    
+    pthread_mutex_unlock(&_queue_mutex);
+    return 0;
+}
+
+
+/*
+ * 
+ * name: waitCommand
+ * This function waits until a queued command has been completed
+ * 
+ * @param   struct ATCommand* cmd: queued command
+ * @return  '0' if timeout error, 'n' if answers[n-1]
+ */
+uint8_t arduPiUART::waitCommand(struct ATCommand *cmd)
+{
+    pthread_mutex_lock(&_queue_mutex);
+    while (cmd->done == false)
+    {
+        pthread_cond_wait(&_queue_cond, &_queue_mutex);
+    }
+    pthread_mutex_unlock(&_queue_mutex);
+    
+    return cmd->answer;
+}
+
+
+/*
+ * 
+ * name: runQueue
+ * Worker loop of the command queue. Commands are run one after the other, 
+ * and the uart is polled while there is nothing to do.
+ * 
+ */
+void arduPiUART::runQueue()
+{
+    struct ATCommand *cmd;
+    uint16_t n;
+    bool finished;
+    
+    pthread_mutex_lock(&_queue_mutex);
+    while ((_queue_running == true) || (_queue_head != NULL) || (_active != NULL))
+    {
+        if ((_active == NULL) && (_queue_head != NULL))
+        {
+            _active = _queue_head;
+            _queue_head = _active->next;
+            if (_queue_head == NULL) _queue_tail = NULL;
+            pthread_mutex_unlock(&_queue_mutex);
+            
+            startCommand(_active);
+        }
+        else
+        {
+            pthread_mutex_unlock(&_queue_mutex);
+        }
+        
+        n = rxPoll();
+        finished = false;
+        
+        if (_active != NULL)
+        {
+            finished = stepCommand(_active);
+            
+            if (finished == true)
+            {
+                cmd = _active;
+                finishCommand(cmd);
+                
+                if (cmd->callback != NULL) cmd->callback(cmd);
+                
+                pthread_mutex_lock(&_queue_mutex);
+                _active = NULL;
+                cmd->done = true;
+                pthread_cond_broadcast(&_queue_cond);
+                pthread_mutex_unlock(&_queue_mutex);
+            }
+        }
+        
+        if ((n == 0) && (finished == false)) serialWait(UART_POLL_TIMEOUT, serialPort());
+        
+        pthread_mutex_lock(&_queue_mutex);
+    }
+    pthread_mutex_unlock(&_queue_mutex);
+}
+
+
+/*
+ * 
+ * name: addURC
+ * This function registers a handler for the unsolicited lines starting with 
+ * 'prefix'. The prefix string is not copied.
+ * 
+ * @return  '0' if ok, '1' if error
+ */
+uint8_t arduPiUART::addURC(const char *prefix, 
+                           void (*handler)(const char *line, uint16_t length, void *arg), 
+                           void *arg)
+{
+    size_t length;
+    
+    if ((prefix == NULL) || (handler == NULL)) return 1;
+    
+    length = strlen(prefix);
+    if ((length == 0) || (length >= URC_LINE_SIZE)) return 1;
+    
+    pthread_mutex_lock(&_queue_mutex);
+    if (_urc_count >= URC_MAX_HANDLERS)
+    {
+        pthread_mutex_unlock(&_queue_mutex);
+        return 1;
+    }
+    
+    _urc[_urc_count].prefix = prefix;
+    _urc[_urc_count].length = length;
+    _urc[_urc_count].handler = handler;
+    _urc[_urc_count].arg = arg;
+    _urc_count++;
+    pthread_mutex_unlock(&_queue_mutex);
+    
+    return 0;
+}
+
+
+/*
+ * 
+ * name: removeURC
+ * This function removes the handler registered for 'prefix'
+ * 
+ */
+void arduPiUART::removeURC(const char *prefix)
+{
+    pthread_mutex_lock(&_queue_mutex);
+    for (uint8_t i = 0; i < _urc_count; i++)
+    {
+        if (strcmp(_urc[i].prefix, prefix) != 0) continue;
+        
+        // keep the handler of the line being collected
+        if (_urc_match == i) _urc_match = URC_MAX_HANDLERS;
+        else if (_urc_match > i) _urc_match--;
+        
+        _urc_count--;
+        memmove(&_urc[i], &_urc[i+1], (_urc_count - i) * sizeof(_urc[0]));
+        break;
+    }
+    pthread_mutex_unlock(&_queue_mutex);
+}
+
+
+/*
+ * 
+ * name: getStats
+ * This function writes the statistics of the commands run so far
+ * 
+ * @param   char* buffer: output, always NULL-terminated
+ * @param   uint32_t size: size of 'buffer'
+ * @param   uint8_t format: STATS_JSON or STATS_PROMETHEUS
+ * @return  length of the whole output, it did not fit if it is >= 'size'
+ */
+uint32_t arduPiUART::getStats(char* buffer, uint32_t size, uint8_t format)
+{
+    return _stats.write(buffer, size, format, _uart);
+}
+
+
+/*
+ * 
+ * name: resetStats
+ * This function clears the statistics of the commands
+ * 
+ */
+void arduPiUART::resetStats()
+{
+    _stats.reset();
+}
+
+
+/*
+ * This is the function that will be running in a thread if 
+ * arduPiUART::beginQueue() is called
+ */
+void * uartQueueFunction(void *arg)
+{
+    arduPiUART *uart = (arduPiUART *)arg;
+    uart->runQueue();
+    return NULL;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//Socket scheduler
+
+
+arduPiUARTScheduler::arduPiUARTScheduler()
+{
+    _port[0] = NULL;
+    _port[1] = NULL;
+    _head[0] = _head[1] = NULL;
+    _tail[0] = _tail[1] = NULL;
+    _current = -1;
+    _open[0] = _open[1] = false;
+    _baudrate = 0;
+    _next = 0;
+    _holder = -1;
+    _hold_depth = 0;
+    _active = NULL;
+    _active_socket = -1;
+    _running = false;
+    _select = NULL;
+    
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_cond, NULL);
+}
+
+
+arduPiUARTScheduler::~arduPiUARTScheduler()
+{
+    end();
+    if (_port[0] != NULL) detach(_port[0]);
+    if (_port[1] != NULL) detach(_port[1]);
+}
+
+
+/*
+ * 
+ * name: setSelect
+ * @param   void (*select)(uint8_t socket): function that connects the uart 
+ *          to a socket
+ */
+void arduPiUARTScheduler::setSelect(void (*select)(uint8_t socket))
+{
+    _select = select;
+}
+
+
+/*
+ * 
+ * name: attach
+ * This function attaches a library object to a socket. From now on its 
+ * commands are run by the scheduler.
+ * 
+ * @param   arduPiUART* port: object
+ * @param   uint8_t socket: SOCKET0 or SOCKET1
+ * @return  '0' if ok, '1' if error
+ */
+uint8_t arduPiUARTScheduler::attach(arduPiUART *port, uint8_t socket)
+{
+    if ((port == NULL) || (socket > 1)) return 1;
+    if ((port->_queue_running == true) || (port->_scheduler != NULL)) return 1;
+    
+    pthread_mutex_lock(&_mutex);
+    if (_port[socket] != NULL)
+    {
+        pthread_mutex_unlock(&_mutex);
+        return 1;
+    }
+    _port[socket] = port;
+    port->_scheduler = this;
+    pthread_mutex_unlock(&_mutex);
+    
+    return 0;
+}
+
+
+/*
+ * 
+ * name: detach
+ * This function detaches a library object. Its pending commands end with 
+ * timeout and the command in progress, if any, is waited for.
+ * 
+ * @param   arduPiUART* port: object
+ */
+void arduPiUARTScheduler::detach(arduPiUART *port)
+{
+    struct ATCommand *cmd;
+    int8_t socket;
+    
+    pthread_mutex_lock(&_mutex);
+    socket = socketOf(port);
+    if (socket < 0)
+    {
+        pthread_mutex_unlock(&_mutex);
+        return;
+    }
+    
+    while (_active_socket == socket) pthread_cond_wait(&_cond, &_mutex);
+    
+    cmd = _head[socket];
+    _head[socket] = NULL;
+    _tail[socket] = NULL;
+    _port[socket] = NULL;
+    _open[socket] = false;
+    if (_current == socket) _current = -1;
+    if (_holder == socket)
+    {
+        _holder = -1;
+        _hold_depth = 0;
+    }
+    port->_scheduler = NULL;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+    
+    while (cmd != NULL)
+    {
+        struct ATCommand *next = cmd->next;
+        complete(port, cmd);
+        cmd = next;
+    }
+}
+
+
+/*
+ * 
+ * name: begin
+ * This function starts the scheduler thread
+ * 
+ * @return  '0' if ok, '1' if error
+ */
+uint8_t arduPiUARTScheduler::begin()
+{
+    if (_running == true) return 0;
+    
+    _running = true;
+    if (pthread_create(&_thread, NULL, uartSchedulerFunction, (void *)this) != 0)
+    {
+        #if DEBUG_UART > 0
+            printf("[debug] unable to start the scheduler thread\n");
+        #endif
+        _running = false;
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+/*
+ * 
+ * name: end
+ * This function runs the pending commands and stops the scheduler thread
+ * 
+ */
+void arduPiUARTScheduler::end()
+{
+    pthread_mutex_lock(&_mutex);
+    if (_running == false)
+    {
+        pthread_mutex_unlock(&_mutex);
+        return;
+    }
+    _running = false;
+    pthread_mutex_unlock(&_mutex);
+    
+    pthread_join(_thread, NULL);
+}
+
+
+/*
+ * 
+ * name: submit
+ * This function adds a command at the end of the queue of its socket
+ * 
+ * @param   arduPiUART* port: attached object
+ * @param   struct ATCommand* cmd: command, owned by the caller until done
+ * @return  '0' if ok, '1' if error
+ */
+uint8_t arduPiUARTScheduler::submit(arduPiUART *port, struct ATCommand *cmd)
+{
+    int8_t socket;
+    
+    pthread_mutex_lock(&_mutex);
+    socket = socketOf(port);
+    if ((_running == false) || (socket < 0))
+    {
+        pthread_mutex_unlock(&_mutex);
+        return 1;
+    }
+    
+    cmd->next = NULL;
+    cmd->answer = 0;
+    cmd->length = 0;
+    cmd->done = false;
+    
+    if (_tail[socket] == NULL) _head[socket] = cmd;
+    else _tail[socket]->next = cmd;
+    _tail[socket] = cmd;
+    
+    pthread_mutex_unlock(&_mutex);
+    return 0;
+}
+
+
+/*
+ * 
+ * name: hold
+ * This function keeps the uart on the socket of 'port' until release. The 
+ * command of the other socket in progress, if any, is waited for.
+ * 
+ * @param   arduPiUART* port: attached object
+ */
+void arduPiUARTScheduler::hold(arduPiUART *port)
+{
+    int8_t socket;
+    
+    pthread_mutex_lock(&_mutex);
+    socket = socketOf(port);
+    pthread_mutex_unlock(&_mutex);
+    
+    if (socket >= 0) holdSocket(socket);
+}
+
+
+/*
+ * 
+ * name: holdSocket
+ * This function keeps the uart on 'socket' until releaseSocket, see hold
+ * 
+ * @param   uint8_t socket: SOCKET0 or SOCKET1
+ */
+void arduPiUARTScheduler::holdSocket(uint8_t socket)
+{
+    if (socket > 1) return;
+    
+    pthread_mutex_lock(&_mutex);
+    while (((_holder >= 0) && (_holder != socket)) || 
+           ((_active != NULL) && (_active_socket != socket)))
+    {
+        pthread_cond_wait(&_cond, &_mutex);
+    }
+    
+    _holder = socket;
+    _hold_depth++;
+    pthread_mutex_unlock(&_mutex);
+}
+
+
+/*
+ * 
+ * name: release
+ * This function ends a hold, the outermost call lets the other socket use 
+ * the uart again
+ * 
+ * @param   arduPiUART* port: attached object
+ */
+void arduPiUARTScheduler::release(arduPiUART *port)
+{
+    int8_t socket;
+    
+    pthread_mutex_lock(&_mutex);
+    socket = socketOf(port);
+    pthread_mutex_unlock(&_mutex);
+    
+    if (socket >= 0) releaseSocket(socket);
+}
+
+
+/*
+ * 
+ * name: releaseSocket
+ * This function ends a hold of 'socket', see release
+ * 
+ * @param   uint8_t socket: SOCKET0 or SOCKET1
+ */
+void arduPiUARTScheduler::releaseSocket(uint8_t socket)
+{
+    pthread_mutex_lock(&_mutex);
+    if ((_holder >= 0) && (_holder == socket))
+    {
+        _hold_depth--;
+        if (_hold_depth == 0)
+        {
+            _holder = -1;
+            pthread_cond_broadcast(&_cond);
+        }
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+
+/*
+ * 
+ * name: socketOf
+ * @param   arduPiUART* port: object
+ * @return  socket 'port' is attached to, -1 if none
+ */
+int8_t arduPiUARTScheduler::socketOf(arduPiUART *port)
+{
+    if (port == NULL) return -1;
+    if (_port[0] == port) return 0;
+    if (_port[1] == port) return 1;
+    return -1;
+}
+
+
+/*
+ * 
+ * name: open
+ * This function is called by beginUART of an attached object. The uart is 
+ * shared, so it is opened with the baudrate of the object by the next 
+ * command of its socket.
+ * 
+ * @param   arduPiUART* port: attached object
+ */
+void arduPiUARTScheduler::open(arduPiUART *port)
+{
+    int8_t socket;
+    
+    pthread_mutex_lock(&_mutex);
+    socket = socketOf(port);
+    if (socket >= 0) _open[socket] = true;
+    pthread_mutex_unlock(&_mutex);
+}
+
+
+/*
+ * 
+ * name: close
+ * This function is called by closeUART of an attached object. The command 
+ * of its socket in progress, if any, is waited for. The uart is closed only 
+ * when the other socket is not using it either, and it is reopened by the 
+ * next command.
+ * 
+ * @param   arduPiUART* port: attached object
+ */
+void arduPiUARTScheduler::close(arduPiUART *port)
+{
+    int8_t socket;
+    
+    pthread_mutex_lock(&_mutex);
+    socket = socketOf(port);
+    if (socket < 0)
+    {
+        pthread_mutex_unlock(&_mutex);
+        return;
+    }
+    
+    while (_active_socket == socket) pthread_cond_wait(&_cond, &_mutex);
+    
+    _open[socket] = false;
+    if (_current == socket) _current = -1;
+    if (_open[socket ^ 0x01] == false)
+    {
+        closeSerial(UART0);
+        _baudrate = 0;
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+
+/*
+ * 
+ * name: connect
+ * This function connects the uart to a socket. The bytes already received 
+ * belong to the previous socket, so they are handed to its object first. 
+ * The selector is called before every command: it owns the state of the 
+ * multiplexer and only writes changes. The uart is opened if it is closed 
+ * or the object of the new socket uses another baudrate.
+ * 
+ * @param   uint8_t socket: SOCKET0 or SOCKET1
+ */
+void arduPiUARTScheduler::connect(uint8_t socket)
+{
+    arduPiUART *port = _port[socket];
+    
+    if (_current != socket)
+    {
+        if ((_current >= 0) && (_port[_current] != NULL)) _port[_current]->rxPoll();
+        _current = socket;
+    }
+    
+    if (_select != NULL) _select(socket);
+    
+    if (port->_baudrate != _baudrate)
+    {
+        beginSerial(port->_baudrate, UART0);
+        _baudrate = port->_baudrate;
+    }
+    _open[socket] = true;
+}
+
+
+/*
+ * 
+ * name: complete
+ * This function wakes up the thread waiting for a command
+ * 
+ */
+void arduPiUARTScheduler::complete(arduPiUART *port, struct ATCommand *cmd)
+{
+    if (cmd->callback != NULL) cmd->callback(cmd);
+    
+    pthread_mutex_lock(&port->_queue_mutex);
+    cmd->done = true;
+    pthread_cond_broadcast(&port->_queue_cond);
+    pthread_mutex_unlock(&port->_queue_mutex);
+}
+
+
+/*
+ * 
+ * name: run
+ * Worker loop of the scheduler. The next command is taken from the other 
+ * socket when both have pending commands, unless a socket holds the uart. 
+ * The selected socket is polled while there is nothing to do.
+ * 
+ */
+void arduPiUARTScheduler::run()
+{
+    arduPiUART *port;
+    arduPiUART *active = NULL;
+    struct ATCommand *cmd;
+    uint16_t n;
+    bool finished;
+    
+    pthread_mutex_lock(&_mutex);
+    while ((_running == true) || (_active != NULL) || 
+           (_head[0] != NULL) || (_head[1] != NULL))
+    {
+        if (_active == NULL)
+        {
+            for (uint8_t i = 0; i < 2; i++)
+            {
+                uint8_t socket = (_next + i) & 0x01;
+                
+                if ((_holder >= 0) && (_holder != socket)) continue;
+                if (_head[socket] == NULL) continue;
+                
+                _active = _head[socket];
+                _head[socket] = _active->next;
+                if (_head[socket] == NULL) _tail[socket] = NULL;
+                _active_socket = socket;
+                _next = socket ^ 0x01;
+                break;
+            }
+            
+            if (_active != NULL)
+            {
+                active = _port[_active_socket];
+                connect(_active_socket);
+                pthread_mutex_unlock(&_mutex);
+                
+                active->startCommand(_active);
+                pthread_mutex_lock(&_mutex);
+            }
+        }
+        
+        port = (_current >= 0) ? _port[_current] : NULL;
+        pthread_mutex_unlock(&_mutex);
+        
+        n = (port != NULL) ? port->rxPoll() : 0;
+        finished = false;
+        
+        if (_active != NULL)
+        {
+            finished = active->stepCommand(_active);
+            
+            if (finished == true)
+            {
+                cmd = _active;
+                active->finishCommand(cmd);
+                
+                pthread_mutex_lock(&_mutex);
+                _active = NULL;
+                _active_socket = -1;
+                pthread_cond_broadcast(&_cond);
+                pthread_mutex_unlock(&_mutex);
+                
+                complete(active, cmd);
+            }
+        }
+        
+        if ((n == 0) && (finished == false))
+        {
+            if (port != NULL) serialWait(UART_POLL_TIMEOUT, UART0);
+            else delay(UART_POLL_TIMEOUT);
+        }
+        
+        pthread_mutex_lock(&_mutex);
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+
+/*
+ * This is the function that will be running in a thread if 
+ * arduPiUARTScheduler::begin() is called
+ */
+void * uartSchedulerFunction(void *arg)
+{
+    arduPiUARTScheduler *scheduler = (arduPiUARTScheduler *)arg;
+    scheduler->run();
+    return NULL;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//Response matcher
+
+
+/*
+ * 
+ * name: begin
+ * This function builds the Aho-Corasick automaton for the given answers. The 
+ * bytes used by the answers are mapped to character classes (class 0 is any 
+ * other byte) so the full transition table stays small and every received 
+ * byte is a single lookup.
+ * 
+ * @param   char** answers: expected answers (NULL entries are skipped)
+ * @param   uint8_t count: number of entries in answers
+ * @return  number of answers added. Answers that do not fit in the automaton 
+ *          are skipped
+ */
+uint8_t arduPiMatcher::begin(char** answers, uint8_t count)
+{
+    uint8_t queue[MATCHER_MAX_NODES];
+    uint8_t head = 0;
+    uint8_t tail = 0;
+    uint8_t added = 0;
+    uint8_t node, next, c;
+    uint16_t k;
+    
+    memset(_class, 0x00, sizeof(_class));
+    _classes = 1;
+    _nodes = 1;
+    _state = 0;
+    _out[0] = 0;
+    memset(_delta[0], MATCHER_NONE, sizeof(_delta[0]));
+    
+    /// 1. build the trie of the answers
+    for (uint8_t n = 0; n < count; n++)
+    {
+        char* p = answers[n];
+        
+        if (p == NULL) continue;
+        
+        // check there is room for the worst case of this answer
+        k = strlen(p);
+        if ((_nodes + k > MATCHER_MAX_NODES) || (_classes + k > MATCHER_MAX_CLASSES))
+        {
+            #if DEBUG_UART > 0
+                printf("[debug] answer too long for the matcher: %s\n", p);
+            #endif  
+            continue;
+        }
+        
+        node = 0;
+        for (; *p; p++)
+        {
+            c = _class[(uint8_t)*p];
+            if (c == 0)
+            {
+                c = _classes++;
+                _class[(uint8_t)*p] = c;
+            }
+            
+            if (_delta[node][c] == MATCHER_NONE)
+            {
+                next = _nodes++;
+                memset(_delta[next], MATCHER_NONE, sizeof(_delta[next]));
+                _out[next] = 0;
+                _delta[node][c] = next;
+            }
+            node = _delta[node][c];
+        }
+        
+        // keep the lowest index if the same answer is repeated
+        if (_out[node] == 0) _out[node] = n + 1;
+        added++;
+    }
+    
+    /// 2. complete the transitions following the failure links (BFS)
+    for (c = 0; c < _classes; c++)
+    {
+        next = _delta[0][c];
+        if (next == MATCHER_NONE)
+        {
+            _delta[0][c] = 0;
+        }
+        else
+        {
+            _fail[next] = 0;
+            queue[tail++] = next;
+        }
+    }
+    
+    while (head < tail)
+    {
+        node = queue[head++];
+        
+        // an answer ending in the failure state also ends here
+        if ((_out[_fail[node]] != 0) && ((_out[node] == 0) || (_out[_fail[node]] < _out[node])))
+        {
+            _out[node] = _out[_fail[node]];
+        }
+        
+        for (c = 0; c < _classes; c++)
+        {
+            next = _delta[node][c];
+            if (next == MATCHER_NONE)
+            {
+                _delta[node][c] = _delta[_fail[node]][c];
+            }
+            else
+            {
+                _fail[next] = _delta[_fail[node]][c];
+                queue[tail++] = next;
+            }
+        }
+    }
+    
+    return added;
+}
+
+
+/*
+ * 
+ * name: reset
+ * This function restarts the search from the initial state
+ * 
+ */
+void arduPiMatcher::reset()
+{
+    _state = 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//Response parser
+
+
+arduPiParser::arduPiParser(const uint8_t* data, uint16_t length, const char* delimiters)
+{
+    _pos = (const char*)data;
+    _end = (const char*)data + length;
+    setDelimiters(delimiters);
+}
+
+arduPiParser::arduPiParser(struct UARTView view, const char* delimiters)
+{
+    _pos = (const char*)view.data;
+    _end = (const char*)view.data + view.length;
+    setDelimiters(delimiters);
+}
+
+
+/*
+ * 
+ * name: setDelimiters
+ * This function builds the bitmap of the delimiter characters, so checking a 
+ * character does not depend on the number of delimiters
+ * 
+ * @param   const char* delimiters: string containing the delimiter characters
+ */
+void arduPiParser::setDelimiters(const char* delimiters)
+{
+    memset(_delim, 0x00, sizeof(_delim));
+    
+    for (; *delimiters; delimiters++)
+    {
+        uint8_t c = (uint8_t)*delimiters;
+        _delim[c >> 3] |= (1 << (c & 7));
+    }
+}
+
+
+/*
+ * 
+ * name: next
+ * This function skips the leading delimiters and returns the field up to the 
+ * next delimiter or the end of the response
+ * 
+ * @param   struct UARTView* field: view of the field
+ * @return  '0' if ok, '1' if there are no more fields
+ */
+uint8_t arduPiParser::next(struct UARTView* field)
+{
+    const char* start;
+    
+    while ((_pos < _end) && isDelimiter((uint8_t)*_pos)) _pos++;
+    
+    // the response may be NULL-terminated before its length
+    if ((_pos == _end) || (*_pos == 0x00))
+    {
+        _pos = _end;
+        return 1;
+    }
+    
+    start = _pos;
+    while ((_pos < _end) && (*_pos != 0x00) && !isDelimiter((uint8_t)*_pos)) _pos++;
+    
+    field->data = (const uint8_t*)start;
+    field->length = _pos - start;
+    return 0;
+}
+
+
+/*
+ * 
+ * name: skip
+ * @param   uint8_t n: number of fields to skip
+ * @return  '0' if ok, '1' if there are not so many fields
+ */
+uint8_t arduPiParser::skip(uint8_t n)
+{
+    struct UARTView field;
+    
+    while (n-- > 0)
+    {
+        if (next(&field) != 0) return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * 
+ * name: getString
+ * This function copies the next field as a NULL-terminated string. It is 
+ * truncated if it does not fit in 'str'
+ * 
+ * @param   char* str: buffer where the field is stored
+ * @param   uint16_t size: size of 'str'
+ * @return  '0' if ok, '1' if there are no more fields
+ */
+uint8_t arduPiParser::getString(char* str, uint16_t size)
+{
+    struct UARTView field;
+    
+    if ((size == 0) || (next(&field) != 0)) return 1;
+    
+    if (field.length > size-1) field.length = size-1;
+    memcpy(str, field.data, field.length);
+    str[field.length] = 0x00;
+    return 0;
+}
+
+
+uint8_t arduPiParser::getFloat(float* value)
+{
+    struct UARTView field;
+    const char* first;
+    
+    if (next(&field) != 0) return 1;
+    
+    first = (const char*)field.data;
+    if (toFloat(first, first + field.length, value) == first) return 1;
+    return 0;
+}
+
+
+uint8_t arduPiParser::getUint8(uint8_t* value)
+{
+    uint32_t aux;
+    
+    if (getUint32(&aux) != 0) return 1;
+    if (aux > 0xFF) return 1;
+    
+    *value = (uint8_t)aux;
+    return 0;
+}
+
+
+uint8_t arduPiParser::getUint32(uint32_t* value)
+{
+    struct UARTView field;
+    const char* first;
+    
+    if (next(&field) != 0) return 1;
+    
+    first = (const char*)field.data;
+    if (toUint32(first, first + field.length, value, 10) == first) return 1;
+    return 0;
+}
+
+
+uint8_t arduPiParser::getInt32(int32_t* value)
+{
+    struct UARTView field;
+    const char* first;
+    
+    if (next(&field) != 0) return 1;
+    
+    first = (const char*)field.data;
+    if (toInt32(first, first + field.length, value) == first) return 1;
+    return 0;
+}
+
+
+uint8_t arduPiParser::getInt(int* value)
+{
+    int32_t aux;
+    
+    if (getInt32(&aux) != 0) return 1;
+    
+    *value = (int)aux;
+    return 0;
+}
+
+
+uint8_t arduPiParser::getHex(uint32_t* value)
+{
+    struct UARTView field;
+    const char* first;
+    
+    if (next(&field) != 0) return 1;
+    
+    first = (const char*)field.data;
+    if (toUint32(first, first + field.length, value, 16) == first) return 1;
+    return 0;
+}
+
+
+/*
+ * 
+ * name: toUint32
+ * This function converts the unsigned number at the start of [first, last). 
+ * An optional '+' sign is accepted.
+ * 
+ * @param   uint8_t base: 10 or 16
+ * @return  pointer past the number, 'first' if error
+ */
+const char* arduPiParser::toUint32(const char* first, const char* last, uint32_t* value, uint8_t base)
+{
+    const char* p = first;
+    const char* digits;
+    uint32_t result = 0;
+    uint8_t d;
+    
+    if ((p < last) && (*p == '+')) p++;
+    digits = p;
+    
+    for (; p < last; p++)
+    {
+        if ((*p >= '0') && (*p <= '9')) d = *p - '0';
+        else if ((base == 16) && (*p >= 'a') && (*p <= 'f')) d = *p - 'a' + 10;
+        else if ((base == 16) && (*p >= 'A') && (*p <= 'F')) d = *p - 'A' + 10;
+        else break;
+        
+        // out of range
+        if (result > (0xFFFFFFFFUL - d) / base) return first;
+        result = result * base + d;
+    }
+    
+    if (p == digits) return first;
+    
+    *value = result;
+    return p;
+}
+
+
+/*
+ * 
+ * name: toInt32
+ * This function converts the signed decimal number at the start of 
+ * [first, last)
+ * 
+ * @return  pointer past the number, 'first' if error
+ */
+const char* arduPiParser::toInt32(const char* first, const char* last, int32_t* value)
+{
+    const char* p = first;
+    const char* end;
+    bool negative = false;
+    uint32_t aux;
+    
+    if ((p < last) && ((*p == '-') || (*p == '+')))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+    
+    // a second sign is not valid
+    if ((p < last) && (*p == '+')) return first;
+    
+    end = toUint32(p, last, &aux, 10);
+    if (end == p) return first;
+    
+    if (negative)
+    {
+        if (aux > 0x80000000UL) return first;
+        *value = (int32_t)(0 - aux);
+    }
+    else
+    {
+        if (aux > 0x7FFFFFFFUL) return first;
+        *value = (int32_t)aux;
+    }
+    return end;
+}
+
+
+/*
+ * 
+ * name: toFloat
+ * This function converts the decimal number at the start of [first, last), 
+ * with optional sign, fraction and exponent. It does not depend on the locale
+ * 
+ * @return  pointer past the number, 'first' if error
+ */
+const char* arduPiParser::toFloat(const char* first, const char* last, float* value)
+{
+    const char* p = first;
+    const char* q;
+    bool negative = false;
+    bool digits = false;
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    int32_t aux;
+    double result;
+    
+    if ((p < last) && ((*p == '-') || (*p == '+')))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+    
+    // integer part, digits that do not fit in the mantissa only scale it
+    for (; (p < last) && (*p >= '0') && (*p <= '9'); p++)
+    {
+        digits = true;
+        if (mantissa < 100000000000000000ULL) mantissa = mantissa * 10 + (*p - '0');
+        else exponent++;
+    }
+    
+    // fraction
+    if ((p < last) && (*p == '.'))
+    {
+        for (p++; (p < last) && (*p >= '0') && (*p <= '9'); p++)
+        {
+            digits = true;
+            if (mantissa < 100000000000000000ULL)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    
+    if (digits == false) return first;
+    
+    // exponent, only used if it is complete
+    if ((p < last) && ((*p == 'e') || (*p == 'E')))
+    {
+        q = toInt32(p + 1, last, &aux);
+        if (q != p + 1)
+        {
+            // beyond this range the result is 0 or infinity anyway
+            if (aux > 400) aux = 400;
+            if (aux < -400) aux = -400;
+            exponent += aux;
+            p = q;
+        }
+    }
+    
+    result = (double)mantissa;
+    if (mantissa == 0) result = 0.0;
+    else if (exponent > 0) result *= pow(10.0, exponent);
+    else if (exponent < 0) result /= pow(10.0, -exponent);
+    
+    *value = (float)(negative ? -result : result);
+    return p;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//Command statistics
+
+
+/*
+ * 
+ * name: reset
+ * This function clears the statistics of all the commands
+ * 
+ */
+void arduPiStats::reset()
+{
+    memset(_entry, 0x00, sizeof(_entry));
+    _last = -1;
+    _last_timeout = false;
+    _dropped = 0;
+    __sync_synchronize();
+}
+
+
+/*
+ * 
+ * name: getPrefix
+ * This function gets the command name the statistics are kept by: the 
+ * command up to its arguments plus the AT verb form, so "AT+COPS=1,..." is 
+ * "AT+COPS=", "AT+COPS?" and "AT+COPS=?" keep their own latencies (a read 
+ * or a test answers at once, a set may search the network), and 
+ * "mac set deveui 0004A3..." is "mac set deveui".
+ * 
+ * @param   struct ATCommand* cmd: command
+ * @param   char* prefix: buffer of UART_STATS_PREFIX_SIZE bytes
+ */
+void arduPiStats::getPrefix(struct ATCommand *cmd, char* prefix)
+{
+    uint16_t length;
+    uint8_t n = 0;
+    uint8_t c;
+    
+    if (cmd->command == NULL)
+    {
+        if ((cmd->answers != NULL) && (cmd->count > 0)) strcpy(prefix, "(wait)");
+        else strcpy(prefix, "(read)");
+        return;
+    }
+    
+    length = (cmd->clength != 0) ? cmd->clength : strlen(cmd->command);
+    
+    while ((n < length) && (n < UART_STATS_PREFIX_SIZE-1))
+    {
+        c = (uint8_t)cmd->command[n];
+        
+        if (c == ' ')
+        {
+            // words are part of the name, numbers and values are not
+            if ((n+1 >= length) || (cmd->command[n+1] < 'a') || (cmd->command[n+1] > 'z')) break;
+        }
+        else if ((isalnum(c) == 0) && (strchr("+#$^&%*_", c) == NULL))
+        {
+            break;
+        }
+        prefix[n++] = c;
+    }
+    
+    // set "=", test "=?" and read "?" forms, only if the whole form fits
+    if ((n > 0) && (n < length) && (n+2 < UART_STATS_PREFIX_SIZE))
+    {
+        if (cmd->command[n] == '?')
+        {
+            prefix[n++] = '?';
+        }
+        else if (cmd->command[n] == '=')
+        {
+            prefix[n++] = '=';
+            if ((n < length) && (cmd->command[n] == '?')) prefix[n++] = '?';
+        }
+    }
+    prefix[n] = 0x00;
+    
+    // binary data sent with sendCommand(uint8_t*, uint16_t)
+    if (n == 0) strcpy(prefix, "(data)");
+}
+
+
+/*
+ * 
+ * name: find
+ * This function gets the entry of a command name. Entries are added with a 
+ * compare and swap, so several threads can record at the same time.
+ * 
+ * @param   const char* prefix: command name
+ * @param   bool create: 'true' to add the entry if it does not exist
+ * @return  entry of the command, NULL if not found or the table is full
+ */
+struct UARTCommandStats* arduPiStats::find(const char* prefix, bool create)
+{
+    uint32_t hash = 2166136261U;
+    uint8_t index;
+    
+    for (const char* p = prefix; *p != 0x00; p++)
+    {
+        hash = (hash ^ (uint8_t)*p) * 16777619U;
+    }
+    
+    index = hash % UART_STATS_COMMANDS;
+    
+    for (uint8_t i = 0; i < UART_STATS_COMMANDS; i++)
+    {
+        struct UARTCommandStats* entry = &_entry[index];
+        
+        if ((entry->state == 0) && (create == true))
+        {
+            if (__sync_bool_compare_and_swap(&entry->state, 0, 1))
+            {
+                strncpy(entry->prefix, prefix, UART_STATS_PREFIX_SIZE-1);
+                entry->prefix[UART_STATS_PREFIX_SIZE-1] = 0x00;
+                __sync_synchronize();
+                entry->state = 2;
+                return entry;
+            }
+        }
+        
+        if (entry->state == 0) return NULL;
+        
+        // another thread is adding this entry
+        while (entry->state == 1) __sync_synchronize();
+        
+        if (strcmp(entry->prefix, prefix) == 0) return entry;
+        
+        index = (index + 1) % UART_STATS_COMMANDS;
+    }
+    
+    return NULL;
+}
+
+
+/*
+ * 
+ * name: bucket
+ * This function gets the bucket of a latency: one bucket per millisecond up 
+ * to 3 ms and then 4 buckets per power of 2, so the error is below 25%.
+ * 
+ * @param   uint32_t value: latency (ms)
+ * @return  bucket index
+ */
+uint8_t arduPiStats::bucket(uint32_t value)
+{
+    uint8_t exponent = 0;
+    uint32_t index;
+    
+    if (value < 4) return value;
+    
+    while ((value >> exponent) > 1) exponent++;
+    
+    index = 4 + (exponent-2)*4 + ((value >> (exponent-2)) & 0x03);
+    
+    return (index < UART_STATS_BUCKETS) ? index : UART_STATS_BUCKETS-1;
+}
+
+
+/*
+ * 
+ * name: bucketLimit
+ * @param   uint8_t index: bucket index
+ * @return  highest latency of the bucket (ms)
+ */
+uint32_t arduPiStats::bucketLimit(uint8_t index)
+{
+    uint8_t exponent;
+    uint8_t sub;
+    
+    if (index < 4) return index;
+    
+    exponent = (index-4)/4 + 2;
+    sub = (index-4)%4;
+    
+    return ((uint32_t)(5 + sub) << (exponent-2)) - 1;
+}
+
+
+/*
+ * 
+ * name: percentile
+ * This function gets a percentile of the latency of the answered commands 
+ * from the histogram, rounded up to the end of its bucket.
+ * 
+ * @param   struct UARTCommandStats* entry: command
+ * @param   uint8_t percent: percentile (1-100)
+ * @return  latency (ms), '0' if there are no answers
+ */
+uint32_t arduPiStats::percentile(struct UARTCommandStats* entry, uint8_t percent)
+{
+    uint32_t total = 0;
+    uint32_t rank;
+    uint32_t sum = 0;
+    
+    for (uint8_t b = 0; b < UART_STATS_BUCKETS; b++) total += entry->histogram[b];
+    if (total == 0) return 0;
+    
+    // rank of the percentile, rounded up
+    rank = ((uint64_t)total * percent + 99) / 100;
+    if (rank == 0) rank = 1;
+    
+    for (uint8_t b = 0; b < UART_STATS_BUCKETS; b++)
+    {
+        sum += entry->histogram[b];
+        if (sum >= rank) return bucketLimit(b);
+    }
+    
+    return bucketLimit(UART_STATS_BUCKETS-1);
+}
+
+
+/*
+ * 
+ * name: record
+ * This function adds a completed command to the statistics. A command sent 
+ * again right after it timed out is counted as a retry.
+ * 
+ * @param   struct ATCommand* cmd: completed command
+ */
+void arduPiStats::record(struct ATCommand *cmd)
+{
+    char prefix[UART_STATS_PREFIX_SIZE];
+    struct UARTCommandStats* entry;
+    bool answers = (cmd->answers != NULL) && (cmd->count > 0);
+    bool timeout = (answers == true) && (cmd->answer == 0);
+    int16_t index;
+    
+    getPrefix(cmd, prefix);
+    
+    entry = find(prefix, true);
+    if (entry == NULL)
+    {
+        __sync_fetch_and_add(&_dropped, 1);
+        return;
+    }
+    index = entry - _entry;
+    
+    __sync_fetch_and_add(&entry->count, 1);
+    if (cmd->command != NULL)
+    {
+        if ((_last == index) && (_last_timeout == true))
+        {
+            __sync_fetch_and_add(&entry->retries, 1);
+        }
+        __sync_fetch_and_add(&entry->bytesOut, 
+            (cmd->clength != 0) ? cmd->clength : strlen(cmd->command));
+        
+        _last = index;
+        _last_timeout = timeout;
+    }
+    __sync_fetch_and_add(&entry->bytesIn, cmd->length);
+    
+    if ((cmd->cme >= 0) || (cmd->cms >= 0)) __sync_fetch_and_add(&entry->errors, 1);
+    
+    if (timeout == true)
+    {
+        __sync_fetch_and_add(&entry->timeouts, 1);
+        return;
+    }
+    
+    __sync_fetch_and_add(&entry->totalTime, cmd->elapsed);
+    __sync_fetch_and_add(&entry->histogram[bucket(cmd->elapsed)], 1);
+}
+
+
+/*
+ * 
+ * name: append
+ * This function appends formatted text to 'buffer' like snprintf. 'length' 
+ * counts the whole text even when it does not fit.
+ * 
+ */
+void arduPiStats::append(char* buffer, uint32_t size, uint32_t* length, const char* format, ...)
+{
+    va_list args;
+    int n;
+    
+    va_start(args, format);
+    if (*length < size)
+    {
+        n = vsnprintf(buffer + *length, size - *length, format, args);
+    }
+    else
+    {
+        n = vsnprintf(NULL, 0, format, args);
+    }
+    va_end(args);
+    
+    if (n > 0) *length += n;
+}
+
+
+/*
+ * 
+ * name: write
+ * This function writes the statistics of every command seen. The JSON 
+ * histograms list the non-empty buckets as [highest latency, count]. The 
+ * Prometheus text keeps every metric in one group, as the format requires, 
+ * with cumulative buckets.
+ * 
+ * @param   char* buffer: output, always NULL-terminated
+ * @param   uint32_t size: size of 'buffer'
+ * @param   uint8_t format: STATS_JSON or STATS_PROMETHEUS
+ * @param   uint8_t uart: uart number for the labels
+ * @return  length of the whole output
+ */
+uint32_t arduPiStats::write(char* buffer, uint32_t size, uint8_t format, uint8_t uart)
+{
+    static const char* counters[] = { "commands", "timeouts", "retries", 
+                                      "errors", "bytes_out", "bytes_in" };
+    const char* name = "arduPi_uart_command_latency_ms";
+    struct UARTCommandStats* entry;
+    uint32_t length = 0;
+    uint32_t total;
+    uint32_t value;
+    bool first = true;
+    
+    if (size > 0) buffer[0] = 0x00;
+    
+    if (format == STATS_JSON)
+    {
+        append(buffer, size, &length, "{\"uart\":%u,\"dropped\":%lu,\"commands\":[", 
+            uart, (unsigned long)_dropped);
+        
+        for (uint8_t i = 0; i < UART_STATS_COMMANDS; i++)
+        {
+            entry = &_entry[i];
+            if (entry->state != 2) continue;
+            
+            append(buffer, size, &length, 
+                "%s{\"command\":\"%s\",\"count\":%lu,\"timeouts\":%lu,\"retries\":%lu,"
+                "\"errors\":%lu,\"bytes_out\":%lu,\"bytes_in\":%lu,\"total_ms\":%lu,\"histogram\":[",
+                (first == true) ? "" : ",", entry->prefix,
+                (unsigned long)entry->count, (unsigned long)entry->timeouts, 
+                (unsigned long)entry->retries, (unsigned long)entry->errors, 
+                (unsigned long)entry->bytesOut, (unsigned long)entry->bytesIn, 
+                (unsigned long)entry->totalTime);
+            first = false;
+            
+            total = 0;
+            for (uint8_t b = 0; b < UART_STATS_BUCKETS; b++)
+            {
+                if (entry->histogram[b] == 0) continue;
+                
+                append(buffer, size, &length, "%s[%lu,%lu]", (total == 0) ? "" : ",", 
+                    (unsigned long)bucketLimit(b), (unsigned long)entry->histogram[b]);
+                total += entry->histogram[b];
+            }
+            append(buffer, size, &length, "]}");
+        }
+        
+        append(buffer, size, &length, "]}");
+        return length;
+    }
+    
+    // latency histograms of the answered commands
+    append(buffer, size, &length, "# TYPE %s histogram\n", name);
+    
+    for (uint8_t i = 0; i < UART_STATS_COMMANDS; i++)
+    {
+        entry = &_entry[i];
+        if (entry->state != 2) continue;
+        
+        total = 0;
+        for (uint8_t b = 0; b < UART_STATS_BUCKETS; b++)
+        {
+            if (entry->histogram[b] == 0) continue;
+            
+            total += entry->histogram[b];
+            append(buffer, size, &length, "%s_bucket{uart=\"%u\",command=\"%s\",le=\"%lu\"} %lu\n", 
+                name, uart, entry->prefix, (unsigned long)bucketLimit(b), (unsigned long)total);
+        }
+        append(buffer, size, &length, "%s_bucket{uart=\"%u\",command=\"%s\",le=\"+Inf\"} %lu\n", 
+            name, uart, entry->prefix, (unsigned long)total);
+        append(buffer, size, &length, "%s_sum{uart=\"%u\",command=\"%s\"} %lu\n", 
+            name, uart, entry->prefix, (unsigned long)entry->totalTime);
+        append(buffer, size, &length, "%s_count{uart=\"%u\",command=\"%s\"} %lu\n", 
+            name, uart, entry->prefix, (unsigned long)total);
+    }
+    
+    for (uint8_t c = 0; c < sizeof(counters)/sizeof(counters[0]); c++)
+    {
+        append(buffer, size, &length, "# TYPE arduPi_uart_%s_total counter\n", counters[c]);
+        
+        for (uint8_t i = 0; i < UART_STATS_COMMANDS; i++)
+        {
+            entry = &_entry[i];
+            if (entry->state != 2) continue;
+            
+            switch (c)
+            {
+                case 0:  value = entry->count; break;
+                case 1:  value = entry->timeouts; break;
+                case 2:  value = entry->retries; break;
+                case 3:  value = entry->errors; break;
+                case 4:  value = entry->bytesOut; break;
+                default: value = entry->bytesIn; break;
+            }
+            append(buffer, size, &length, "arduPi_uart_%s_total{uart=\"%u\",command=\"%s\"} %lu\n", 
+                counters[c], uart, entry->prefix, (unsigned long)value);
+        }
+    }
+    
+    return length;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+//Parse functions
+
+
+/*!
+ * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
+ *          as inputs in delimiters. '_buffer' is not modified.
+ *          For instance _buffer stores: "<response>\r\n"
+ *          Then you can call: parseString(data, sizeof(data),"\r\n")
+ * 
+ * @param   char* str: pointer to the buffer where parsed data is stored
+ * @param   uint16_t size: size of input 'str' buffer
+ * @param   char* delimiters: string containing the delimiter characters
+ * 
+ * @return  
+ *  @arg    '0' if ok
+ *  @arg    '1' if error
+ */
+uint8_t arduPiUART::parseString(char* str, uint16_t size, char* delimiters)
+{
+    arduPiParser parser(_buffer, _length, delimiters);
+    
+    return parser.getString(str, size);
+}
+
+
+/*!
+ * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
+ *          as inputs in delimiters. '_buffer' is not modified.
+ *          For instance _buffer stores: "<response>\r\n"
+ *          Then you can call: parseString(data, sizeof(data),"\r\n")
+ * 
+ * @param   char* str: pointer to the buffer where parsed data is stored
+ * @param   uint16_t size: size of input 'str' buffer
+ * @param   char* delimiters: string containing the delimiter characters
+ * @param   uint8_t n: number of element to search for in the string of elements
+ * 
+ * @return  
+ *  @arg    '0' if ok
+ *  @arg    '1' if error
+ */
+uint8_t arduPiUART::parseString(char* str, uint16_t size, char* delimiters, uint8_t n)
+{
+    arduPiParser parser(_buffer, _length, delimiters);
+    
+    if ((n == 0) || (parser.skip(n-1) != 0)) return 1;
+    
+    return parser.getString(str, size);
+}
+
+
+/*!
+ * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
+ *          as inputs in delimiters. '_buffer' is not modified.
+ *          For instance _buffer stores: "<value>\r\n"
+ *          Then you can call: parseFloat(&variable, "\r\n")
+ * 
+ * @param   float* value: pointer to the variable where parsed data is stored
+ * @param   char* delimiters: string containing the delimiter characters
+ * 
+ * @return  
+ *  @arg    '0' if ok
+ *  @arg    '1' if error
+ */
+uint8_t arduPiUART::parseFloat(float* value, char* delimiters)
+{
+    arduPiParser parser(_buffer, _length, delimiters);
+    
+    return parser.getFloat(value);
+}
+
+
+/*!
+ * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
+ *          as inputs in delimiters. '_buffer' is not modified.
  *          For instance _buffer stores: "<value>\r\n"
  *          Then you can call: parseUint8(&variable, "\r\n")
  * 
  * @param   uint8_t* value: pointer to the variable where parsed data is stored
  * @param   char* delimiters: string containing the delimiter characters
+ * @param   uint8_t n: number of element to search for in the string of elements
  * 
  * @return  
  *  @arg    '0' if ok
  *  @arg    '1' if error
  */
-uint8_t arduPiUART::parseUint8(uint8_t* value, char* delimiters)
+uint8_t arduPiUART::parseUint8(uint8_t* value, char* delimiters, uint8_t n)
 {
-    // define the pointer to seek for token
-    char* pch;
-    uint32_t aux;
+    arduPiParser parser(_buffer, _length, delimiters);
     
-    pch = strtok( (char*)_buffer, delimiters);
+    if ((n == 0) || (parser.skip(n-1) != 0)) return 1;
     
-    if (pch != NULL)
-    {
-        aux = strtoul( pch, NULL, 10);
-        *value = (uint8_t)aux;
-        return 0;
-    }
-    else
-    {
-        return 1;
-    }
+    return parser.getUint8(value);
+}
+
+
+/*!
+ * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
+ *          as inputs in delimiters. '_buffer' is not modified.
+ *          For instance _buffer stores: "<value>\r\n"
+ *          Then you can call: parseUint8(&variable, "\r\n")
+ * 
+ * @param   uint8_t* value: pointer to the variable where parsed data is stored
+ * @param   char* delimiters: string containing the delimiter characters
+ * 
+ * @return  
+ *  @arg    '0' if ok
+ *  @arg    '1' if error
+ */
+uint8_t arduPiUART::parseUint8(uint8_t* value, char* delimiters)
+{
+    arduPiParser parser(_buffer, _length, delimiters);
+    
+    return parser.getUint8(value);
 }
 
 
 /*!
  * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
+ *          as inputs in delimiters. '_buffer' is not modified.
  *          For instance _buffer stores: "<value>\r\n"
  *          Then you can call: parseUint32(&variable, "\r\n")
  * 
@@ -850,31 +3054,21 @@ uint8_t arduPiUART::parseUint8(uint8_t* value, char* delimiters)
  */
 uint8_t arduPiUART::parseUint32(uint32_t* value, char* delimiters)
 {
-    // define the pointer to seek for token
-    char* pch;
-    
-    pch = strtok( (char*)_buffer, delimiters);
+    arduPiParser parser(_buffer, _length, delimiters);
     
-    if (pch != NULL)
-    {
-        *value = strtoul( pch, NULL, 10);
-        return 0;
-    }
-    else
-    {
-        return 1;
-    }
+    return parser.getUint32(value);
 }
 
 
 /*!
  * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
+ *          as inputs in delimiters. '_buffer' is not modified.
  *          For instance _buffer stores: "<value>\r\n"
  *          Then you can call: parseInt32(&variable, "\r\n")
  * 
  * @param   int32_t* value: pointer to the variable where parsed data is stored
  * @param   char* delimiters: string containing the delimiter characters
+ * @param   uint8_t n: number of element to search for in the string of elements
  * 
  * @return  
  *  @arg    '0' if ok
@@ -882,38 +3076,17 @@ uint8_t arduPiUART::parseUint32(uint32_t* value, char* delimiters)
  */
 uint8_t arduPiUART::parseInt32(int32_t* value, char* delimiters, uint8_t n)
 {
-    // define the pointer to seek for token
-    char* pch;
-    uint32_t aux;
+    arduPiParser parser(_buffer, _length, delimiters);
     
-    pch = strtok( (char*)_buffer, delimiters);
-    
-    for (int i = 0; i < n; i++)
-    {
-        if (pch == NULL)
-        {
-            return 1;
-        }       
-        
-        // check element
-        if (i+1 == n)
-        {
-            aux = strtol( pch, NULL, 10);
-            *value = (int32_t)aux;
-            return 0;
-        }
-        
-        // iterate to next element
-        pch = strtok(NULL, delimiters);
-    }
+    if ((n == 0) || (parser.skip(n-1) != 0)) return 1;
     
-    return 1;
+    return parser.getInt32(value);
 }
 
 
 /*!
  * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
+ *          as inputs in delimiters. '_buffer' is not modified.
  *          For instance _buffer stores: "<value>\r\n"
  *          Then you can call: parseInt32(&variable, "\r\n")
  * 
@@ -926,30 +3099,19 @@ uint8_t arduPiUART::parseInt32(int32_t* value, char* delimiters, uint8_t n)
  */
 uint8_t arduPiUART::parseInt32(int32_t* value, char* delimiters)
 {
-    // define the pointer to seek for token
-    char* pch;
+    arduPiParser parser(_buffer, _length, delimiters);
     
-    pch = strtok( (char*)_buffer, delimiters);
-    
-    if (pch != NULL)
-    {
-        *value = strtol( pch, NULL, 10);
-        return 0;
-    }
-    else
-    {
-        return 1;
-    }
+    return parser.getInt32(value);
 }
 
 
 /*!
  * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
- *          as inputs in delimiters. 
+ *          as inputs in delimiters. '_buffer' is not modified.
  *          For instance _buffer stores: "<value>\r\n"
- *          Then you can call: parseUint32(&variable, "\r\n")
+ *          Then you can call: parseInt(&variable, "\r\n")
  * 
- * @param   uint16_t* value: pointer to the variable where parsed data is stored
+ * @param   int* value: pointer to the variable where parsed data is stored
  * @param   char* delimiters: string containing the delimiter characters
  * 
  * @return  
@@ -958,65 +3120,117 @@ uint8_t arduPiUART::parseInt32(int32_t* value, char* delimiters)
  */
 uint8_t arduPiUART::parseInt(int* value, char* delimiters)
 {
-    // define the pointer to seek for token
-    char* pch;
+    arduPiParser parser(_buffer, _length, delimiters);
+    
+    return parser.getInt(value);
+}
+
+
+/*!
+ * @brief   It parses the contents in '_buffer' escaping the delimiters indicated
+ *          as inputs in delimiters. '_buffer' is not modified.
+ *          For instance _buffer stores: "<hex value>\r\n"
+ *          Then you can call: parseHex(&variable, "\r\n")
+ * 
+ * @param   uint8_t* value: pointer to the variable where parsed data is stored
+ * @param   char* delimiters: string containing the delimiter characters
+ * 
+ * @return  
+ *  @arg    '0' if ok
+ *  @arg    '1' if error
+ */
+uint8_t arduPiUART::parseHex(uint8_t* value, char* delimiters)
+{
+    arduPiParser parser(_buffer, _length, delimiters);
+    uint32_t aux;
     
-    pch = strtok( (char*)_buffer, delimiters);
+    if ((parser.getHex(&aux) != 0) || (aux > 0xFF)) return 1;
     
-    if (pch != NULL)
-    {
-        *value = atoi(pch);
-        return 0;
-    }
-    else
-    {
-        return 1;
-    }
+    *value = (uint8_t)aux;
+    return 0;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Transport functions
 
+// The Raspberry Pi has a single uart, SOCKET1 reaches it only through the 
+// multiplexer of the Multiprotocol shield, i.e. with arduPiUARTScheduler
+#define SERIAL_PORT(portNum)    ((portNum) == UART0)
+
+//! true while the uart device is open
+static bool serial_open = false;
+
 
 void beginSerial(long baud, uint8_t portNum)
 {
-    if (portNum == 0) 
+    if (SERIAL_PORT(portNum))
+    {
+        // reopen with the new settings instead of leaking the descriptor
+        Serial.lock();
+        if (serial_open == true) Serial.end();
         Serial.begin(baud);
+        serial_open = true;
+        Serial.unlock();
+    }
 }
 
 
 void closeSerial(uint8_t portNum)
 {
-    if (portNum == 0) 
-        Serial.end();   
+    if (SERIAL_PORT(portNum))
+    {
+        Serial.lock();
+        if (serial_open == true) Serial.end();
+        serial_open = false;
+        Serial.unlock();
+    }
 }
 
 
 void serialWrite(unsigned char c, uint8_t portNum)
 {
-    if (portNum == 0) 
+    if (SERIAL_PORT(portNum)) 
         Serial.write(c);
 }
 
 
 int serialAvailable(uint8_t portNum)
 {
-    if (portNum == 0) 
+    if (SERIAL_PORT(portNum)) 
         return Serial.available();
+    return 0;
 }
 
 
 int serialRead(uint8_t portNum)
 {
-    if (portNum == 0) 
+    if (SERIAL_PORT(portNum)) 
         return Serial.read();
+    return -1;
+}
+
+
+int serialReadBuffer(uint8_t* buffer, int size, uint8_t portNum)
+{
+    if (SERIAL_PORT(portNum)) 
+        return Serial.readAvailable((char*)buffer, size);
+    return 0;
+}
+
+
+int serialWait(int timeout, uint8_t portNum)
+{
+    if (SERIAL_PORT(portNum)) 
+        return Serial.waitAvailable(timeout);
+    delay(timeout);
+    return 0;
 }
 
 
 void serialFlush(uint8_t portNum)
 {
-    if (portNum == 0) 
+    if (SERIAL_PORT(portNum)) 
         Serial.flush();
 }
 
@@ -72,9 +72,27 @@
 #define DEF_COMMAND_TIMEOUT   5000
 
 /*! \def DEF_COMMAND_DELAY
-    \brief default time to wait after sending command
+    \brief default minimum gap between two consecutive commands. Answers are 
+    matched as soon as they arrive, so no gap is needed unless the module 
+    requires a guard time between commands
  */
-#define DEF_COMMAND_DELAY     100
+#define DEF_COMMAND_DELAY     0
+ 
+/*! \def DEF_IDLE_TIMEOUT
+    \brief default time without receiving bytes that ends a read (ms)
+ */
+#define DEF_IDLE_TIMEOUT      20
+ 
+/*! \def DEF_ADAPTIVE_MINIMUM
+    \brief default lowest timeout set by the adaptive timeouts (ms)
+ */
+#define DEF_ADAPTIVE_MINIMUM  100
+
+/*! \def DEF_ADAPTIVE_SAMPLES
+    \brief default number of answers of a command needed before its timeout 
+    is adapted
+ */
+#define DEF_ADAPTIVE_SAMPLES  20
  
 /*! \def DEF_BAUD_RATE
     \brief default baudrate
@@ -98,6 +116,8 @@ extern "C"{
     void serialWrite(unsigned char, uint8_t);
     int serialAvailable(uint8_t);
     int serialRead(uint8_t);
+    int serialReadBuffer(uint8_t*, int, uint8_t);
+    int serialWait(int, uint8_t);
     void serialFlush(uint8_t);
 
     void printByte(unsigned char c, uint8_t);
@@ -108,20 +128,535 @@ extern "C"{
 #endif
 
 
+/*! \def MATCHER_MAX_NODES
+    \brief maximum number of states of the response matcher (sum of the 
+    lengths of the expected answers plus one)
+ */
+#define MATCHER_MAX_NODES     255
+
+/*! \def MATCHER_MAX_CLASSES
+    \brief maximum number of different characters in the expected answers 
+    plus one
+ */
+#define MATCHER_MAX_CLASSES   64
+
+/*! \def MATCHER_NONE
+    \brief empty transition while the matcher is being built
+ */
+#define MATCHER_NONE          0xFF
+
+
+/*! \def UART_BUFFER_SIZE
+    \brief initial capacity of the response buffer
+ */
+#define UART_BUFFER_SIZE      512
+
+/*! \def UART_BUFFER_MAX
+    \brief maximum capacity the response buffer can grow to
+ */
+#define UART_BUFFER_MAX       16384
+
+/*! \def UART_RX_RING_SIZE
+    \brief size of the ring where the received bytes are kept until a command 
+    consumes them (power of 2)
+ */
+#define UART_RX_RING_SIZE     4096
+
+/*! \def UART_POLL_TIMEOUT
+    \brief maximum time to sleep waiting for data before checking the 
+    timeouts and the command queue again (ms)
+ */
+#define UART_POLL_TIMEOUT     1
+
+/*! \def UART_READ_CHUNK
+    \brief maximum number of bytes taken from the uart in a single read
+ */
+#define UART_READ_CHUNK       256
+
+/*! \def URC_MAX_HANDLERS
+    \brief maximum number of unsolicited result code handlers
+ */
+#define URC_MAX_HANDLERS      8
+
+/*! \def URC_LINE_SIZE
+    \brief maximum length of an unsolicited result code line
+ */
+#define URC_LINE_SIZE         256
+
+/*! \def URC_LINE_START
+    \brief states of the unsolicited result code filter
+ */
+#define URC_LINE_START        0
+#define URC_LINE_PREFIX       1
+#define URC_LINE_DATA         2
+#define URC_LINE_URC          3
+
+
+/*! \def UART_STATS_COMMANDS
+    \brief maximum number of different commands with statistics
+ */
+#define UART_STATS_COMMANDS   32
+
+/*! \def UART_STATS_PREFIX_SIZE
+    \brief maximum length of the command name the statistics are kept by, 
+    plus one
+ */
+#define UART_STATS_PREFIX_SIZE 20
+
+/*! \def UART_STATS_BUCKETS
+    \brief buckets of the latency histograms: 4 per power of 2, from 1 ms to 
+    about 35 minutes
+ */
+#define UART_STATS_BUCKETS    84
+
+/*! \def STATS_JSON
+    \brief formats of the statistics export
+ */
+#define STATS_JSON            0
+#define STATS_PROMETHEUS      1
+
+
+/******************************************************************************
+ * Structures
+ ******************************************************************************/
+
+/*! \struct ATCommand
+    \brief AT command for the command queue. The caller owns the structure 
+    and every buffer it points to until 'done' is set.
+    
+    If 'answers' is empty the command completes when 'rsize' bytes have been 
+    received or when no byte arrives for 'timeout' ms (the idle timeout if 0). 
+    If 'rsize' is also 0 it completes as soon as the command is sent.
+ */
+struct ATCommand
+{
+    //! command to send, NULL to only wait for the answers
+    char *command;
+    //! number of bytes of 'command', 0 if it is a NULL-terminated string
+    uint16_t clength;
+    
+    //! expected answers
+    char **answers;
+    uint8_t count;
+    uint32_t timeout;
+    
+    //! buffer for the response, it may be NULL if 'rsize' is 0
+    uint8_t *rbuf;
+    uint16_t rsize;
+    
+    //! function called from the queue thread when the command completes
+    void (*callback)(struct ATCommand *cmd);
+    void *arg;
+    
+    //! result: '0' if timeout, 'n' if answers[n-1]
+    uint8_t answer;
+    //! result: number of bytes stored in 'rbuf'
+    uint16_t length;
+    //! result: number of a "+CME ERROR: <n>" or "+CMS ERROR: <n>" answer, 
+    //! -1 if the module did not report it
+    int16_t cme;
+    int16_t cms;
+    //! result: time since the command was sent until it completed (ms)
+    uint32_t elapsed;
+    volatile bool done;
+    
+    //! the rest of an error line is being received
+    bool tail;
+    
+    struct ATCommand *next;
+};
+
+/*! \struct UARTView
+    \brief read-only view of a response, it is valid until the next command
+ */
+struct UARTView
+{
+    const uint8_t *data;
+    uint16_t length;
+};
+
+/*! \struct ATResult
+    \brief outcome of a command, captured while its answer is received. The 
+    error line is read along with the answer, so the error number needs no 
+    further wait.
+ */
+struct ATResult
+{
+    //! '0' if timeout, 'n' if answers[n-1]
+    uint8_t answer;
+    //! number of "+CME ERROR: <n>", -1 if none
+    int16_t cme;
+    //! number of "+CMS ERROR: <n>", -1 if none
+    int16_t cms;
+    //! response received, valid until the next command
+    struct UARTView response;
+    //! time since the command was sent until it completed (ms)
+    uint32_t elapsed;
+};
+
+/*! \struct URCHandler
+    \brief function called for every unsolicited line starting with 'prefix'
+ */
+struct URCHandler
+{
+    const char *prefix;
+    uint16_t length;
+    void (*handler)(const char *line, uint16_t length, void *arg);
+    void *arg;
+};
+
+
+/*! \struct UARTCommandStats
+    \brief counters of a command. They are updated with atomic operations, 
+    so they can be read from any thread while commands run
+ */
+struct UARTCommandStats
+{
+    //! command name, e.g. "AT+CREG?"
+    char prefix[UART_STATS_PREFIX_SIZE];
+    //! '0' free, '1' being claimed, '2' in use
+    volatile uint32_t state;
+    
+    volatile uint32_t count;
+    volatile uint32_t timeouts;
+    //! commands sent again after a timeout
+    volatile uint32_t retries;
+    //! answers with a "+CME ERROR" or "+CMS ERROR" number
+    volatile uint32_t errors;
+    volatile uint32_t bytesOut;
+    volatile uint32_t bytesIn;
+    
+    //! '1' if the last adapted timeout expired, so the next command waits 
+    //! the whole timeout and its latency can be learned
+    volatile uint32_t backoff;
+    
+    //! latency of the answered commands (ms)
+    volatile uint32_t totalTime;
+    volatile uint32_t histogram[UART_STATS_BUCKETS];
+};
+
+
 /******************************************************************************
  * Class
  ******************************************************************************/
 
+//! arduPiMatcher Class
+/*!
+    Aho-Corasick automaton that looks for several answers at once in the 
+    stream of received bytes. It is built once per command and then advanced 
+    one byte at a time with a single table lookup.
+ */
+class arduPiMatcher
+{
+
+private:
+
+    //! character class of every byte value, 0 for bytes not in any answer
+    uint8_t     _class[256];
+    uint8_t     _classes;
+    
+    //! transition table of the automaton
+    uint8_t     _delta[MATCHER_MAX_NODES][MATCHER_MAX_CLASSES];
+    
+    //! answer (index+1) found when reaching every state, 0 if none
+    uint8_t     _out[MATCHER_MAX_NODES];
+    
+    //! failure link of every state, only needed while building
+    uint8_t     _fail[MATCHER_MAX_NODES];
+    uint8_t     _nodes;
+    uint8_t     _state;
+
+public:
+
+    arduPiMatcher()
+    {
+        _classes = 1;
+        _nodes = 1;
+        _state = 0;
+        _out[0] = 0;
+        memset(_class, 0x00, sizeof(_class));
+        memset(_delta[0], 0x00, sizeof(_delta[0]));
+    };
+    
+    //! It builds the automaton for the given answers
+    /*!
+    \param char** answers : array of expected answers, NULL entries are skipped
+    \param uint8_t count : number of entries in 'answers'
+    \return number of answers added to the automaton
+    */
+    uint8_t begin(char** answers, uint8_t count);
+    
+    //! It restarts the search without rebuilding the automaton
+    void reset();
+    
+    //! It advances the automaton with a received byte
+    /*!
+    \param uint8_t c : received byte
+    \return '0' if no answer ends with this byte, 
+             'n' if answers[n-1] was found (lowest index first)
+    */
+    uint8_t feed(uint8_t c)
+    {
+        _state = _delta[_state][_class[c]];
+        return _out[_state];
+    };
+    
+    //! It returns the answer found in the current state (see feed)
+    uint8_t match()
+    {
+        return _out[_state];
+    };
+};
+
+
+//! arduPiParser Class
+/*!
+    Cursor over a response that splits it in fields separated by any of the 
+    delimiter characters, the same way strtok does, but without modifying the 
+    response. Several typed fields are read in a single pass and nothing is 
+    allocated, so it can be used from any thread.
+ */
+class arduPiParser
+{
+
+private:
+
+    const char* _pos;
+    const char* _end;
+    
+    //! bitmap of the delimiter characters
+    uint8_t     _delim[32];
+    
+    bool isDelimiter(uint8_t c)
+    {
+        return (_delim[c >> 3] & (1 << (c & 7))) != 0;
+    };
+
+public:
+
+    arduPiParser(const uint8_t* data, uint16_t length, const char* delimiters);
+    arduPiParser(struct UARTView view, const char* delimiters);
+    
+    //! It changes the delimiter characters for the next fields
+    void setDelimiters(const char* delimiters);
+    
+    //! It gets the next field (not NULL-terminated)
+    /*!
+    \param struct UARTView* field : view of the field inside the response
+    \return '0' if ok, '1' if there are no more fields
+    */
+    uint8_t next(struct UARTView* field);
+    
+    //! It skips 'n' fields
+    uint8_t skip(uint8_t n);
+    
+    //! They convert the next field. The field must start with a number
+    /*!
+    \return '0' if ok, '1' if there are no more fields or it is not a number
+    */
+    uint8_t getString(char* str, uint16_t size);
+    uint8_t getFloat(float* value);
+    uint8_t getUint8(uint8_t* value);
+    uint8_t getUint32(uint32_t* value);
+    uint8_t getInt32(int32_t* value);
+    uint8_t getInt(int* value);
+    uint8_t getHex(uint32_t* value);
+    
+    //! They convert the number at the start of [first, last) in the way of 
+    //! std::from_chars
+    /*!
+    \return pointer to the first character not used, 'first' if there is no 
+             number or it does not fit in the type
+    */
+    static const char* toUint32(const char* first, const char* last, uint32_t* value, uint8_t base);
+    static const char* toInt32(const char* first, const char* last, int32_t* value);
+    static const char* toFloat(const char* first, const char* last, float* value);
+};
+
+
+//! arduPiStats Class
+/*!
+    Per-command statistics of the AT engine: counters and log-linear latency 
+    histograms keyed by the command name. Recording is lock-free and does not 
+    print anything, so it does not disturb the timing of the commands.
+ */
+class arduPiStats
+{
+
+private:
+
+    struct UARTCommandStats _entry[UART_STATS_COMMANDS];
+    
+    //! entry of the previous command, to count the retries
+    volatile int16_t _last;
+    volatile bool _last_timeout;
+    
+    //! commands not recorded because the table is full
+    volatile uint32_t _dropped;
+    
+    //! It appends to 'buffer' like snprintf, counting what does not fit
+    static void append(char* buffer, uint32_t size, uint32_t* length, const char* format, ...);
+
+public:
+
+    arduPiStats()
+    {
+        reset();
+    };
+    
+    //! It clears all the statistics. It should be called while no command runs
+    void reset();
+    
+    //! It records a completed command
+    void record(struct ATCommand *cmd);
+    
+    //! It gets the entry of a command name, NULL if it has not been seen
+    /*!
+    \param const char* prefix : command name as returned by getPrefix
+    \param bool create : 'true' to add the entry if it does not exist
+    */
+    struct UARTCommandStats* find(const char* prefix, bool create);
+    
+    //! It gets the name the statistics of a command are kept by
+    /*!
+    The name ends at the first character that starts the arguments ('=', '?', 
+    '\r', a space before a number...), followed by the AT form "=", "=?" or 
+    "?", e.g. "AT+CGDCONT=", "AT+COPS?" or "mac set deveui".
+    Commands without command (waitFor, readBuffer) are "(wait)" and "(read)".
+    \param struct ATCommand* cmd : command
+    \param char* prefix : buffer of UART_STATS_PREFIX_SIZE bytes
+    */
+    static void getPrefix(struct ATCommand *cmd, char* prefix);
+    
+    //! It gets the histogram bucket of a latency
+    static uint8_t bucket(uint32_t value);
+    
+    //! It gets the highest latency of a histogram bucket
+    static uint32_t bucketLimit(uint8_t index);
+    
+    //! It gets a percentile of the latency of a command
+    /*!
+    \param struct UARTCommandStats* entry : command
+    \param uint8_t percent : percentile, e.g. 99
+    \return highest latency of the bucket the percentile falls in (ms)
+    */
+    static uint32_t percentile(struct UARTCommandStats* entry, uint8_t percent);
+    
+    //! It writes the statistics as JSON or Prometheus text
+    /*!
+    \param char* buffer : output, always NULL-terminated
+    \param uint32_t size : size of 'buffer'
+    \param uint8_t format : STATS_JSON or STATS_PROMETHEUS
+    \param uint8_t uart : uart number for the labels
+    \return length of the whole output, it did not fit if it is >= 'size'
+    */
+    uint32_t write(char* buffer, uint32_t size, uint8_t format, uint8_t uart);
+};
+
+
+class arduPiUARTScheduler;
+
 class arduPiUART
 {
 
+private:
+
+    //! '_buffer', the mutex and the queue belong to one object, no copies
+    arduPiUART(const arduPiUART&);
+    arduPiUART& operator=(const arduPiUART&);
+
 protected:
 
     uint8_t     _uart;
     uint32_t    _baudrate;
     uint32_t    _def_timeout;
     uint32_t    _def_delay;
+    uint32_t    _idle_timeout;
     bool        _flush_mode;
+    
+    //! instant of the last command sent or answer received
+    unsigned long _last_command;
+    
+    //! matcher for the expected answers of the current command
+    arduPiMatcher _matcher;
+    
+    //! received bytes not consumed yet, filled by rxPoll
+    uint8_t     _rx_ring[UART_RX_RING_SIZE];
+    uint16_t    _rx_head;
+    uint16_t    _rx_tail;
+    
+    //! unsolicited result code handlers and the line being filtered
+    struct URCHandler _urc[URC_MAX_HANDLERS];
+    uint8_t     _urc_count;
+    uint8_t     _urc_state;
+    uint8_t     _urc_match;
+    char        _urc_line[URC_LINE_SIZE];
+    uint16_t    _urc_length;
+    
+    //! command queue
+    bool        _queue_running;
+    pthread_t   _queue_thread;
+    pthread_mutex_t _queue_mutex;
+    pthread_cond_t  _queue_cond;
+    struct ATCommand *_queue_head;
+    struct ATCommand *_queue_tail;
+    
+    //! result of the last blocking command
+    struct ATResult _result;
+    
+    //! statistics of the commands run
+    arduPiStats _stats;
+    
+    //! adaptive timeouts, disabled if '_adaptive_factor' is 0
+    uint8_t     _adaptive_factor;
+    uint32_t    _adaptive_minimum;
+    uint16_t    _adaptive_samples;
+    
+    //! statistics of the active command if its timeout was adapted
+    struct UARTCommandStats *_active_adapted;
+    uint32_t    _active_timeout;
+    
+    //! command in progress
+    struct ATCommand *_active;
+    unsigned long _active_start;
+    unsigned long _active_last;
+    
+    //! It reads the available bytes through the URC filter
+    uint16_t rxPoll();
+    void rxFilter(uint8_t c);
+    void rxPush(uint8_t c);
+    void rxFlush();
+    
+    //! capacity of '_buffer'
+    uint16_t    _capacity;
+    
+    //! It makes room in '_buffer' for at least 'size' bytes
+    uint8_t reserveBuffer(uint32_t size);
+    
+    //! It runs a command in the calling thread or through the queue
+    void execute(struct ATCommand *cmd);
+    void startCommand(struct ATCommand *cmd);
+    bool stepCommand(struct ATCommand *cmd);
+    void runQueue();
+    void finishCommand(struct ATCommand *cmd);
+    
+    //! It shortens the timeout of a command from its latency statistics
+    void adaptTimeout(struct ATCommand *cmd);
+    
+    //! It checks if the response ends with the start of an error line
+    bool errorLine(struct ATCommand *cmd);
+    
+    //! It parses the error number of the response
+    void parseError(struct ATCommand *cmd);
+    
+    //! scheduler running the commands of this object, NULL if none
+    arduPiUARTScheduler *_scheduler;
+    
+    //! It returns the port for the transport functions
+    uint8_t serialPort();
+    
+    friend void * uartQueueFunction(void *arg);
+    friend class arduPiUARTScheduler;
 
 public:
 
@@ -130,15 +665,76 @@ public:
         _baudrate   = DEF_BAUD_RATE;
         _def_timeout= DEF_COMMAND_TIMEOUT;
         _def_delay  = DEF_COMMAND_DELAY;
+        _idle_timeout = DEF_IDLE_TIMEOUT;
+        _adaptive_factor = 0;
+        _adaptive_minimum = DEF_ADAPTIVE_MINIMUM;
+        _adaptive_samples = DEF_ADAPTIVE_SAMPLES;
+        _active_adapted = NULL;
+        _scheduler  = NULL;
         _flush_mode = true;
+        _last_command = 0;
+        _rx_head    = 0;
+        _rx_tail    = 0;
+        _urc_count  = 0;
+        _urc_state  = URC_LINE_START;
+        _urc_length = 0;
+        _urc_match  = URC_MAX_HANDLERS;
+        _queue_running = false;
+        _queue_head = NULL;
+        _queue_tail = NULL;
+        _active     = NULL;
+        memset(&_result, 0x00, sizeof(_result));
+        _result.cme = -1;
+        _result.cms = -1;
+        
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&_queue_mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+        pthread_cond_init(&_queue_cond, NULL);
+        
+        _buffer     = (uint8_t*)malloc(UART_BUFFER_SIZE);
+        if (_buffer == NULL)
+        {
+            // every command stores its response there
+            fprintf(stderr, "Unable to allocate the UART response buffer\n");
+            exit(1);
+        }
+        _capacity   = UART_BUFFER_SIZE;
+        _length     = 0;
+        _buffer[0]  = 0x00;
     };
     
-    //! buffer for rx data
-    uint8_t _buffer[512];
+    ~arduPiUART();
+    
+    //! buffer for rx data, always NULL-terminated at '_length'. It grows 
+    //! while a response is received so answers are not truncated
+    uint8_t* _buffer;
     
     //! length of the contents in '_buffer'
     uint16_t _length;
     
+    //! It returns a view of the last response, without copying it
+    struct UARTView getResponse();
+    
+    //! It sets the capacity of the response buffer
+    /*!
+    \param uint16_t size : new capacity, up to UART_BUFFER_MAX
+    \return '0' if ok, '1' if error (the buffer is not changed)
+    */
+    uint8_t setBufferSize(uint16_t size);
+    
+    //! It gets the capacity of the response buffer
+    uint16_t getBufferSize();
+    
+    //! It returns the result of the last sendCommand or waitFor
+    /*!
+    The answer matched, the "+CME ERROR"/"+CMS ERROR" number, the response and 
+    the elapsed time are captured in the same pass as the answer.
+    */
+    struct ATResult getResult();
+    
     //! It open the corresponding uart
     void beginUART();
     
@@ -151,12 +747,32 @@ public:
     //! It gets the time to wait for command responses
     uint32_t getTimeout();
     
-    //! It sets the time to wait after sending the command
+    //! It sets the minimum gap between two consecutive commands
     void setDelay( uint32_t newDelay );
     
-    //! It gets the time to wait after sending the command
+    //! It gets the minimum gap between two consecutive commands
     uint32_t getDelay();
     
+    //! It sets the time without receiving bytes that ends readBuffer
+    void setIdleTimeout( uint32_t newTimeout );
+    
+    //! It gets the time without receiving bytes that ends readBuffer
+    uint32_t getIdleTimeout();
+    
+    //! It enables the adaptive timeouts
+    /*!
+    The timeout of a command becomes 'factor' times the p99 latency of the 
+    previous answers to the same command (see getStats), so a module that 
+    does not answer is detected in the usual response time instead of the 
+    worst case. The timeout given by the library is the maximum. When an 
+    adapted timeout expires the next command waits the whole timeout.
+    \param uint8_t factor : multiple of the p99 latency, '0' to disable
+    \param uint32_t minimum : lowest timeout (ms)
+    \param uint16_t samples : answers needed before a timeout is adapted
+    */
+    void setAdaptiveTimeout(uint8_t factor, uint32_t minimum, uint16_t samples);
+    void setAdaptiveTimeout(uint8_t factor);
+    
     //! It sends a command through the selected uart expecting a specific answer
     /*!
     \param char* command : string to send to the module
@@ -240,6 +856,20 @@ public:
                         char* ans4, 
                         uint32_t timeout);
                         
+    //! It sends a command through the selected uart expecting any number of answers
+    /*!
+    \param char* command : string to send to the module
+    \param char** answers : strings expected to be answered by the module
+    \param uint8_t count : number of entries in 'answers'
+    \param uint32_t timeout : time to wait for responses before exit with error
+    \return '0' if timeout error, 
+            'n' if answers[n-1]
+     */ 
+    uint8_t sendCommand(char* command, 
+                        char** answers, 
+                        uint8_t count, 
+                        uint32_t timeout);
+                        
     //! It seeks 'pattern' inside the 'buffer' array
     bool find(uint8_t* buffer, uint16_t length, char* pattern); 
     
@@ -269,16 +899,76 @@ public:
     uint8_t waitFor(char* ans1, char* ans2, char* ans3, uint32_t timeout);
     uint8_t waitFor(char* ans1, char* ans2, char* ans3, char* ans4);
     uint8_t waitFor(char* ans1, char* ans2, char* ans3, char* ans4, uint32_t timeout);
+    uint8_t waitFor(char** answers, uint8_t count, uint32_t timeout);
     
     //! Read the contents of the rx buffer
     uint16_t readBuffer(uint16_t requestBytes);
     uint16_t readBuffer(uint16_t requestBytes, bool clearBuffer);
     
+    //! It reads one byte waiting up to 'timeout' ms, -1 if none arrives
+    int readByte(uint32_t timeout);
+    
     //! It waits depending on the baudrate used
     void latencyDelay();
+    
+    //! It waits the remaining part of the minimum gap between commands
+    void commandGap();
 
     void setUART(uint8_t uart);
     void setBaudrate(uint32_t baudrate);
+    
+    //! It starts the thread that runs the queued commands and reads the uart
+    /*!
+    While the queue is running the blocking functions (sendCommand, waitFor, 
+    readBuffer) are run through the queue too, so they can be mixed with 
+    queued commands.
+    \return '0' if ok, '1' if the thread could not be started
+    */
+    uint8_t beginQueue();
+    
+    //! It runs the pending commands and stops the queue thread
+    void endQueue();
+    
+    //! It adds a command at the end of the queue
+    /*!
+    It can be called from a callback or a URC handler. Callbacks and handlers 
+    run in the queue thread so they must not use the blocking functions.
+    \param struct ATCommand* cmd : command, owned by the caller until done
+    \return '0' if ok, '1' if the queue is not running
+    */
+    uint8_t queueCommand(struct ATCommand *cmd);
+    
+    //! It waits until the command has been completed
+    uint8_t waitCommand(struct ATCommand *cmd);
+    
+    //! It registers a function for the unsolicited lines starting with 'prefix'
+    /*!
+    The matching lines are removed from the responses and are not lost by the 
+    flush done before every command. The handler gets the line without the 
+    trailing "\r\n".
+    \param const char* prefix : start of the line, e.g. "+CMTI:" or "SRING"
+    \return '0' if ok, '1' if there is no room or the prefix is not valid
+    */
+    uint8_t addURC(const char *prefix, 
+                   void (*handler)(const char *line, uint16_t length, void *arg), 
+                   void *arg);
+    
+    //! It removes the handler registered for 'prefix'
+    void removeURC(const char *prefix);
+    
+    //! It writes the statistics of the commands run so far
+    /*!
+    Counters, timeouts, retries, bytes in and out and latency histograms of 
+    every command name.
+    \param char* buffer : output, always NULL-terminated
+    \param uint32_t size : size of 'buffer'
+    \param uint8_t format : STATS_JSON or STATS_PROMETHEUS
+    \return length of the whole output, it did not fit if it is >= 'size'
+    */
+    uint32_t getStats(char* buffer, uint32_t size, uint8_t format);
+    
+    //! It clears the statistics of the commands
+    void resetStats();
 
 protected:
 
@@ -303,8 +993,132 @@ protected:
     //! It parses the contents of _buffer and converts it to a int type
     uint8_t parseInt(int* value, char* delimiters); 
 
-    //! It parses the contents of _buffer and converts it to a uint16_t type
+    //! It parses the contents of _buffer and converts it from hexadecimal
     uint8_t parseHex(uint8_t* value, char* delimiters);
 };
 
+//! arduPiUARTScheduler Class
+/*!
+    Owner of the uart shared by SOCKET0 and SOCKET1 through the multiplexer of 
+    the Multiprotocol shield. The library objects attached to it keep using 
+    sendCommand, waitFor, readBuffer and queueCommand, but their commands are 
+    queued per socket and run by the scheduler thread one at a time. The 
+    multiplexer is switched only between commands, and the sockets with 
+    pending commands take turns.
+    
+    The bytes received while a socket is selected go to the object of that 
+    socket, so its URC handlers keep working and the flush before each command 
+    only discards data of its own socket. Nothing can be received from the 
+    socket that is not selected. Use hold/release when a socket needs the uart 
+    across several commands, e.g. a send followed by waitFor for the result.
+ */
+class arduPiUARTScheduler
+{
+
+private:
+
+    //! object attached to every socket
+    arduPiUART *_port[2];
+    
+    //! pending commands of every socket
+    struct ATCommand *_head[2];
+    struct ATCommand *_tail[2];
+    
+    //! socket whose object receives the bytes of the uart, -1 if none
+    int8_t      _current;
+    //! sockets whose object has the uart open
+    bool        _open[2];
+    //! baudrate the uart is open with
+    uint32_t    _baudrate;
+    //! socket served first when both have pending commands
+    uint8_t     _next;
+    
+    //! socket that holds the uart, -1 if none
+    int8_t      _holder;
+    uint8_t     _hold_depth;
+    
+    //! command in progress and its socket
+    struct ATCommand *_active;
+    int8_t      _active_socket;
+    
+    bool        _running;
+    pthread_t   _thread;
+    pthread_mutex_t _mutex;
+    pthread_cond_t  _cond;
+    
+    //! function that switches the multiplexer
+    void (*_select)(uint8_t socket);
+    
+    int8_t socketOf(arduPiUART *port);
+    void connect(uint8_t socket);
+    void complete(arduPiUART *port, struct ATCommand *cmd);
+    void run();
+    
+    friend void * uartSchedulerFunction(void *arg);
+
+public:
+
+    arduPiUARTScheduler();
+    ~arduPiUARTScheduler();
+    
+    //! It sets the function that connects the uart to a socket
+    /*!
+    \param void (*select)(uint8_t socket) : e.g. mpSelectUART for the 
+    Multiprotocol shield v2.0, which mpShield.setScheduler sets
+    */
+    void setSelect(void (*select)(uint8_t socket));
+    
+    //! It attaches a library object to a socket
+    /*!
+    \param arduPiUART* port : object, it must not have its own queue running
+    \param uint8_t socket : SOCKET0 or SOCKET1
+    \return '0' if ok, '1' if error
+    */
+    uint8_t attach(arduPiUART *port, uint8_t socket);
+    
+    //! It detaches a library object, its pending commands end with timeout
+    void detach(arduPiUART *port);
+    
+    //! They open and close the uart for an attached object
+    /*!
+    Called by beginUART and closeUART. The uart is opened by the next 
+    command of the socket and closed when neither socket uses it.
+    */
+    void open(arduPiUART *port);
+    void close(arduPiUART *port);
+    
+    //! It starts the scheduler thread
+    /*!
+    \return '0' if ok, '1' if the thread could not be started
+    */
+    uint8_t begin();
+    
+    //! It runs the pending commands and stops the scheduler thread
+    void end();
+    
+    //! It adds a command of an attached object to the queue of its socket
+    /*!
+    \return '0' if ok, '1' if the object is not attached or not running
+    */
+    uint8_t submit(arduPiUART *port, struct ATCommand *cmd);
+    
+    //! It keeps the uart on the socket of 'port' until release is called
+    /*!
+    It waits for the command of the other socket in progress, if any. The 
+    commands of the other socket stay queued meanwhile. Calls can be nested.
+    */
+    void hold(arduPiUART *port);
+    void release(arduPiUART *port);
+    
+    //! The same as hold/release, by socket (used by mp_UARTGuard)
+    void holdSocket(uint8_t socket);
+    void releaseSocket(uint8_t socket);
+};
+
+//! thread of the command queue, started by arduPiUART::beginQueue()
+void * uartQueueFunction(void *arg);
+
+//! thread of the scheduler, started by arduPiUARTScheduler::begin()
+void * uartSchedulerFunction(void *arg);
+
 #endif
@@ -37,6 +37,8 @@
  */
 arduPiUtils::arduPiUtils (void)
 {
+    cs_socket0_hold = 0;
+    cs_socket1_hold = 0;
 }
 
 
@@ -110,30 +112,8 @@ void arduPiUtils::setMuxUSB()
 //!*************************************************************
 void arduPiUtils::multiprotocolBegin()
 {
-    mp.begin();
-    delay(10);
-    
-    // I/O configuration
-    mp.pinMode(0, OUTPUT);
-    mp.pinMode(1, OUTPUT);
-    mp.pinMode(2, OUTPUT);
-    mp.pinMode(3, OUTPUT);
-    mp.pinMode(4, OUTPUT);
-    mp.pinMode(5, OUTPUT);
-    mp.pinMode(6, INPUT);
-    mp.pinMode(7, OUTPUT);
-    delay(100);
-    
-    // Initial State
-    mp.digitalWrite(0, LOW);
-    mp.digitalWrite(1, LOW);
-    mp.digitalWrite(2, LOW);
-    mp.digitalWrite(3, HIGH);
-    mp.digitalWrite(4, HIGH);
-    mp.digitalWrite(5, LOW);
-    //mp.digitalWrite(6, HIGH);
-    mp.digitalWrite(7, HIGH);
-    delay(100);
+    // the shield keeps its state, so it is only initialized once
+    mpShield.begin();
 }
 
 
@@ -145,7 +125,7 @@ void arduPiUtils::multiprotocolBegin()
 //!*************************************************************
 void arduPiUtils::disableMUX(void)
 {
-    mp.digitalWrite(4, HIGH);
+    mpShield.disableUART();
 }
 
 
@@ -157,14 +137,10 @@ void arduPiUtils::disableMUX(void)
 //!*************************************************************
 void arduPiUtils::setONSocket0()
 {
-    if (Utils.socket1_state != 1)
-        multiprotocolBegin();
-    
-    delay(5);
-    mp.digitalWrite(1, HIGH);
-
     Utils.socket0_state = 1;
-    delay(100);                     //wait for stablility
+    
+    if (mpShield.setPower(SOCKET0, HIGH) == 1)
+        delay(100);                 //wait for stablility
 }
 
 
@@ -176,9 +152,10 @@ void arduPiUtils::setONSocket0()
 //!*************************************************************
 void arduPiUtils::setOFFSocket0()
 {
-    mp.digitalWrite(1, LOW);
     Utils.socket0_state = 0;
-    delay(100);                     //wait for stablility
+    
+    if (mpShield.setPower(SOCKET0, LOW) == 1)
+        delay(100);                 //wait for stablility
 }
 
 
@@ -190,9 +167,8 @@ void arduPiUtils::setOFFSocket0()
 //!*************************************************************
 void arduPiUtils::setMUXSocket0()
 {
-    mp.digitalWrite(4, LOW);
-    mp.digitalWrite(5, LOW);
-    delay(100);                     //wait for stablility
+    // only switched if the UART is not already on SOCKET0
+    mpShield.selectUART(SOCKET0);
 }
 
 
@@ -204,8 +180,14 @@ void arduPiUtils::setMUXSocket0()
 //!*************************************************************
 void arduPiUtils::setCSSocket0()
 {
-    mp.digitalWrite(3, LOW);
-    delay(3);
+    // the hold depth and the expander pin change together
+    Wire.lock();
+    if (cs_socket0_hold == 0)
+    {
+        mp.digitalWrite(MP_CS_SOCKET0, LOW);
+        delayMicroseconds(MP_CS_SETTLE_US);
+    }
+    Wire.unlock();
 }
 
 
@@ -216,9 +198,56 @@ void arduPiUtils::setCSSocket0()
 //! Returns: void 
 //!*************************************************************
 void arduPiUtils::unsetCSSocket0()
-{   
-    mp.digitalWrite(3, HIGH);
-    delay(2);
+{
+    Wire.lock();
+    if (cs_socket0_hold == 0)
+    {
+        mp.digitalWrite(MP_CS_SOCKET0, HIGH);
+        delayMicroseconds(MP_CS_SETTLE_US);
+    }
+    Wire.unlock();
+}
+
+
+//!*************************************************************
+//! Name: holdCSSocket0()
+//! Description: Keeps the SPI of the SOCKET0 enabled across several 
+//!              accesses until releaseCSSocket0()
+//! Param : void                                        
+//! Returns: void 
+//!*************************************************************
+void arduPiUtils::holdCSSocket0()
+{
+    // the socket stays selected, so other threads must keep off the SPI 
+    // bus until the release. The bus is taken before the expander
+    SPI.lock();
+    Wire.lock();
+    if (cs_socket0_hold == 0) setCSSocket0();
+    cs_socket0_hold++;
+    Wire.unlock();
+}
+
+
+//!*************************************************************
+//! Name: releaseCSSocket0()
+//! Description: Ends the hold of holdCSSocket0(), the SPI of the SOCKET0 
+//!              is disabled by the outermost call
+//! Param : void                                        
+//! Returns: void 
+//!*************************************************************
+void arduPiUtils::releaseCSSocket0()
+{
+    Wire.lock();
+    if (cs_socket0_hold == 0)
+    {
+        Wire.unlock();
+        return;
+    }
+    
+    cs_socket0_hold--;
+    if (cs_socket0_hold == 0) unsetCSSocket0();
+    Wire.unlock();
+    SPI.unlock();
 }
 
 
@@ -230,15 +259,10 @@ void arduPiUtils::unsetCSSocket0()
 //!*************************************************************
 void arduPiUtils::setONSocket1()
 {
-    
-    if (Utils.socket0_state != 1)
-        multiprotocolBegin();
-    
-    delay(5);
-    mp.digitalWrite(0, HIGH);
-    
     Utils.socket1_state = 1;
-    delay(100);                     //wait for stablility
+    
+    if (mpShield.setPower(SOCKET1, HIGH) == 1)
+        delay(100);                 //wait for stablility
 }
 
 
@@ -250,9 +274,10 @@ void arduPiUtils::setONSocket1()
 //!*************************************************************
 void arduPiUtils::setOFFSocket1()
 {
-    mp.digitalWrite(0, LOW);
     Utils.socket1_state = 0;
-    delay(100);                     //wait for stablility
+    
+    if (mpShield.setPower(SOCKET1, LOW) == 1)
+        delay(100);                 //wait for stablility
 }
     
     
@@ -264,9 +289,8 @@ void arduPiUtils::setOFFSocket1()
 //!*************************************************************    
 void arduPiUtils::setMUXSocket1(void)
 {
-    mp.digitalWrite(4, LOW);
-    mp.digitalWrite(5, HIGH);
-    delay(100);                     //wait for stablility
+    // only switched if the UART is not already on SOCKET1
+    mpShield.selectUART(SOCKET1);
 }
 
 
@@ -277,8 +301,15 @@ void arduPiUtils::setMUXSocket1(void)
 //! Returns: void
 //!*************************************************************
 void arduPiUtils::setCSSocket1(void)
-{   
-    mp.digitalWrite(2, LOW);
+{
+    // the hold depth and the expander pin change together
+    Wire.lock();
+    if (cs_socket1_hold == 0)
+    {
+        mp.digitalWrite(MP_CS_SOCKET1, LOW);
+        delayMicroseconds(MP_CS_SETTLE_US);
+    }
+    Wire.unlock();
 }
 
 
@@ -290,7 +321,55 @@ void arduPiUtils::setCSSocket1(void)
 //!*************************************************************
 void arduPiUtils::unsetCSSocket1(void)
 {
-    mp.digitalWrite(2, HIGH);
+    Wire.lock();
+    if (cs_socket1_hold == 0)
+    {
+        mp.digitalWrite(MP_CS_SOCKET1, HIGH);
+        delayMicroseconds(MP_CS_SETTLE_US);
+    }
+    Wire.unlock();
+}
+
+
+//!*************************************************************
+//! Name: holdCSSocket1()
+//! Description: Keeps the SPI of the SOCKET1 enabled across several 
+//!              accesses until releaseCSSocket1()
+//! Param : void                                        
+//! Returns: void 
+//!*************************************************************
+void arduPiUtils::holdCSSocket1()
+{
+    // the socket stays selected, so other threads must keep off the SPI 
+    // bus until the release. The bus is taken before the expander
+    SPI.lock();
+    Wire.lock();
+    if (cs_socket1_hold == 0) setCSSocket1();
+    cs_socket1_hold++;
+    Wire.unlock();
+}
+
+
+//!*************************************************************
+//! Name: releaseCSSocket1()
+//! Description: Ends the hold of holdCSSocket1(), the SPI of the SOCKET1 
+//!              is disabled by the outermost call
+//! Param : void                                        
+//! Returns: void 
+//!*************************************************************
+void arduPiUtils::releaseCSSocket1()
+{
+    Wire.lock();
+    if (cs_socket1_hold == 0)
+    {
+        Wire.unlock();
+        return;
+    }
+    
+    cs_socket1_hold--;
+    if (cs_socket1_hold == 0) unsetCSSocket1();
+    Wire.unlock();
+    SPI.unlock();
 }
 
 
@@ -298,6 +377,30 @@ void arduPiUtils::unsetCSSocket1(void)
   // Conversion Functions                         //
   //////////////////////////////////////////////////
 
+// digits used to encode every nibble
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// value of every character as a hexadecimal digit, 0xFF if it is not one
+static const uint8_t hex_values[256] = 
+{
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0x0A,0x0B,0x0C,0x0D,0x0E,0x0F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0x0A,0x0B,0x0C,0x0D,0x0E,0x0F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF
+};
+
 /*
  * It converts a hexadecimal number stored in an array to a string (length is an 
  * input parameter). This function is used by the XBee module library in order to 
@@ -306,28 +409,69 @@ void arduPiUtils::unsetCSSocket1(void)
  */
 void arduPiUtils::hex2str(uint8_t* number, char* macDest, uint8_t length)
 {
-    uint8_t aux_1=0;
-    uint8_t aux_2=0;
+    // the caller provides room for 2*length+1 characters
+    hexEncode(number, length, macDest, 2*length + 1);
+}
 
-    for(int i=0;i<length;i++)
+
+/*
+ * It converts 'length' bytes to hexadecimal, two characters per byte looked 
+ * up in a table. Nothing is written but the terminator if 'str' is too small.
+ * 
+ */
+uint16_t arduPiUtils::hexEncode(const uint8_t* data, uint16_t length, char* str, uint16_t size)
+{
+    char* p = str;
+    
+    if (size == 0) return 0;
+    if ((uint32_t)length*2 + 1 > size)
     {
-        aux_1=number[i]/16;
-        aux_2=number[i]%16;
-        if (aux_1<10)
-        {
-            macDest[2*i]=aux_1+'0';
-        }
-        else{
-            macDest[2*i]=aux_1+('A'-10);
-        }
-        if (aux_2<10){
-            macDest[2*i+1]=aux_2+'0';
-        }
-        else{
-            macDest[2*i+1]=aux_2+('A'-10);
-        }
-    } 
-    macDest[length*2]='\0';
+        str[0] = '\0';
+        return 0;
+    }
+    
+    for (uint16_t i = 0; i < length; i++)
+    {
+        *p++ = hex_digits[data[i] >> 4];
+        *p++ = hex_digits[data[i] & 0x0F];
+    }
+    *p = '\0';
+    
+    return length*2;
+}
+
+
+/*
+ * It converts 'length' hexadecimal characters to bytes. All the input is 
+ * checked before 'data' is written, so 'data' is not modified on error.
+ * 
+ */
+int32_t arduPiUtils::hexDecode(const char* str, uint16_t length, uint8_t* data, uint16_t size)
+{
+    if ((length & 0x01) != 0) return -1;
+    if (length/2 > size) return -1;
+    if (hexSpan(str, length) != length) return -1;
+    
+    for (uint16_t i = 0; i < length/2; i++)
+    {
+        data[i] = (hex_values[(uint8_t)str[2*i]] << 4) | hex_values[(uint8_t)str[2*i + 1]];
+    }
+    
+    return length/2;
+}
+
+
+/*
+ * It counts the hexadecimal digits at the start of 'str', up to 'length'
+ * 
+ */
+uint16_t arduPiUtils::hexSpan(const char* str, uint16_t length)
+{
+    uint16_t i = 0;
+    
+    while ((i < length) && (hex_values[(uint8_t)str[i]] != 0xFF)) i++;
+    
+    return i;
 }
 
 
@@ -335,65 +479,202 @@ void arduPiUtils::hex2str(uint8_t* number, char* macDest, uint8_t length)
  * Function: Converts a float variable to a string
  * Returns: void
  *
- * Remarks: It is recommended to use the AVR std library function
- * http://www.nongnu.org/avr-libc/user-manual/group__avr__stdlib.html
- *
- *      char* dtostrf(  double      __val,
- *                      signed char     __width,
- *                      unsigned char   __prec,
- *                      char *      __s )
+ * Remarks: 'str' must have room for N+48 characters, enough for any float. 
+ * The number is rounded, see formatFloat
  *
  */
 void arduPiUtils::float2String (float fl, char str[], int N)
 {
+    if (N < 0) N = 0;
+    if (N > FLOAT_MAX_DECIMALS) N = FLOAT_MAX_DECIMALS;
+    
+    formatFloat(fl, (uint8_t)N, str, N + 48);
+}
 
-    uint8_t neg = false;
 
-    if( fl<0 ){
-        neg = true;
-        fl*=-1;
+/*
+ * Function: Converts a number to a string with a fixed number of decimals
+ * Returns: number of characters written, 0 if 'str' is too small
+ *
+ * Remarks: Numbers whose scaled value fits in 64 bits are converted with 
+ * integer arithmetic, without any allocation. Larger ones are left to 
+ * snprintf, which is exact for them too.
+ *
+ */
+uint16_t arduPiUtils::formatFloat(double value, uint8_t decimals, char* str, uint16_t size)
+{
+    // powers of ten up to FLOAT_MAX_DECIMALS
+    static const uint32_t scale[FLOAT_MAX_DECIMALS + 1] = 
+    {
+        1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 
+        10000000UL, 100000000UL, 1000000000UL
+    };
+    // sign, 20 digits, point and decimals
+    char digits[1 + 20 + 1 + FLOAT_MAX_DECIMALS];
+    char* p = digits + sizeof(digits);
+    const char* text;
+    uint16_t length;
+    uint64_t number;
+    uint32_t fraction;
+    double scaled;
+    bool neg;
+    int n;
+    
+    if (size == 0) return 0;
+    if (decimals > FLOAT_MAX_DECIMALS) decimals = FLOAT_MAX_DECIMALS;
+    
+    if (value != value)
+    {
+        text = "nan";
     }
-
-    float numeroFloat=fl;
-    int parteEntera[10];
-    int cifra;
-    long numero=(long)numeroFloat;
-    int size=0;
-
-    while(1){
-        size=size+1;
-        cifra=numero%10;
-        numero=numero/10;
-        parteEntera[size-1]=cifra;
-        if (numero==0){
-            break;
+    else if ((value > 1.0e308) || (value < -1.0e308))
+    {
+        text = (value > 0) ? "inf" : "-inf";
+    }
+    else
+    {
+        text = NULL;
+    }
+    
+    if (text != NULL)
+    {
+        length = strlen(text);
+        if (length >= size)
+        {
+            str[0] = '\0';
+            return 0;
+        }
+        memcpy(str, text, length + 1);
+        return length;
+    }
+    
+    neg = (value < 0);
+    scaled = (neg ? -value : value) * scale[decimals] + 0.5;
+    
+    if (scaled >= 18446744073709551616.0)
+    {
+        n = snprintf(str, size, "%.*f", decimals, value);
+        if ((n < 0) || (n >= size))
+        {
+            str[0] = '\0';
+            return 0;
         }
+        return n;
     }
+    
+    // digits are written backwards from the end of 'digits'
+    number = (uint64_t)scaled;
+    fraction = (uint32_t)(number % scale[decimals]);
+    number /= scale[decimals];
+    
+    for (uint8_t i = 0; i < decimals; i++)
+    {
+        *--p = '0' + (fraction % 10);
+        fraction /= 10;
+    }
+    if (decimals > 0) *--p = '.';
+    
+    do
+    {
+        *--p = '0' + (uint8_t)(number % 10);
+        number /= 10;
+    } while (number != 0);
+    
+    // no "-0" when the number rounds to zero
+    if (neg && (scaled >= 1.0)) *--p = '-';
+    
+    length = digits + sizeof(digits) - p;
+    if (length >= size)
+    {
+        str[0] = '\0';
+        return 0;
+    }
+    memcpy(str, p, length);
+    str[length] = '\0';
+    
+    return length;
+}
+
 
-    int indice=0;
-    if( neg ){
-        indice++;
-        str[0]='-';
+/*
+ * Function: Packs a number as a big endian fixed point integer
+ * Returns: '0' if ok, '1' if saturated or wrong arguments
+ *
+ */
+uint8_t arduPiUtils::packFixed(double value, double resolution, uint8_t bytes, bool sign, uint8_t* data)
+{
+    double scaled;
+    double lowest;
+    double highest;
+    int64_t number;
+    uint8_t error = 0;
+    
+    if ((bytes < 1) || (bytes > 4) || !(resolution > 0)) return 1;
+    
+    if (sign)
+    {
+        highest = (double)((1LL << (8*bytes - 1)) - 1);
+        lowest = -highest - 1;
     }
-    for (int i=size-1; i>=0; i--)
+    else
     {
-        str[indice]=parteEntera[i]+'0';
-        indice++;
+        highest = (double)((1LL << (8*bytes)) - 1);
+        lowest = 0;
     }
+    
+    scaled = value / resolution;
+    scaled = (scaled < 0) ? scaled - 0.5 : scaled + 0.5;
+    
+    // NaN is saturated to 0
+    if (scaled != scaled)
+    {
+        scaled = 0;
+        error = 1;
+    }
+    else if (scaled > highest)
+    {
+        scaled = highest;
+        error = 1;
+    }
+    else if (scaled < lowest)
+    {
+        scaled = lowest;
+        error = 1;
+    }
+    
+    number = (int64_t)scaled;
+    for (uint8_t i = 0; i < bytes; i++)
+    {
+        data[bytes - 1 - i] = (uint8_t)(number >> (8*i));
+    }
+    
+    return error;
+}
 
-    str[indice]='.';
-    indice++;
 
-    numeroFloat=(numeroFloat-(int)numeroFloat);
-    for (int i=1; i<=N ; i++)
+/*
+ * Function: Unpacks a number packed by packFixed
+ * Returns: the number, 0 if wrong arguments
+ *
+ */
+double arduPiUtils::unpackFixed(const uint8_t* data, uint8_t bytes, bool sign, double resolution)
+{
+    int64_t number = 0;
+    
+    if ((bytes < 1) || (bytes > 4)) return 0;
+    
+    for (uint8_t i = 0; i < bytes; i++)
     {
-        numeroFloat=numeroFloat*10;
-        cifra= (long)numeroFloat;
-        numeroFloat=numeroFloat-cifra;
-        str[indice]=char(cifra)+48;
-        indice++;
+        number = (number << 8) | data[i];
     }
-    str[indice]='\0';
+    
+    // sign extension
+    if (sign && (data[0] & 0x80))
+    {
+        number -= (1LL << (8*bytes));
+    }
+    
+    return number * resolution;
 }
 
 
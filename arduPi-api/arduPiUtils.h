@@ -54,6 +54,13 @@
 */
 #define MUX_SOCKET0_nSOCKET1    5
 
+/*! \def MP_CS_SETTLE_US
+    \brief Time for a Multiprotocol Shield v2.0 chip select line to settle 
+    (us). The expander output changes within 500 ns of the I2C write and the 
+    level shifters follow in tens of ns
+*/
+#define MP_CS_SETTLE_US         1
+
 /* USEFUL
  * Usefull definitions 
 */
@@ -88,6 +95,9 @@
 #define degrees(rad) ((rad)*RAD_TO_DEG)
 #define sq(x) ((x)*(x))
 
+//! Maximum number of decimals of formatFloat
+#define FLOAT_MAX_DECIMALS  9
+
 
 /******************************************************************************
  * Class
@@ -152,7 +162,7 @@ class arduPiUtils
   //////////////////////////////////////////////////
   //Support for "Multiprotocol Radio Shield v2.0" //
   //////////////////////////////////////////////////
-  //! Initialize the MCP230008 expansor
+  //! Initialize the MCP230008 expansor, only the first time it is called
   /*!  
   \return void
    */
@@ -189,6 +199,19 @@ class arduPiUtils
   \return void
    */
   void unsetCSSocket0();
+  //! Keep the Chip Select in Socket0 set until releaseCSSocket0
+  /*!  
+  The setCSSocket0/unsetCSSocket0 pairs in between, e.g. one per register 
+  access, do not touch the expander. The calling thread keeps the SPI bus 
+  until the release. Calls can be nested
+  \return void
+   */
+  void holdCSSocket0();
+  //! Release the Chip Select held by holdCSSocket0
+  /*!  
+  \return void
+   */
+  void releaseCSSocket0();
 
   // Socket1 management
   //! Set Multiplexor UART point to Socket1
@@ -216,10 +239,25 @@ class arduPiUtils
   \return void
    */
   void unsetCSSocket1();
+  //! Keep the Chip Select in Socket1 set until releaseCSSocket1
+  /*!  
+  The calling thread keeps the SPI bus until the release, see holdCSSocket0
+  \return void
+   */
+  void holdCSSocket1();
+  //! Release the Chip Select held by holdCSSocket1
+  /*!  
+  \return void
+   */
+  void releaseCSSocket1();
   
   //Socket internal state
   uint8_t socket0_state;
   uint8_t socket1_state;    
+  
+  //Chip Select hold depth, changed under Wire.lock() like the expander pins
+  uint8_t cs_socket0_hold;
+  uint8_t cs_socket1_hold;
 
 
   //////////////////////////////////////////////////
@@ -235,14 +273,87 @@ class arduPiUtils
    */
   void hex2str(uint8_t* number, char* macDest, uint8_t length);
 
+  //! It converts an array of bytes to a NULL-terminated hexadecimal string
+  /*!
+  \param const uint8_t* data : bytes to convert
+  \param uint16_t length : number of bytes
+  \param char* str : destination, 2*length+1 bytes are needed
+  \param uint16_t size : size of 'str'
+  \return number of characters written, 0 if 'str' is too small (then 
+  'str' is left empty)
+  \sa hexDecode(const char* str, uint16_t length, uint8_t* data, uint16_t size)
+   */
+  uint16_t hexEncode(const uint8_t* data, uint16_t length, char* str, uint16_t size);
+
+  //! It converts a hexadecimal string to an array of bytes
+  /*!
+  Upper and lower case digits are accepted.
+  \param const char* str : hexadecimal string
+  \param uint16_t length : number of characters to convert, it must be even
+  \param uint8_t* data : destination
+  \param uint16_t size : size of 'data'
+  \return number of bytes written, -1 if 'length' is odd, a character is not 
+  a hexadecimal digit or 'data' is too small
+  \sa hexEncode(const uint8_t* data, uint16_t length, char* str, uint16_t size)
+   */
+  int32_t hexDecode(const char* str, uint16_t length, uint8_t* data, uint16_t size);
+
+  //! It counts the hexadecimal digits at the start of a string
+  /*!
+  The count stops at the first character that is not a hexadecimal digit, 
+  including the NULL terminator.
+  \param const char* str : string to check
+  \param uint16_t length : maximum number of characters to check
+  \return number of hexadecimal digits
+   */
+  uint16_t hexSpan(const char* str, uint16_t length);
+
   //! It converts a float into a string
   /*!
   \param float fl : the float to convert
-  \param char str[] : the string where store the float converted
+  \param char str[] : the string where store the float converted, at least 
+  N+48 bytes long
   \param int N : the number of decimals
   \return void
+  \sa formatFloat(double value, uint8_t decimals, char* str, uint16_t size)
    */
   void float2String(float fl, char str[], int N);
+
+  //! It converts a number into a string with a fixed number of decimals
+  /*!
+  The number is rounded to the nearest value with 'decimals' decimals. No 
+  decimal point is written if 'decimals' is 0. NaN and infinite values are 
+  written as "nan", "inf" and "-inf".
+  \param double value : the number to convert
+  \param uint8_t decimals : number of decimals, up to FLOAT_MAX_DECIMALS
+  \param char* str : destination
+  \param uint16_t size : size of 'str'
+  \return number of characters written, 0 if 'str' is too small (then 'str' 
+  is left empty)
+   */
+  uint16_t formatFloat(double value, uint8_t decimals, char* str, uint16_t size);
+
+  //! It packs a number as a big endian fixed point integer
+  /*!
+  The number is stored as round(value/resolution), e.g. a temperature of 
+  21.37 with resolution 0.1 and 2 bytes is stored as 0x00D6. Values out of 
+  range are saturated.
+  \param double value : the number to pack
+  \param double resolution : value of the least significant bit
+  \param uint8_t bytes : size of the field, from 1 to 4
+  \param bool sign : true for two's complement, false for unsigned
+  \param uint8_t* data : destination, 'bytes' bytes are written
+  \return '0' if ok, '1' if the value was saturated or the arguments are 
+  wrong
+  \sa unpackFixed(const uint8_t* data, uint8_t bytes, bool sign, double resolution)
+   */
+  uint8_t packFixed(double value, double resolution, uint8_t bytes, bool sign, uint8_t* data);
+
+  //! It unpacks a number packed by packFixed
+  /*!
+  \return the number, 0 if the arguments are wrong
+   */
+  double unpackFixed(const uint8_t* data, uint8_t bytes, bool sign, double resolution);
 };
 
 extern arduPiUtils Utils;
@@ -21,30 +21,41 @@
 
 
 #include "arduPi.h"
+#include "arduPiBackend.h"
 
-struct bcm2835_peripheral gpio = {GPIO_BASE2};
-struct bcm2835_peripheral bsc_rev1 = {IOBASE + 0X205000};
-struct bcm2835_peripheral bsc_rev2 = {IOBASE + 0X804000};
-struct bcm2835_peripheral bsc0;
+// Peripheral blocks, set once by arduPiBackendBegin()
+struct bcm2835_peripheral gpio;
 volatile uint32_t *bcm2835_bsc01;
 
 void *spi0 = MAP_FAILED;
-static  uint8_t *spi0Mem = NULL;
 
-pthread_t idThread2;
-pthread_t idThread3;
-pthread_t idThread4;
-pthread_t idThread5;
-pthread_t idThread6;
-pthread_t idThread7;
-pthread_t idThread8;
-pthread_t idThread9;
-pthread_t idThread10;
-pthread_t idThread11;
-pthread_t idThread12;
-pthread_t idThread13;
+// Interrupt threads of the arduino pins 2 to 13
+static pthread_t interrupt_thread[14];
+static pthread_mutex_t interrupt_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-timeval start_program, end_point;
+// The function select registers are shared by all the pins
+static pthread_mutex_t fsel_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const timeval *programStart();
+
+/* Holds a mutex for the scope it is declared in, so every return of a
+ * function releases it */
+class BusLock{
+	private:
+		pthread_mutex_t *mutex;
+	public:
+		BusLock(pthread_mutex_t *m) : mutex(m){ pthread_mutex_lock(mutex); }
+		~BusLock(){ pthread_mutex_unlock(mutex); }
+};
+
+// Bus mutexes are recursive so a thread holding lock() can call the transfers
+static void initBusMutex(pthread_mutex_t *mutex){
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
 
 
 /*********************************
@@ -59,13 +70,14 @@ timeval start_program, end_point;
 
 //Constructor
 SerialPi::SerialPi(){
-	REV = getBoardRev();
-    serialPort="/dev/ttyAMA0";
+    serialPort=arduPiSerialPort();
     timeOut = 1000;
+    initBusMutex(&port_mutex);
 }
 
 //Sets the data rate in bits per second (baud) for serial data transmission
 void SerialPi::begin(int serialSpeed){
+    BusLock guard(&port_mutex);
 
 	switch(serialSpeed){
 		case     50:	speed =     B50 ; break ;
@@ -124,11 +136,13 @@ void SerialPi::begin(int serialSpeed){
 
 //Prints data to the serial port as human-readable ASCII text.
 void SerialPi::print(const char *message){
+    BusLock guard(&port_mutex);
     unistd::write(sd,message,strlen(message));
 }
 
 //Prints data to the serial port as human-readable ASCII text.
 void SerialPi::print (char message){
+    BusLock guard(&port_mutex);
 	unistd::write(sd,&message,1);
 }
 
@@ -136,6 +150,7 @@ void SerialPi::print (char message){
  * It can print the message in many format representations such as:
  * Binary, Octal, Decimal, Hexadecimal and as a BYTE. */
 void SerialPi::print(unsigned char i,Representation rep){
+    BusLock guard(&port_mutex);
     char * message;
     switch(rep){
 
@@ -166,6 +181,7 @@ void SerialPi::print(unsigned char i,Representation rep){
  * precission is used to limit the number of decimals.
  */
 void SerialPi::print(float f, int precission){
+    BusLock guard(&port_mutex);
 	/*
     const char *str1="%.";
     char * str2;
@@ -183,6 +199,7 @@ void SerialPi::print(float f, int precission){
 /* Prints data to the serial port as human-readable ASCII text followed
  * by a carriage retrun character '\r' and a newline character '\n' */
 void SerialPi::println(const char *message){
+    BusLock guard(&port_mutex);
 	const char *newline="\r\n";
 	char * msg = NULL;
 	asprintf(&msg,"%s%s",message,newline);
@@ -192,6 +209,7 @@ void SerialPi::println(const char *message){
 /* Prints data to the serial port as human-readable ASCII text followed
  * by a carriage retrun character '\r' and a newline character '\n' */
 void SerialPi::println(char message){
+    BusLock guard(&port_mutex);
 	const char *newline="\r\n";
 	char * msg = NULL;
 	asprintf(&msg,"%s%s",&message,newline);
@@ -201,6 +219,7 @@ void SerialPi::println(char message){
 /* Prints data to the serial port as human-readable ASCII text followed
  * by a carriage retrun character '\r' and a newline character '\n' */
 void SerialPi::println(int i, Representation rep){
+    BusLock guard(&port_mutex);
     char * message;
     switch(rep){
 
@@ -228,6 +247,7 @@ void SerialPi::println(int i, Representation rep){
 /* Prints data to the serial port as human-readable ASCII text followed
  * by a carriage retrun character '\r' and a newline character '\n' */
 void SerialPi::println(float f, int precission){
+    BusLock guard(&port_mutex);
     const char *str1="%.";
     char * str2;
     char * str3;
@@ -245,6 +265,7 @@ void SerialPi::println(float f, int precission){
 /* Writes binary data to the serial port. This data is sent as a byte 
  * Returns: number of bytes written */
 int SerialPi::write(unsigned char message){
+    BusLock guard(&port_mutex);
 	unistd::write(sd,&message,1);
 	return 1;
 }
@@ -253,6 +274,7 @@ int SerialPi::write(unsigned char message){
  * of bytes
  * Returns: number of bytes written */
 int SerialPi::write(const char *message){
+    BusLock guard(&port_mutex);
 	int len = strlen(message);
 	unistd::write(sd,&message,len);
 	return len;
@@ -262,6 +284,7 @@ int SerialPi::write(const char *message){
  * of bytes placed in an buffer. It needs the length of the buffer
  * Returns: number of bytes written */
 int SerialPi::write(char *message, int size){
+    BusLock guard(&port_mutex);
 	unistd::write(sd,message,size);
 	return size;
 }
@@ -270,6 +293,7 @@ int SerialPi::write(char *message, int size){
  * the serial port.
  * Return: number of bytes avalable to read */
 int SerialPi::available(){
+    BusLock guard(&port_mutex);
     int nbytes = 0;
     if (ioctl(sd, FIONREAD, &nbytes) < 0)  {
 		fprintf(stderr, "Failed to get byte count on serial.\n");
@@ -281,6 +305,8 @@ int SerialPi::available(){
 /* Reads 1 byte of incoming serial data
  * Returns: first byte of incoming serial data available */
 char SerialPi::read() {
+    BusLock guard(&port_mutex);
+    char c = 0;
 	unistd::read(sd,&c,1);
     return c;
 }
@@ -289,6 +315,8 @@ char SerialPi::read() {
  * terminates if the determined length has been read, or it times out
  * Returns: number of bytes readed */
 int SerialPi::readBytes(char message[], int size){
+    BusLock guard(&port_mutex);
+		timespec time1, time2;
 		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time1);
 		int count;
 		for (count=0;count<size;count++){
@@ -300,13 +328,40 @@ int SerialPi::readBytes(char message[], int size){
 		return count;
 }
 
+/* Reads up to size bytes of the data already received with a single
+ * system call. It never waits.
+ * Returns: number of bytes read */
+int SerialPi::readAvailable(char message[], int size){
+    BusLock guard(&port_mutex);
+    int nbytes = available();
+    if (nbytes > size) nbytes = size;
+    if (nbytes <= 0) return 0;
+
+    nbytes = unistd::read(sd, message, nbytes);
+    return (nbytes < 0) ? 0 : nbytes;
+}
+
+/* Sleeps until there is incoming data or millis milliseconds elapse
+ * Returns: number of bytes available */
+int SerialPi::waitAvailable(int millis){
+    struct pollfd fds;
+    fds.fd = sd;
+    fds.events = POLLIN;
+    fds.revents = 0;
+
+    if (poll(&fds, 1, millis) <= 0) return 0;
+    return available();
+}
+
 /* Reads characters from the serial buffer into an array. 
  * The function terminates if the terminator character is detected,
  * the determined length has been read, or it times out.
  * Returns: number of characters read into the buffer. */
 int SerialPi::readBytesUntil(char character,char buffer[],int length){
+    BusLock guard(&port_mutex);
     char lastReaded = character +1; //Just to make lastReaded != character
     int count=0;
+    timespec time1, time2;
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time1);
     while(count != length && lastReaded != character){
         if(available()) unistd::read(sd,&buffer[count],1);
@@ -329,12 +384,13 @@ bool SerialPi::find(const char *target){
  * or terminator string is found.
  * Returns: true if the target string is found, false if it times out */
 bool SerialPi::findUntil(const char *target, const char *terminal){
+    BusLock guard(&port_mutex);
     int index = 0;
     int termIndex = 0;
     int targetLen = strlen(target);
-    int termLen = strlen(terminal);
+    int termLen = (terminal != NULL) ? strlen(terminal) : 0;
     char readed;
-    timespec t;
+    timespec time1, time2, t;
 
     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time1);
 
@@ -353,7 +409,7 @@ bool SerialPi::findUntil(const char *target, const char *terminal){
                 }
             }
 
-            if(termLen > 0 && c == terminal[termIndex]){
+            if(termLen > 0 && readed == terminal[termIndex]){
                 if(++termIndex >= termLen) return false; // return false if terminate string found before target string
             }else{ 
                 termIndex = 0;
@@ -372,6 +428,7 @@ bool SerialPi::findUntil(const char *target, const char *terminal){
  * initial characters that are not digits (or the minus sign) are skipped
  * function is terminated by the first character that is not a digit. */
 long SerialPi::parseInt(){
+    BusLock guard(&port_mutex);
     bool isNegative = false;
     long value = 0;
     char c;
@@ -400,6 +457,7 @@ long SerialPi::parseInt(){
 }
 
 float SerialPi::parseFloat(){
+    BusLock guard(&port_mutex);
     boolean isNegative = false;
     boolean isFraction = false;
     long value = 0;
@@ -440,16 +498,19 @@ float SerialPi::parseFloat(){
 
 // Returns the next byte (character) of incoming serial data without removing it from the internal serial buffer.
 char SerialPi::peek(){
+    BusLock guard(&port_mutex);
     //We obtain a pointer to FILE structure from the file descriptor sd
     FILE * f = fdopen(sd,"r+");
     //With a pointer to FILE we can do getc and ungetc
-    c = getc(f);
+    int c = getc(f);
     ungetc(c, f);
     return c;
 }
 
 // Remove any data remaining on the serial buffer
 void SerialPi::flush(){
+    BusLock guard(&port_mutex);
+    char c;
     while(available()){
         unistd::read(sd,&c,1);
     }
@@ -463,9 +524,19 @@ void SerialPi::setTimeout(long millis){
 
 //Disables serial communication
 void SerialPi::end(){
+    BusLock guard(&port_mutex);
 	unistd::close(sd);
 }
 
+// Keeps the other threads out of the port until unlock()
+void SerialPi::lock(){
+	pthread_mutex_lock(&port_mutex);
+}
+
+void SerialPi::unlock(){
+	pthread_mutex_unlock(&port_mutex);
+}
+
 /*******************
  * Private methods *
  *******************/
@@ -548,49 +619,56 @@ char * SerialPi::int2oct(int i){
 
 //Constructor
 WirePi::WirePi(){
-	REV = getBoardRev();
-	if(map_peripheral(&gpio) == -1) {
-		printf("Failed to map the physical GPIO registers into the virtual memory space.\n");
-	}
+	arduPiBackendBegin();
 	
-	memfd = -1;
 	i2c_byte_wait_us = 0;
-	
-	// Open the master /dev/memory device
-    if ((memfd = open("/dev/mem", O_RDWR | O_SYNC) ) < 0) 
-    {
-	fprintf(stderr, "bcm2835_init: Unable to open /dev/mem: %s\n",
-		strerror(errno)) ;
-	exit(1);
-    }
-	
-	bcm2835_bsc01 = mapmem("bsc1", BLOCK_SIZE, memfd, BCM2835_BSC1_BASE2);
-    if (bcm2835_bsc01 == MAP_FAILED) exit(1);
+	i2c_bytes_to_read = 0;
+	i2c_pins_ready = false;
+	initBusMutex(&bus_mutex);
 	
     // start timer
-    gettimeofday(&start_program, NULL);
+    programStart();
     
 }
 
+// Keeps the other threads out of the bus until unlock()
+void WirePi::lock(){
+	pthread_mutex_lock(&bus_mutex);
+}
+
+void WirePi::unlock(){
+	pthread_mutex_unlock(&bus_mutex);
+}
+
 //Initiate the Wire library and join the I2C bus.
+//The pin muxing and byte time are kept until endTransmission() releases the pins,
+//so calling begin() again before every access costs nothing.
 void WirePi::begin(){
+	BusLock guard(&bus_mutex);
+
+	if (i2c_pins_ready) return;
 
 	volatile uint32_t* paddr = bcm2835_bsc01 + BCM2835_BSC_DIV/4;
 
-    // Set the I2C/BSC1 pins to the Alt 0 function to enable I2C access on them
-    ch_gpio_fsel(RPI_V2_GPIO_P1_03, BCM2835_GPIO_FSEL_ALT0); // SDA
-    ch_gpio_fsel(RPI_V2_GPIO_P1_05, BCM2835_GPIO_FSEL_ALT0); // SCL
+    // Set the I2C/BSC1 pins to the Alt 0 function to enable I2C access on them.
+    // With the kernel backend they belong to the i2c-bcm2835 driver
+    if (arduPiBackend() != ARDUPI_BACKEND_KERNEL){
+        ch_gpio_fsel(RPI_V2_GPIO_P1_03, BCM2835_GPIO_FSEL_ALT0); // SDA
+        ch_gpio_fsel(RPI_V2_GPIO_P1_05, BCM2835_GPIO_FSEL_ALT0); // SCL
+    }
 
     // Read the clock divider register
     uint16_t cdiv = ch_peri_read(paddr);
     // Calculate time for transmitting one byte
     // 1000000 = micros seconds in a second
     // 9 = Clocks per byte : 8 bits + ACK
-    i2c_byte_wait_us = ((float)cdiv / BCM2835_CORE_CLK_HZ) * 1000000 * 9;
+    i2c_byte_wait_us = ((float)cdiv / getCoreClock()) * 1000000 * 9;
+    i2c_pins_ready = true;
 }
 
 //Begin a transmission to the I2C slave device with the given address
 void WirePi::beginTransmission(unsigned char address){
+	BusLock guard(&bus_mutex);
 	// Set I2C Device Address
 	volatile uint32_t* paddr = bcm2835_bsc01 + BCM2835_BSC_A/4;
 	ch_peri_write(paddr, address);
@@ -608,12 +686,19 @@ void WirePi::write(char data){
 
 //Writes data to the I2C.
 uint8_t WirePi::write(const char * buf, uint32_t len){
+	BusLock guard(&bus_mutex);
 	
 	volatile uint32_t* dlen    = bcm2835_bsc01 + BCM2835_BSC_DLEN/4;
     volatile uint32_t* fifo    = bcm2835_bsc01 + BCM2835_BSC_FIFO/4;
     volatile uint32_t* status  = bcm2835_bsc01 + BCM2835_BSC_S/4;
     volatile uint32_t* control = bcm2835_bsc01 + BCM2835_BSC_C/4;
 
+    // i2c-dev does the whole transfer, the address was kept in the A register
+    if (arduPiBackend() == ARDUPI_BACKEND_KERNEL){
+        if (kernelI2CTransfer(ch_peri_read(bcm2835_bsc01 + BCM2835_BSC_A/4), buf, len, NULL, 0) < 0) return BCM2835_I2C_REASON_ERROR_NACK;
+        return BCM2835_I2C_REASON_OK;
+    }
+
     uint32_t remaining = len;
     uint32_t i = 0;
     uint8_t reason = BCM2835_I2C_REASON_OK;
@@ -672,13 +757,18 @@ uint8_t WirePi::write(const char * buf, uint32_t len){
 
 
 void WirePi::endTransmission(){
-	// Set all the I2C/BSC1 pins back to input
-    ch_gpio_fsel(RPI_V2_GPIO_P1_03, BCM2835_GPIO_FSEL_INPT); // SDA
-    ch_gpio_fsel(RPI_V2_GPIO_P1_05, BCM2835_GPIO_FSEL_INPT); // SCL
+	BusLock guard(&bus_mutex);
+	// Set all the I2C/BSC1 pins back to input, unless the i2c driver owns them
+    if (arduPiBackend() != ARDUPI_BACKEND_KERNEL){
+        ch_gpio_fsel(RPI_V2_GPIO_P1_03, BCM2835_GPIO_FSEL_INPT); // SDA
+        ch_gpio_fsel(RPI_V2_GPIO_P1_05, BCM2835_GPIO_FSEL_INPT); // SCL
+    }
+    i2c_pins_ready = false;
 }
 
 //Used by the master to request bytes from a slave device
 void WirePi::requestFrom(unsigned char address,int quantity){
+	BusLock guard(&bus_mutex);
 	// Set I2C Device Address
 	volatile uint32_t* paddr = bcm2835_bsc01 + BCM2835_BSC_A/4;
 	ch_peri_write(paddr, address);
@@ -688,6 +778,7 @@ void WirePi::requestFrom(unsigned char address,int quantity){
 
 //Reads a byte that was transmitted from a slave device to a master after a call to WirePi::requestFrom()
 unsigned char WirePi::read(){
+	BusLock guard(&bus_mutex);
 	char buf;
 	i2c_bytes_to_read=1;
 	read(&buf);
@@ -695,11 +786,18 @@ unsigned char WirePi::read(){
 }
 
 uint8_t WirePi::read(char* buf){
+	BusLock guard(&bus_mutex);
     volatile uint32_t* dlen    = bcm2835_bsc01 + BCM2835_BSC_DLEN/4;
     volatile uint32_t* fifo    = bcm2835_bsc01 + BCM2835_BSC_FIFO/4;
     volatile uint32_t* status  = bcm2835_bsc01 + BCM2835_BSC_S/4;
     volatile uint32_t* control = bcm2835_bsc01 + BCM2835_BSC_C/4;
 
+    // i2c-dev does the whole transfer, the address was kept in the A register
+    if (arduPiBackend() == ARDUPI_BACKEND_KERNEL){
+        if (kernelI2CTransfer(ch_peri_read(bcm2835_bsc01 + BCM2835_BSC_A/4), NULL, 0, buf, i2c_bytes_to_read) < 0) return BCM2835_I2C_REASON_ERROR_NACK;
+        return BCM2835_I2C_REASON_OK;
+    }
+
     uint32_t remaining = i2c_bytes_to_read;
     uint32_t i = 0;
     uint8_t reason = BCM2835_I2C_REASON_OK;
@@ -762,10 +860,17 @@ uint8_t WirePi::read(char* buf){
 // Read an number of bytes from I2C sending a repeated start after writing
 // the required register. Only works if your device supports this mode
 uint8_t WirePi::read_rs(char* regaddr, char* buf, uint32_t len){   
+	BusLock guard(&bus_mutex);
     volatile uint32_t* dlen    = bcm2835_bsc01 + BCM2835_BSC_DLEN/4;
     volatile uint32_t* fifo    = bcm2835_bsc01 + BCM2835_BSC_FIFO/4;
     volatile uint32_t* status  = bcm2835_bsc01 + BCM2835_BSC_S/4;
     volatile uint32_t* control = bcm2835_bsc01 + BCM2835_BSC_C/4;
+
+    // i2c-dev does the whole transfer, the address was kept in the A register
+    if (arduPiBackend() == ARDUPI_BACKEND_KERNEL){
+        if (kernelI2CTransfer(ch_peri_read(bcm2835_bsc01 + BCM2835_BSC_A/4), regaddr, 1, buf, len) < 0) return BCM2835_I2C_REASON_ERROR_NACK;
+        return BCM2835_I2C_REASON_OK;
+    }
     
 	uint32_t remaining = len;
     uint32_t i = 0;
@@ -847,52 +952,38 @@ uint8_t WirePi::read_rs(char* regaddr, char* buf, uint32_t len){
  * Private methods *
  *******************/
 
-// Exposes the physical address defined in the passed structure using mmap on /dev/mem
-int WirePi::map_peripheral(struct bcm2835_peripheral *p)
-{
-   // Open /dev/mem
-   if ((p->mem_fd = open("/dev/mem", O_RDWR|O_SYNC) ) < 0) {
-      printf("Failed to open /dev/mem, try checking permissions.\n");
-      return -1;
-   }
-
-   p->map = mmap(
-      NULL,
-      BLOCK_SIZE,
-      PROT_READ|PROT_WRITE,
-      MAP_SHARED,
-      p->mem_fd,  // File descriptor to physical memory virtual file '/dev/mem'
-      p->addr_p      // Address in physical map that we want this memory block to expose
-   );
-
-   if (p->map == MAP_FAILED) {
-        perror("mmap");
-        return -1;
-   }
-
-   p->addr = (volatile unsigned int *)p->map;
+/*************************************
+ *                                   *
+ * SPISettings Class implementation *
+ * --------------------------------- *
+ *************************************/
 
-   return 0;
+// Default settings: 4MHz (or the next lower rate), MSB first, mode 0, CE0
+SPISettings::SPISettings(){
+    *this = SPISettings(4000000, MSBFIRST, SPI_MODE0, BCM2835_SPI_CS0);
 }
 
-void WirePi::unmap_peripheral(struct bcm2835_peripheral *p) {
+/* clock is the maximum SCLK rate in Hz. It is rounded down to the next rate
+ * the power of 2 divider can produce. SPI0 only shifts MSB first, so the bit
+ * order is ignored and LSBFIRST data must be reversed by the caller */
+SPISettings::SPISettings(uint32_t clock, uint8_t, uint8_t dataMode, uint8_t cs){
+    uint32_t divider = 2;
 
-    munmap(p->map, BLOCK_SIZE);
-    unistd::close(p->mem_fd);
-}
+    while ((divider < 65536) && ((uint32_t)(getCoreClock() / divider) > clock))
+        divider <<= 1;
 
-void WirePi::wait_i2c_done() {
-        //Wait till done, let's use a timeout just in case
-        int timeout = 50;
-        while((!((BSC0_S) & BSC_S_DONE)) && --timeout) {
-            unistd::usleep(1000);
-        }
-        if(timeout == 0)
-            printf("wait_i2c_done() timeout. Something went wrong.\n");
+    // A divider of 0 means 65536
+    clk = (divider >= 65536) ? 0 : divider;
+    cs_image = (cs & BCM2835_SPI0_CS_CS) | ((dataMode << 2) & (BCM2835_SPI0_CS_CPOL | BCM2835_SPI0_CS_CPHA));
+    cs_pin = -1;
 }
 
-
-
+/* Uses a GPIO (arduino pin number) as chip select instead of a CE line. It is
+ * driven by SPIPi with direct register writes, without digitalWrite() delays */
+void SPISettings::setChipSelectPin(int pin){
+    cs_pin = pin;
+    cs_image = (cs_image & ~BCM2835_SPI0_CS_CS) | BCM2835_SPI_CS_NONE;
+}
 
 
 /*******************************
@@ -906,35 +997,45 @@ void WirePi::wait_i2c_done() {
  ******************/
 
  SPIPi::SPIPi(){
-	 
-	REV = getBoardRev();
-
-    uint8_t *mapaddr;
 
-    if ((spi0Mem = (uint8_t*)malloc(BLOCK_SIZE + (PAGESIZE - 1))) == NULL){
-        fprintf(stderr, "bcm2835_init: spi0Mem malloc failed: %s\n", strerror(errno));
-        exit(1);
-    }
-    
-    mapaddr = spi0Mem;
-    if (((uint32_t)mapaddr % PAGESIZE) != 0)
-        mapaddr += PAGESIZE - ((uint32_t)mapaddr % PAGESIZE) ;
-    
-    spi0 = (uint32_t *)mmap(mapaddr, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, gpio.mem_fd, BCM2835_SPI0_BASE2) ;
-    
-    if ((int32_t)spi0 < 0){
-        fprintf(stderr, "bcm2835_init: mmap failed (spi0): %s\n", strerror(errno)) ;
-        exit(1);
-    }
+    arduPiBackendBegin();
+
+    // Recursive so a driver can nest transactions while it holds the bus
+    initBusMutex(&bus_mutex);
+    cur_cs_image = 0xFFFFFFFF;
+    cur_clk = 0xFFFFFFFF;
+    cspol_bits = 0;
+    txn_depth = 0;
+    txn_cs_hold = false;
+    txn_cs_pin = -1;
+    cs_asserted = false;
+    cs_pin_configured = -1;
+
+    spidev_fd[0] = -1;
+    spidev_fd[1] = -1;
+    spidev_mode[0] = 0xFF;
+    spidev_mode[1] = 0xFF;
+    queue_backend = SPI_QUEUE_NONE;
+    queue_running = false;
+    queue_busy = false;
+    queue_head = NULL;
+    queue_tail = NULL;
+    pthread_mutex_init(&queue_mutex, NULL);
+    pthread_cond_init(&queue_cond, NULL);
+    pthread_cond_init(&queue_idle, NULL);
  }
 
 void SPIPi::begin(){
-    // Set the SPI0 pins to the Alt 0 function to enable SPI0 access on them
-    ch_gpio_fsel(7, BCM2835_GPIO_FSEL_ALT0); // CE1
-    ch_gpio_fsel(8, BCM2835_GPIO_FSEL_ALT0); // CE0
-    ch_gpio_fsel(9, BCM2835_GPIO_FSEL_ALT0); // MISO
-    ch_gpio_fsel(10, BCM2835_GPIO_FSEL_ALT0); // MOSI
-    ch_gpio_fsel(11, BCM2835_GPIO_FSEL_ALT0); // CLK
+    BusLock guard(&bus_mutex);
+    // Set the SPI0 pins to the Alt 0 function to enable SPI0 access on them.
+    // With the kernel backend they belong to the spidev driver
+    if (arduPiBackend() != ARDUPI_BACKEND_KERNEL){
+        ch_gpio_fsel(7, BCM2835_GPIO_FSEL_ALT0); // CE1
+        ch_gpio_fsel(8, BCM2835_GPIO_FSEL_ALT0); // CE0
+        ch_gpio_fsel(9, BCM2835_GPIO_FSEL_ALT0); // MISO
+        ch_gpio_fsel(10, BCM2835_GPIO_FSEL_ALT0); // MOSI
+        ch_gpio_fsel(11, BCM2835_GPIO_FSEL_ALT0); // CLK
+    }
     
     // Set the SPI CS register to the some sensible defaults
     volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
@@ -942,15 +1043,58 @@ void SPIPi::begin(){
     
     // Clear TX and RX fifos
     ch_peri_write_nb(paddr, BCM2835_SPI0_CS_CLEAR);
+
+    cur_cs_image = 0xFFFFFFFF;
+    cur_clk = 0xFFFFFFFF;
+    cspol_bits = 0;
 }
 
 void SPIPi::end(){  
-    // Set all the SPI0 pins back to input
-    ch_gpio_fsel(7, BCM2835_GPIO_FSEL_INPT); // CE1
-    ch_gpio_fsel(8, BCM2835_GPIO_FSEL_INPT); // CE0
-    ch_gpio_fsel(9, BCM2835_GPIO_FSEL_INPT); // MISO
-    ch_gpio_fsel(10, BCM2835_GPIO_FSEL_INPT); // MOSI
-    ch_gpio_fsel(11, BCM2835_GPIO_FSEL_INPT); // CLK
+    BusLock guard(&bus_mutex);
+    // Set all the SPI0 pins back to input, unless the spidev driver owns them
+    if (arduPiBackend() != ARDUPI_BACKEND_KERNEL){
+        ch_gpio_fsel(7, BCM2835_GPIO_FSEL_INPT); // CE1
+        ch_gpio_fsel(8, BCM2835_GPIO_FSEL_INPT); // CE0
+        ch_gpio_fsel(9, BCM2835_GPIO_FSEL_INPT); // MISO
+        ch_gpio_fsel(10, BCM2835_GPIO_FSEL_INPT); // MOSI
+        ch_gpio_fsel(11, BCM2835_GPIO_FSEL_INPT); // CLK
+    }
+}
+
+/* Takes the SPI bus for the calling thread and applies the device settings.
+ * Other threads calling beginTransaction() wait until endTransaction().
+ * The chip select is asserted by the first transfer and kept asserted until
+ * the outermost endTransaction(), so a command can be split in several calls */
+void SPIPi::beginTransaction(const SPISettings &settings){
+    pthread_mutex_lock(&bus_mutex);
+    if (txn_depth++ > 0) return;
+
+    applySettings(settings.cs_image, settings.clk);
+
+    txn_cs_pin = settings.cs_pin;
+    txn_cs_hold = (settings.cs_pin >= 0) || ((settings.cs_image & BCM2835_SPI0_CS_CS) != BCM2835_SPI_CS_NONE);
+    cs_asserted = false;
+
+    if (txn_cs_pin >= 0) configureChipSelectPin(txn_cs_pin);
+}
+
+// Releases the chip select and the SPI bus taken by beginTransaction()
+void SPIPi::endTransaction(){
+    if ((txn_depth > 0) && (--txn_depth == 0)){
+        releaseChipSelect();
+        txn_cs_hold = false;
+    }
+    pthread_mutex_unlock(&bus_mutex);
+}
+
+// Keeps the other threads out of the bus until unlock(), across several
+// transactions, e.g. while a chip select outside the SPI engine is held
+void SPIPi::lock(){
+    pthread_mutex_lock(&bus_mutex);
+}
+
+void SPIPi::unlock(){
+    pthread_mutex_unlock(&bus_mutex);
 }
 
 void SPIPi::setBitOrder(uint8_t order){
@@ -962,96 +1106,417 @@ void SPIPi::setBitOrder(uint8_t order){
 // rounded down. The maximum SPI clock rate is
 // of the APB clock
 void SPIPi::setClockDivider(uint16_t divider){
+    BusLock guard(&bus_mutex);
     volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CLK/4;
     ch_peri_write(paddr, divider);
+    cur_clk = 0xFFFFFFFF;
 }
 
 void SPIPi::setDataMode(uint8_t mode){
+    BusLock guard(&bus_mutex);
     volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
     // Mask in the CPO and CPHA bits of CS
     ch_peri_set_bits(paddr, mode << 2, BCM2835_SPI0_CS_CPOL | BCM2835_SPI0_CS_CPHA);
+    cur_cs_image = 0xFFFFFFFF;
 }
 
 // Writes (and reads) a single byte to SPI
 uint8_t SPIPi::transfer(uint8_t value){
-    volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
-    volatile uint32_t* fifo = (volatile uint32_t*)spi0 + BCM2835_SPI0_FIFO/4;
+    uint8_t ret;
+    transferFifo(&value, &ret, 1);
+    return ret;
+}
 
-    ch_peri_set_bits(paddr, BCM2835_SPI0_CS_CLEAR, BCM2835_SPI0_CS_CLEAR);
+// Writes (and reads) a number of bytes to SPI
+void SPIPi::transfernb(char* tbuf, char* rbuf, uint32_t len){
+    transferFifo((const uint8_t*)tbuf, (uint8_t*)rbuf, len);
+}
 
-    ch_peri_set_bits(paddr, BCM2835_SPI0_CS_TA, BCM2835_SPI0_CS_TA);
+// Writes (and reads) a number of bytes to SPI from/to untyped buffers
+void SPIPi::transfer(const void* tbuf, void* rbuf, size_t len){
+    transferFifo((const uint8_t*)tbuf, (uint8_t*)rbuf, len);
+}
 
-    while (!(ch_peri_read(paddr) & BCM2835_SPI0_CS_TXD))
-    delayMicroseconds(10);
+// Writes a number of bytes to SPI discarding what is received
+void SPIPi::writenb(const void* tbuf, size_t len){
+    transferFifo((const uint8_t*)tbuf, NULL, len);
+}
 
-    ch_peri_write_nb(fifo, value);
+// Reads a number of bytes from SPI clocking out zeros
+void SPIPi::readnb(void* rbuf, size_t len){
+    transferFifo(NULL, (uint8_t*)rbuf, len);
+}
 
-    while (!(ch_peri_read_nb(paddr) & BCM2835_SPI0_CS_DONE))
-    delayMicroseconds(10);
+/* Starts the SPI transaction queue. Queued transactions are run back to back
+ * by a worker thread, batched through spidev when the kernel driver is loaded
+ * (it moves long transfers with DMA), or with polled FIFO transfers otherwise.
+ * Returns: the backend in use, SPI_QUEUE_NONE if error */
+int SPIPi::beginQueue(){
+    if (queue_running) return queue_backend;
 
-    uint32_t ret = ch_peri_read_nb(fifo);
+    // The simulated SPI0 is only reachable through the registers
+    if (!peri_simulated){
+        spidev_fd[0] = open(ARDUPI_SPIDEV0, O_RDWR);
+        spidev_fd[1] = open(ARDUPI_SPIDEV1, O_RDWR);
+    }
+    spidev_mode[0] = 0xFF;
+    spidev_mode[1] = 0xFF;
 
-    ch_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_TA);
+    if ((spidev_fd[0] >= 0) || (spidev_fd[1] >= 0)){
+        queue_backend = SPI_QUEUE_SPIDEV;
+    }else{
+        queue_backend = SPI_QUEUE_POLLED;
+        begin();
+    }
 
-    return ret;
+    queue_running = true;
+    if (pthread_create(&queue_thread, NULL, spiQueueFunction, (void *)this) != 0){
+        fprintf(stderr, "Unable to start the SPI queue thread\n");
+        queue_running = false;
+        endQueue();
+        return SPI_QUEUE_NONE;
+    }
+    return queue_backend;
 }
 
-// Writes (and reads) a number of bytes to SPI
-void SPIPi::transfernb(char* tbuf, char* rbuf, uint32_t len){
+// Runs the pending transactions and stops the SPI transaction queue
+void SPIPi::endQueue(){
+    if (queue_running){
+        pthread_mutex_lock(&queue_mutex);
+        queue_running = false;
+        pthread_cond_signal(&queue_cond);
+        pthread_mutex_unlock(&queue_mutex);
+        pthread_join(queue_thread, NULL);
+    }
+
+    for (int i = 0; i < 2; i++){
+        if (spidev_fd[i] >= 0) unistd::close(spidev_fd[i]);
+        spidev_fd[i] = -1;
+    }
+    queue_backend = SPI_QUEUE_NONE;
+}
+
+// Returns the backend used by the SPI transaction queue
+int SPIPi::getQueueBackend(){
+    return queue_backend;
+}
+
+/* Adds a transaction at the end of the queue. It can be called from a
+ * transaction callback to chain a new transfer.
+ * Returns: 0 if ok, -1 if the queue is not running */
+int SPIPi::queueTransaction(struct SPITransaction *t){
+    pthread_mutex_lock(&queue_mutex);
+    if (!queue_running){
+        pthread_mutex_unlock(&queue_mutex);
+        return -1;
+    }
+
+    t->next = NULL;
+    t->status = 0;
+    if (queue_tail == NULL){
+        queue_head = t;
+    }else{
+        queue_tail->next = t;
+    }
+    queue_tail = t;
+
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    return 0;
+}
+
+// Waits until every queued transaction has been completed
+void SPIPi::waitQueue(){
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_head != NULL || queue_busy){
+        pthread_cond_wait(&queue_idle, &queue_mutex);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+void SPIPi::chipSelect(uint8_t cs){
+    BusLock guard(&bus_mutex);
+    volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
+    // Mask in the CS bits of CS
+    ch_peri_set_bits(paddr, cs, BCM2835_SPI0_CS_CS);
+    cur_cs_image = 0xFFFFFFFF;
+}
+
+void SPIPi::setChipSelectPolarity(uint8_t cs, uint8_t active){
+    BusLock guard(&bus_mutex);
+    volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
+    uint8_t shift = 21 + cs;
+    // Mask in the appropriate CSPOLn bit
+    ch_peri_set_bits(paddr, active << shift, 1 << shift);
+    cspol_bits = (cspol_bits & ~(1 << shift)) | (active << shift);
+    cur_cs_image = 0xFFFFFFFF;
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+/* Polled transfer as per section 10.6.1, keeping the TX FIFO filled while the
+ * RX FIFO is drained. No more than BCM2835_SPI0_FIFO_SIZE bytes are in flight
+ * so the RX FIFO can never overflow. A NULL tbuf sends zeros and a NULL rbuf
+ * discards the received bytes. */
+void SPIPi::transferFifo(const uint8_t* tbuf, uint8_t* rbuf, uint32_t len){
+    // Outside a transaction the transfer takes the bus on its own
+    BusLock guard(&bus_mutex);
     volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
     volatile uint32_t* fifo = (volatile uint32_t*)spi0 + BCM2835_SPI0_FIFO/4;
+    uint32_t txcnt = 0;
+    uint32_t rxcnt = 0;
+    uint32_t cs;
+    uint8_t data;
+
+    // spidev moves the bytes, a held chip select is kept with cs_change
+    if (arduPiBackend() == ARDUPI_BACKEND_KERNEL){
+        if (txn_cs_hold && !cs_asserted) assertChipSelect();
+        kernelSPITransfer((volatile uint32_t*)spi0, txn_cs_hold, tbuf, rbuf, len);
+        return;
+    }
 
-    // This is Polled transfer as per section 10.6.1
     // BUG ALERT: what happens if we get interupted in this section, and someone else
     // accesses a different peripheral? 
 
     // Clear TX and RX fifos
     ch_peri_set_bits(paddr, BCM2835_SPI0_CS_CLEAR, BCM2835_SPI0_CS_CLEAR);
 
-    // Set TA = 1
-    ch_peri_set_bits(paddr, BCM2835_SPI0_CS_TA, BCM2835_SPI0_CS_TA);
+    // Set TA = 1, inside a transaction it stays set until endTransaction()
+    if (txn_cs_hold){
+        if (!cs_asserted) assertChipSelect();
+    }else{
+        ch_peri_set_bits(paddr, BCM2835_SPI0_CS_TA, BCM2835_SPI0_CS_TA);
+    }
 
-    uint32_t i;
-    for (i = 0; i < len; i++)
+    while (rxcnt < len)
     {
-    // Maybe wait for TXD
-    while (!(ch_peri_read(paddr) & BCM2835_SPI0_CS_TXD))
-        delayMicroseconds(10);
-
-    // Write to FIFO, no barrier
-    ch_peri_write_nb(fifo, tbuf[i]);
-
-    // Wait for RXD
-    while (!(ch_peri_read(paddr) & BCM2835_SPI0_CS_RXD))
-        delayMicroseconds(10);
+        cs = ch_peri_read_nb(paddr);
+
+        // Fill the TX FIFO, no barrier
+        while ((cs & BCM2835_SPI0_CS_TXD) && (txcnt < len) && (txcnt - rxcnt < BCM2835_SPI0_FIFO_SIZE))
+        {
+            ch_peri_write_nb(fifo, tbuf ? tbuf[txcnt] : 0);
+            txcnt++;
+            cs = ch_peri_read_nb(paddr);
+        }
 
-    // then read the data byte
-    rbuf[i] = ch_peri_read_nb(fifo);
+        // Drain the RX FIFO, no barrier
+        while ((cs & BCM2835_SPI0_CS_RXD) && (rxcnt < len))
+        {
+            data = ch_peri_read_nb(fifo);
+            if (rbuf) rbuf[rxcnt] = data;
+            rxcnt++;
+            cs = ch_peri_read_nb(paddr);
+        }
     }
+
     // Wait for DONE to be set
     while (!(ch_peri_read_nb(paddr) & BCM2835_SPI0_CS_DONE))
-    delayMicroseconds(10);
+        ;
 
     // Set TA = 0, and also set the barrier
-    ch_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_TA);
+    if (!txn_cs_hold) ch_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_TA);
 }
 
-void SPIPi::chipSelect(uint8_t cs){
+/* Asserts the chip select of the current transaction. A hardware CE line
+ * follows TA, a managed GPIO is cleared right before */
+void SPIPi::assertChipSelect(){
     volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
-    // Mask in the CS bits of CS
-    ch_peri_set_bits(paddr, cs, BCM2835_SPI0_CS_CS);
+
+    if (txn_cs_pin >= 0) ch_peri_write_nb(&GPCLR0, 1 << raspberryPinNumber(txn_cs_pin));
+    ch_peri_set_bits(paddr, BCM2835_SPI0_CS_TA, BCM2835_SPI0_CS_TA);
+    cs_asserted = true;
 }
 
-void SPIPi::setChipSelectPolarity(uint8_t cs, uint8_t active){
+// Deasserts the chip select asserted by assertChipSelect()
+void SPIPi::releaseChipSelect(){
     volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
-    uint8_t shift = 21 + cs;
-    // Mask in the appropriate CSPOLn bit
-    ch_peri_set_bits(paddr, active << shift, 1 << shift);
+
+    if (!cs_asserted) return;
+
+    if (arduPiBackend() == ARDUPI_BACKEND_KERNEL) kernelSPIRelease((volatile uint32_t*)spi0);
+    ch_peri_set_bits(paddr, 0, BCM2835_SPI0_CS_TA);
+    if (txn_cs_pin >= 0) ch_peri_write_nb(&GPSET0, 1 << raspberryPinNumber(txn_cs_pin));
+    cs_asserted = false;
+}
+
+// Managed GPIO chip select: configure it once, idle high
+void SPIPi::configureChipSelectPin(int pin){
+    if (pin == cs_pin_configured) return;
+
+    pinMode(pin, OUTPUT);
+    ch_peri_write_nb(&GPSET0, 1 << raspberryPinNumber(pin));
+    cs_pin_configured = pin;
+}
+
+
+/* Loads a CS register image and a clock divider with one store each, or
+ * none at all if they are already loaded */
+void SPIPi::applySettings(uint32_t cs_image, uint32_t clk){
+    volatile uint32_t* paddr = (volatile uint32_t*)spi0 + BCM2835_SPI0_CS/4;
+    volatile uint32_t* pclk = (volatile uint32_t*)spi0 + BCM2835_SPI0_CLK/4;
+
+    cs_image |= cspol_bits;
+
+    if (cs_image != cur_cs_image){
+        ch_peri_write_nb(paddr, cs_image);
+        cur_cs_image = cs_image;
+    }
+    if (clk != cur_clk){
+        ch_peri_write_nb(pclk, clk);
+        cur_clk = clk;
+    }
 }
 
+// Worker loop of the SPI transaction queue
+void SPIPi::runQueue(){
+    struct SPITransaction *batch;
+
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_running || queue_head != NULL){
+        if (queue_head == NULL){
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+            continue;
+        }
+
+        // Take everything queued so far, callbacks may queue more meanwhile
+        batch = queue_head;
+        queue_head = NULL;
+        queue_tail = NULL;
+        queue_busy = true;
+        pthread_mutex_unlock(&queue_mutex);
+
+        runTransactions(batch);
+
+        pthread_mutex_lock(&queue_mutex);
+        queue_busy = false;
+        if (queue_head == NULL) pthread_cond_broadcast(&queue_idle);
+    }
+    pthread_cond_broadcast(&queue_idle);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+/* Runs a list of transactions. With spidev, consecutive transactions for the
+ * same device and mode go in a single SPI_IOC_MESSAGE with CS released
+ * between them. A transaction longer than the spidev buffer goes alone in
+ * several messages, see below. A transaction with a GPIO chip select always
+ * goes alone, the GPIO is cleared before its message and set after it */
+void SPIPi::runTransactions(struct SPITransaction *t){
+    struct spi_ioc_transfer xfer[SPI_QUEUE_MAX_BATCH];
+    struct SPITransaction *group[SPI_QUEUE_MAX_BATCH];
+    struct SPITransaction *next;
+    uint32_t bytes, offset, chunk;
+    uint8_t mode;
+    int n, i, fd, index, ret, pin;
+
+    while (t != NULL){
+        n = 0;
+        bytes = 0;
+        pin = (t->cs == BCM2835_SPI_CS_NONE) ? t->cs_pin : -1;
+
+        if (queue_backend == SPI_QUEUE_SPIDEV){
+            // A GPIO chip select (BCM2835_SPI_CS_NONE) uses spidev0.0 without
+            // CS, like the kernel backend
+            index = (t->cs == BCM2835_SPI_CS1) ? 1 : 0;
+            fd = spidev_fd[index];
+            mode = t->mode | ((t->cs == BCM2835_SPI_CS_NONE) ? SPI_NO_CS : 0);
+
+            ret = -1;
+            if (fd >= 0){
+                ret = 0;
+                if (spidev_mode[index] != mode){
+                    ret = ioctl(fd, SPI_IOC_WR_MODE, &mode);
+                    if (ret >= 0) spidev_mode[index] = mode;
+                }
+            }
+
+            if (t->len > SPI_QUEUE_MAX_BYTES){
+                /* spidev rejects messages longer than its buffer, so the
+                 * transaction is sent in chunks, one message each. With
+                 * cs_change on the last transfer of a message the chip
+                 * select stays asserted until the next one */
+                pthread_mutex_lock(&bus_mutex);
+                if (pin >= 0){
+                    configureChipSelectPin(pin);
+                    ch_peri_write_nb(&GPCLR0, 1 << raspberryPinNumber(pin));
+                }
+                for (offset = 0; (ret >= 0) && (offset < t->len); offset += chunk){
+                    chunk = t->len - offset;
+                    if (chunk > SPI_QUEUE_MAX_BYTES) chunk = SPI_QUEUE_MAX_BYTES;
+
+                    memset(&xfer[0], 0, sizeof(xfer[0]));
+                    xfer[0].tx_buf = t->tbuf ? (unsigned long)(t->tbuf + offset) : 0;
+                    xfer[0].rx_buf = t->rbuf ? (unsigned long)(t->rbuf + offset) : 0;
+                    xfer[0].len = chunk;
+                    xfer[0].speed_hz = getCoreClock() / (t->divider ? t->divider : 65536);
+                    xfer[0].bits_per_word = 8;
+                    xfer[0].cs_change = (offset + chunk < t->len) ? 1 : 0;
+                    ret = ioctl(fd, SPI_IOC_MESSAGE(1), xfer);
+                }
+                if (pin >= 0) ch_peri_write_nb(&GPSET0, 1 << raspberryPinNumber(pin));
+                pthread_mutex_unlock(&bus_mutex);
+                group[n++] = t;
+                t = t->next;
+            }else{
+                do{
+                    memset(&xfer[n], 0, sizeof(xfer[n]));
+                    xfer[n].tx_buf = (unsigned long)t->tbuf;
+                    xfer[n].rx_buf = (unsigned long)t->rbuf;
+                    xfer[n].len = t->len;
+                    xfer[n].speed_hz = getCoreClock() / (t->divider ? t->divider : 65536);
+                    xfer[n].bits_per_word = 8;
+                    xfer[n].cs_change = 1;
+                    bytes += t->len;
+                    group[n++] = t;
+                    t = t->next;
+                }while ((t != NULL) && (pin < 0) && (n < SPI_QUEUE_MAX_BATCH)
+                    && (t->cs == group[0]->cs) && (t->mode == group[0]->mode)
+                    && (bytes + t->len <= SPI_QUEUE_MAX_BYTES));
+
+                // Keep CS asserted only inside each transaction
+                xfer[n-1].cs_change = 0;
+
+                if (ret >= 0){
+                    pthread_mutex_lock(&bus_mutex);
+                    if (pin >= 0){
+                        configureChipSelectPin(pin);
+                        ch_peri_write_nb(&GPCLR0, 1 << raspberryPinNumber(pin));
+                    }
+                    ret = ioctl(fd, SPI_IOC_MESSAGE(n), xfer);
+                    if (pin >= 0) ch_peri_write_nb(&GPSET0, 1 << raspberryPinNumber(pin));
+                    pthread_mutex_unlock(&bus_mutex);
+                }
+            }
+            for (i = 0; i < n; i++) group[i]->status = (ret < 0) ? -1 : 0;
+        }else{
+            pthread_mutex_lock(&bus_mutex);
+            applySettings((t->cs & BCM2835_SPI0_CS_CS) | ((t->mode << 2) & (BCM2835_SPI0_CS_CPOL | BCM2835_SPI0_CS_CPHA)), t->divider);
+            if (pin >= 0){
+                configureChipSelectPin(pin);
+                ch_peri_write_nb(&GPCLR0, 1 << raspberryPinNumber(pin));
+            }
+            transferFifo(t->tbuf, t->rbuf, t->len);
+            if (pin >= 0) ch_peri_write_nb(&GPSET0, 1 << raspberryPinNumber(pin));
+            pthread_mutex_unlock(&bus_mutex);
+            t->status = 0;
+            group[n++] = t;
+            t = t->next;
+        }
+
+        // The callback may reuse the descriptor, do not touch it afterwards
+        for (i = 0; i < n; i++){
+            next = group[i];
+            if (next->callback != NULL) next->callback(next);
+        }
+    }
+}
 
 // safe read from peripheral
 uint32_t ch_peri_read(volatile uint32_t* paddr){
+    if (peri_simulated) return simPeriRead(paddr);
     uint32_t ret = *paddr;
     ret = *paddr;
     return ret;
@@ -1060,17 +1525,26 @@ uint32_t ch_peri_read(volatile uint32_t* paddr){
 
 // read from peripheral without the read barrier
 uint32_t ch_peri_read_nb(volatile uint32_t* paddr){
+    if (peri_simulated) return simPeriRead(paddr);
     return *paddr;
 }
 
 // safe write to peripheral
 void ch_peri_write(volatile uint32_t* paddr, uint32_t value){
+    if (peri_simulated){
+        simPeriWrite(paddr, value);
+        return;
+    }
     *paddr = value;
     *paddr = value;
 }
 
 // write to peripheral without the write barrier
 void ch_peri_write_nb(volatile uint32_t* paddr, uint32_t value){
+    if (peri_simulated){
+        simPeriWrite(paddr, value);
+        return;
+    }
     *paddr = value;
 }
 
@@ -1152,41 +1626,42 @@ void shiftOut(uint8_t dPin, uint8_t cPin, bcm2835SPIBitOrder order, uint8_t val)
 
 // Configures the specified pin to behave either as an input or an output
 void pinMode(int pin, Pinmode mode){
+	BusLock guard(&fsel_mutex);
 	pin = raspberryPinNumber(pin);
 	if(mode == OUTPUT){
 		switch(pin){
-			case 4:  GPFSEL0 &= ~(7 << 12); GPFSEL0 |= (1 << 12); break;
-			case 8:  GPFSEL0 &= ~(7 << 24); GPFSEL0 |= (1 << 24); break;
-			case 9:  GPFSEL0 &= ~(7 << 27); GPFSEL0 |= (1 << 27); break;
-			case 10: GPFSEL1 &= ~(7 << 0); 	GPFSEL1 |= (1 << 0);  break;
-			case 11: GPFSEL1 &= ~(7 << 3);  GPFSEL1 |= (1 << 3);  break;
-			case 14: GPFSEL1 &= ~(7 << 12); GPFSEL1 |= (1 << 12); break;
-			case 17: GPFSEL1 &= ~(7 << 21); GPFSEL1 |= (1 << 21); break;
-			case 18: GPFSEL1 &= ~(7 << 24); GPFSEL1 |= (1 << 24); break;
-			case 21: GPFSEL2 &= ~(7 << 3);  GPFSEL2 |= (1 << 3);  break;
-			case 27: GPFSEL2 &= ~(7 << 21); GPFSEL2 |= (1 << 21); break;
-			case 22: GPFSEL2 &= ~(7 << 6);  GPFSEL2 |= (1 << 6);  break;
-			case 23: GPFSEL2 &= ~(7 << 9);  GPFSEL2 |= (1 << 9);  break;
-			case 24: GPFSEL2 &= ~(7 << 12); GPFSEL2 |= (1 << 12); break;
-			case 25: GPFSEL2 &= ~(7 << 15); GPFSEL2 |= (1 << 15); break;
+			case 4:  ch_peri_set_bits(&GPFSEL0, 1 << 12, 7 << 12); break;
+			case 8:  ch_peri_set_bits(&GPFSEL0, 1 << 24, 7 << 24); break;
+			case 9:  ch_peri_set_bits(&GPFSEL0, 1 << 27, 7 << 27); break;
+			case 10: ch_peri_set_bits(&GPFSEL1, 1 << 0, 7 << 0);  break;
+			case 11: ch_peri_set_bits(&GPFSEL1, 1 << 3, 7 << 3);  break;
+			case 14: ch_peri_set_bits(&GPFSEL1, 1 << 12, 7 << 12); break;
+			case 17: ch_peri_set_bits(&GPFSEL1, 1 << 21, 7 << 21); break;
+			case 18: ch_peri_set_bits(&GPFSEL1, 1 << 24, 7 << 24); break;
+			case 21: ch_peri_set_bits(&GPFSEL2, 1 << 3, 7 << 3);  break;
+			case 27: ch_peri_set_bits(&GPFSEL2, 1 << 21, 7 << 21); break;
+			case 22: ch_peri_set_bits(&GPFSEL2, 1 << 6, 7 << 6);  break;
+			case 23: ch_peri_set_bits(&GPFSEL2, 1 << 9, 7 << 9);  break;
+			case 24: ch_peri_set_bits(&GPFSEL2, 1 << 12, 7 << 12); break;
+			case 25: ch_peri_set_bits(&GPFSEL2, 1 << 15, 7 << 15); break;
 		}
 
 	}else if (mode == INPUT){
 		switch(pin){
-			case 4:  GPFSEL0 &= ~(7 << 12); break;
-			case 8:  GPFSEL0 &= ~(7 << 24); break;
-			case 9:  GPFSEL0 &= ~(7 << 27); break;
-			case 10: GPFSEL1 &= ~(7 << 0);  break;
-			case 11: GPFSEL1 &= ~(7 << 3);  break;
-			case 14: GPFSEL1 &= ~(7 << 12);  break;			
-            case 17: GPFSEL1 &= ~(7 << 21); break;
-			case 18: GPFSEL1 &= ~(7 << 24); break;
-			case 21: GPFSEL2 &= ~(7 << 3);  break;
-			case 27: GPFSEL2 &= ~(7 << 3);  break;
-			case 22: GPFSEL2 &= ~(7 << 6);  break;
-			case 23: GPFSEL2 &= ~(7 << 9);  break;
-			case 24: GPFSEL2 &= ~(7 << 12); break;
-			case 25: GPFSEL2 &= ~(7 << 15); break;
+			case 4:  ch_peri_set_bits(&GPFSEL0, 0, 7 << 12); break;
+			case 8:  ch_peri_set_bits(&GPFSEL0, 0, 7 << 24); break;
+			case 9:  ch_peri_set_bits(&GPFSEL0, 0, 7 << 27); break;
+			case 10: ch_peri_set_bits(&GPFSEL1, 0, 7 << 0);  break;
+			case 11: ch_peri_set_bits(&GPFSEL1, 0, 7 << 3);  break;
+			case 14: ch_peri_set_bits(&GPFSEL1, 0, 7 << 12);  break;			
+            case 17: ch_peri_set_bits(&GPFSEL1, 0, 7 << 21); break;
+			case 18: ch_peri_set_bits(&GPFSEL1, 0, 7 << 24); break;
+			case 21: ch_peri_set_bits(&GPFSEL2, 0, 7 << 3);  break;
+			case 27: ch_peri_set_bits(&GPFSEL2, 0, 7 << 3);  break;
+			case 22: ch_peri_set_bits(&GPFSEL2, 0, 7 << 6);  break;
+			case 23: ch_peri_set_bits(&GPFSEL2, 0, 7 << 9);  break;
+			case 24: ch_peri_set_bits(&GPFSEL2, 0, 7 << 12); break;
+			case 25: ch_peri_set_bits(&GPFSEL2, 0, 7 << 15); break;
 		}
 	}
 }
@@ -1196,37 +1671,37 @@ void digitalWrite(int pin, int value){
 	pin = raspberryPinNumber(pin);
 	if (value == HIGH){
 		switch(pin){
-			case  4:GPSET0 =  BIT_4;break;
-			case  8:GPSET0 =  BIT_8;break;
-			case  9:GPSET0 =  BIT_9;break;
-			case 10:GPSET0 = BIT_10;break;
-			case 11:GPSET0 = BIT_11;break;
-			case 14:GPSET0 = BIT_14;break;
-			case 17:GPSET0 = BIT_17;break;
-			case 18:GPSET0 = BIT_18;break;
-			case 21:GPSET0 = BIT_21;break;
-			case 27:GPSET0 = BIT_27;break;
-			case 22:GPSET0 = BIT_22;break;
-			case 23:GPSET0 = BIT_23;break;
-			case 24:GPSET0 = BIT_24;break;
-			case 25:GPSET0 = BIT_25;break;
+			case  4:ch_peri_write_nb(&GPSET0, BIT_4);break;
+			case  8:ch_peri_write_nb(&GPSET0, BIT_8);break;
+			case  9:ch_peri_write_nb(&GPSET0, BIT_9);break;
+			case 10:ch_peri_write_nb(&GPSET0, BIT_10);break;
+			case 11:ch_peri_write_nb(&GPSET0, BIT_11);break;
+			case 14:ch_peri_write_nb(&GPSET0, BIT_14);break;
+			case 17:ch_peri_write_nb(&GPSET0, BIT_17);break;
+			case 18:ch_peri_write_nb(&GPSET0, BIT_18);break;
+			case 21:ch_peri_write_nb(&GPSET0, BIT_21);break;
+			case 27:ch_peri_write_nb(&GPSET0, BIT_27);break;
+			case 22:ch_peri_write_nb(&GPSET0, BIT_22);break;
+			case 23:ch_peri_write_nb(&GPSET0, BIT_23);break;
+			case 24:ch_peri_write_nb(&GPSET0, BIT_24);break;
+			case 25:ch_peri_write_nb(&GPSET0, BIT_25);break;
 		}
 	}else if(value == LOW){
 		switch(pin){
-			case  4:GPCLR0 =  BIT_4;break;
-			case  8:GPCLR0 =  BIT_8;break;
-			case  9:GPCLR0 =  BIT_9;break;
-			case 10:GPCLR0 = BIT_10;break;
-			case 11:GPCLR0 = BIT_11;break;
-			case 14:GPCLR0 = BIT_14;break;
-			case 17:GPCLR0 = BIT_17;break;
-			case 18:GPCLR0 = BIT_18;break;
-			case 21:GPCLR0 = BIT_21;break;
-			case 27:GPCLR0 = BIT_27;break;
-			case 22:GPCLR0 = BIT_22;break;
-			case 23:GPCLR0 = BIT_23;break;
-			case 24:GPCLR0 = BIT_24;break;
-			case 25:GPCLR0 = BIT_25;break;
+			case  4:ch_peri_write_nb(&GPCLR0, BIT_4);break;
+			case  8:ch_peri_write_nb(&GPCLR0, BIT_8);break;
+			case  9:ch_peri_write_nb(&GPCLR0, BIT_9);break;
+			case 10:ch_peri_write_nb(&GPCLR0, BIT_10);break;
+			case 11:ch_peri_write_nb(&GPCLR0, BIT_11);break;
+			case 14:ch_peri_write_nb(&GPCLR0, BIT_14);break;
+			case 17:ch_peri_write_nb(&GPCLR0, BIT_17);break;
+			case 18:ch_peri_write_nb(&GPCLR0, BIT_18);break;
+			case 21:ch_peri_write_nb(&GPCLR0, BIT_21);break;
+			case 27:ch_peri_write_nb(&GPCLR0, BIT_27);break;
+			case 22:ch_peri_write_nb(&GPCLR0, BIT_22);break;
+			case 23:ch_peri_write_nb(&GPCLR0, BIT_23);break;
+			case 24:ch_peri_write_nb(&GPCLR0, BIT_24);break;
+			case 25:ch_peri_write_nb(&GPCLR0, BIT_25);break;
 		}
 	}
     
@@ -1279,60 +1754,183 @@ int digitalRead(int pin){
 	Digivalue value;
 	pin = raspberryPinNumber(pin);
 	switch(pin){
-		case 4: if(GPLEV0 & BIT_4){value = HIGH;} else{value = LOW;};break;
-		case 8: if(GPLEV0 & BIT_8){value = HIGH;} else{value = LOW;};break;
-		case 9: if(GPLEV0 & BIT_9){value = HIGH;} else{value = LOW;};break;
-		case 10:if(GPLEV0 & BIT_10){value = HIGH;} else{value = LOW;};break;
-		case 11:if(GPLEV0 & BIT_11){value = HIGH;} else{value = LOW;};break;
-		case 17:if(GPLEV0 & BIT_17){value = HIGH;}else{value = LOW;};break;
-		case 18:if(GPLEV0 & BIT_18){value = HIGH;}else{value = LOW;};break;
-		case 21:if(GPLEV0 & BIT_21){value = HIGH;}else{value = LOW;};break;
-		case 27:if(GPLEV0 & BIT_27){value = HIGH;}else{value = LOW;};break;
-		case 22:if(GPLEV0 & BIT_22){value = HIGH;}else{value = LOW;};break;
-		case 23:if(GPLEV0 & BIT_23){value = HIGH;}else{value = LOW;};break;
-		case 24:if(GPLEV0 & BIT_24){value = HIGH;}else{value = LOW;};break;
-		case 25:if(GPLEV0 & BIT_25){value = HIGH;}else{value = LOW;};break;
+		case 4: if(ch_peri_read_nb(&GPLEV0) & BIT_4){value = HIGH;} else{value = LOW;};break;
+		case 8: if(ch_peri_read_nb(&GPLEV0) & BIT_8){value = HIGH;} else{value = LOW;};break;
+		case 9: if(ch_peri_read_nb(&GPLEV0) & BIT_9){value = HIGH;} else{value = LOW;};break;
+		case 10:if(ch_peri_read_nb(&GPLEV0) & BIT_10){value = HIGH;} else{value = LOW;};break;
+		case 11:if(ch_peri_read_nb(&GPLEV0) & BIT_11){value = HIGH;} else{value = LOW;};break;
+		case 17:if(ch_peri_read_nb(&GPLEV0) & BIT_17){value = HIGH;}else{value = LOW;};break;
+		case 18:if(ch_peri_read_nb(&GPLEV0) & BIT_18){value = HIGH;}else{value = LOW;};break;
+		case 21:if(ch_peri_read_nb(&GPLEV0) & BIT_21){value = HIGH;}else{value = LOW;};break;
+		case 27:if(ch_peri_read_nb(&GPLEV0) & BIT_27){value = HIGH;}else{value = LOW;};break;
+		case 22:if(ch_peri_read_nb(&GPLEV0) & BIT_22){value = HIGH;}else{value = LOW;};break;
+		case 23:if(ch_peri_read_nb(&GPLEV0) & BIT_23){value = HIGH;}else{value = LOW;};break;
+		case 24:if(ch_peri_read_nb(&GPLEV0) & BIT_24){value = HIGH;}else{value = LOW;};break;
+		case 25:if(ch_peri_read_nb(&GPLEV0) & BIT_25){value = HIGH;}else{value = LOW;};break;
 	}
 	return value;
 }
 
-int analogRead (int pin){
-
-	int value;
+/* The ADC of the shield is an LTC2309 (I2C address 0x08, AD1 and AD0 low).
+ * Command byte for each analog channel: S/D O/S S1 S0 UNI SLP X X, single
+ * ended and unipolar (LTC2309 datasheet, Table 1 "Channel Configuration").
+ * As the timing diagrams of the datasheet show, a conversion starts on the
+ * STOP that ends the write of the command, and the next read returns the
+ * result of that conversion. So in a write, repeated START, read
+ * transaction the 12 bits read belong to the channel selected in the previous
+ * transaction. analogRead() always relied on this by sending every command twice */
+static const unsigned char adc_channel_cmd[ANALOG_CHANNELS] = {
+	0xDC, 0x9C, 0xCC, 0x8C, 0xAC, 0xEC, 0xBC, 0xFC
+};
+
+#define ADC_ADDRESS 8
+
+pthread_mutex_t adc_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Channel whose conversion is pending in the ADC, -1 if unknown
+static int adc_pending_channel = -1;
+
+pthread_t idAnalogScan;
+static volatile bool analog_scan_running = false;
+static long analog_scan_period = 0;
+static struct AnalogSample *analog_ring = NULL;
+static int analog_ring_size = 0;
+static int analog_ring_head = 0;
+static int analog_ring_count = 0;
+
+/* Selects the given channel for the next conversion and returns the result of
+ * the conversion that was pending. Must be called with adc_mutex held */
+static int adcTransfer(int channel){
 	char selected_channel[1];
 	char read_values[2];
+	int value;
 
-	if (pin == 0) {
-		selected_channel[0] = 0xDC;
-	} else if (pin == 1){
-		selected_channel[0] = 0x9C;
-	} else if (pin == 2){ 
-		selected_channel[0] = 0xCC ;
-	} else if (pin == 3){ 
-		selected_channel[0] = 0x8C;
-	} else if (pin == 4){ 
-		selected_channel[0] = 0xAC;
-	} else if (pin == 5){ 
-		selected_channel[0] = 0xEC;
-	} else if (pin == 6){ 
-		selected_channel[0] = 0xBC;
-	} else if (pin == 7){ 
-		selected_channel[0] = 0xFC;
-	}
-	
+	selected_channel[0] = adc_channel_cmd[channel];
+	read_values[0] = 0;
+	read_values[1] = 0;
+
+	Wire.lock();
 	Wire.begin();
-	Wire.beginTransmission(8); 
-	Wire.read_rs(selected_channel, read_values, 2);
+	Wire.beginTransmission(ADC_ADDRESS);
 	Wire.read_rs(selected_channel, read_values, 2);
+	Wire.unlock();
+	adc_pending_channel = channel;
 
 	value = int(read_values[0])*16 + int(read_values[1]>>4);
 	value = value * 1023 / 4095;  //mapping the value between 0 and 1023
 	return value;
 }
 
+/* Reads every channel in a single pipelined sweep, starting from whatever
+ * conversion is already pending. Must be called with adc_mutex held */
+static void adcSweep(int out[ANALOG_CHANNELS]){
+	int ch;
+
+	if (adc_pending_channel != 0) adcTransfer(0);
+
+	for (ch = 0; ch < ANALOG_CHANNELS; ch++){
+		out[ch] = adcTransfer((ch + 1) % ANALOG_CHANNELS);
+	}
+}
+
+int analogRead (int pin){
+
+	int value;
+
+	if (pin < 0 || pin >= ANALOG_CHANNELS) return 0;
+
+	pthread_mutex_lock(&adc_mutex);
+	// The first transfer selects the channel, the second one returns its conversion
+	adcTransfer(pin);
+	value = adcTransfer(pin);
+	pthread_mutex_unlock(&adc_mutex);
+
+	return value;
+}
+
+/* Reads the 8 analog channels using 9 I2C transactions instead of 16:
+ * every transaction selects the next channel while returning the previous one */
+void analogReadAll(int out[ANALOG_CHANNELS]){
+	pthread_mutex_lock(&adc_mutex);
+	adcSweep(out);
+	pthread_mutex_unlock(&adc_mutex);
+}
+
+/* Starts a thread that sweeps all the analog channels every periodMicros
+ * microseconds (0 means as fast as the bus allows) and stores the samples in
+ * a ring buffer of depth entries. When the ring is full the oldest sample is lost.
+ * Returns: 0 if ok, -1 if error */
+int analogScanBegin(long periodMicros, int depth){
+	if (analog_scan_running || depth <= 0) return -1;
+
+	analog_ring = (struct AnalogSample *)malloc(depth * sizeof(struct AnalogSample));
+	if (analog_ring == NULL){
+		fprintf(stderr,"Unable to allocate the analog scan buffer\n");
+		return -1;
+	}
+
+	analog_ring_size = depth;
+	analog_ring_head = 0;
+	analog_ring_count = 0;
+	analog_scan_period = periodMicros;
+	analog_scan_running = true;
+
+	if (pthread_create(&idAnalogScan, NULL, analogScanFunction, NULL) != 0){
+		fprintf(stderr,"Unable to start the analog scan thread\n");
+		analog_scan_running = false;
+		free(analog_ring);
+		analog_ring = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+// Returns the number of samples waiting in the scan ring buffer
+int analogScanAvailable(){
+	int count;
+	pthread_mutex_lock(&adc_mutex);
+	count = analog_ring_count;
+	pthread_mutex_unlock(&adc_mutex);
+	return count;
+}
+
+/* Takes the oldest sample from the scan ring buffer
+ * Returns: 1 if a sample was copied, 0 if the buffer is empty */
+int analogScanRead(struct AnalogSample *sample){
+	int tail;
+
+	pthread_mutex_lock(&adc_mutex);
+	if (analog_ring_count == 0){
+		pthread_mutex_unlock(&adc_mutex);
+		return 0;
+	}
+	tail = (analog_ring_head + analog_ring_size - analog_ring_count) % analog_ring_size;
+	*sample = analog_ring[tail];
+	analog_ring_count--;
+	pthread_mutex_unlock(&adc_mutex);
+	return 1;
+}
+
+// Stops the scan thread and releases the ring buffer
+void analogScanEnd(){
+	if (!analog_scan_running) return;
+
+	analog_scan_running = false;
+	pthread_join(idAnalogScan, NULL);
+
+	free(analog_ring);
+	analog_ring = NULL;
+	analog_ring_size = 0;
+	analog_ring_count = 0;
+}
+
 void attachInterrupt(int p,void (*f)(), Digivalue m){
 	int GPIOPin = raspberryPinNumber(p);
 	pthread_t *threadId = getThreadIdFromPin(p);
+	if (threadId == NULL){
+		fprintf(stderr,"Pin %d does not support interrupts\n",p);
+		return;
+	}
+	BusLock guard(&interrupt_mutex);
 	struct ThreadArg *threadArgs = (ThreadArg *)malloc(sizeof(ThreadArg));
 	threadArgs->func = f;
 	threadArgs->pin = GPIOPin;
@@ -1383,6 +1981,9 @@ void attachInterrupt(int p,void (*f)(), Digivalue m){
 
 void detachInterrupt(int p){
 	int GPIOPin = raspberryPinNumber(p);
+	pthread_t *threadId = getThreadIdFromPin(p);
+	if (threadId == NULL) return;
+	BusLock guard(&interrupt_mutex);
 	
 	FILE *fp = fopen("/sys/class/gpio/unexport","w");
 	if (fp == NULL){
@@ -1393,67 +1994,188 @@ void detachInterrupt(int p){
 	}
 	fclose(fp);
 	
-	pthread_t *threadId = getThreadIdFromPin(p);
-	pthread_cancel(*threadId);
+	if (*threadId != 0) pthread_cancel(*threadId);
+	*threadId = 0;
+}
+
+static timeval start_program;
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+
+static void startTimer(){
+	gettimeofday(&start_program, NULL);
+}
+
+// Time the program started, taken once when Wire is constructed
+static const timeval *programStart(){
+	pthread_once(&start_once, startTimer);
+	return &start_program;
 }
 
 long millis(){
+	const timeval *start = programStart();
+	timeval end_point;
 	long elapsedTime;
 	// stop timer
     gettimeofday(&end_point, NULL);
 
     // compute and print the elapsed time in millisec
-    elapsedTime = (end_point.tv_sec - start_program.tv_sec) * 1000.0;      // sec to ms
-    elapsedTime += (end_point.tv_usec - start_program.tv_usec) / 1000.0;   // us to ms
+    elapsedTime = (end_point.tv_sec - start->tv_sec) * 1000.0;      // sec to ms
+    elapsedTime += (end_point.tv_usec - start->tv_usec) / 1000.0;   // us to ms
     return elapsedTime;
 }
 
+// Returns the number of microseconds since the program started
+unsigned long micros(){
+	const timeval *start = programStart();
+	timeval now;
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000UL + (now.tv_usec - start->tv_usec);
+}
+
 /* Some helper functions */
 
-int getBoardRev(){
-	
-	FILE *cpu_info;
-	char line [120];
-	char *c,finalChar;
-	static int rev = 0;
-	
-	if (REV != 0) return REV;
-	
-	if ((cpu_info = fopen("/proc/cpuinfo","r"))==NULL){
-		fprintf(stderr,"Unable to open /proc/cpuinfo. Cannot determine board reivision.\n");
-		exit(1);
+/* Board information, found once by boardInit() whatever thread asks first */
+static pthread_once_t board_once = PTHREAD_ONCE_INIT;
+static int board_rev = 2;
+static int board_model = BOARD_UNKNOWN;
+static uint32_t board_base = 0;
+static uint32_t board_clock = 0;
+
+/* Revision code of the board, from /proc/cpuinfo or the device tree if the
+ * kernel does not report it */
+static uint32_t readBoardCode(){
+	FILE *fp;
+	char line[120];
+	uint8_t raw[4];
+	char *c;
+	uint32_t code = 0;
+
+	if ((fp = fopen("/proc/cpuinfo","r")) != NULL){
+		while (fgets(line, sizeof(line), fp) != NULL){
+			if ((strncmp(line,"Revision",8) == 0) && ((c = strchr(line,':')) != NULL)){
+				code = strtoul(c + 1, NULL, 16);
+				break;
+			}
+		}
+		fclose(fp);
 	}
-	
-	while (fgets (line,120,cpu_info) != NULL){
-		if(strncmp(line,"Revision",8) == 0) break;
+
+	if ((code == 0) && ((fp = fopen("/proc/device-tree/system/linux,revision","rb")) != NULL)){
+		if (fread(raw, 1, 4, fp) == 4)
+			code = ((uint32_t)raw[0] << 24) | ((uint32_t)raw[1] << 16) | ((uint32_t)raw[2] << 8) | raw[3];
+		fclose(fp);
 	}
-	
-	fclose(cpu_info);
-	
-	if (line == NULL){
-		fprintf (stderr, "Unable to determine board revision from /proc/cpuinfo.\n") ;
-		exit(1);
+
+	if (code == 0)
+		fprintf(stderr,"Unable to determine the board revision, a Pi 2 is assumed\n");
+	return code;
+}
+
+/* Board model. New style revision codes (bit 23 set) give the type in bits
+ * 4-11 and the processor in bits 12-15, old style ones are all Pi 1 */
+static int boardModel(uint32_t code){
+	if (code == 0) return BOARD_UNKNOWN;
+	if (!(code & (1 << 23))) return BOARD_PI1;
+
+	switch ((code >> 4) & 0xFF){
+		case 0x09:
+		case 0x0C: return BOARD_ZERO;
 	}
-	
-	for (c = line ; *c ; ++c)
-    if (isdigit (*c))
-      break ;
+	switch ((code >> 12) & 0x0F){
+		case 0: return BOARD_PI1;
+		case 1: return BOARD_PI2;
+		case 2: return BOARD_PI3;
+		case 3: return BOARD_PI4;
+	}
+	return BOARD_UNKNOWN;
+}
+
+/* Physical address of the peripherals. The second cell of the soc ranges is
+ * the parent address, on the Pi 4 it takes two cells and the first one is 0.
+ * Without a device tree the base of the model is used */
+static uint32_t readPeripheralBase(int model){
+	uint8_t ranges[12];
+	uint32_t base = 0;
+	FILE *fp;
+
+	if ((fp = fopen("/proc/device-tree/soc/ranges","rb")) != NULL){
+		if (fread(ranges, 1, sizeof(ranges), fp) == sizeof(ranges)){
+			base = ((uint32_t)ranges[4] << 24) | ((uint32_t)ranges[5] << 16) | ((uint32_t)ranges[6] << 8) | ranges[7];
+			if (base == 0)
+				base = ((uint32_t)ranges[8] << 24) | ((uint32_t)ranges[9] << 16) | ((uint32_t)ranges[10] << 8) | ranges[11];
+		}
+		fclose(fp);
+	}
+	if (base != 0) return base;
 
-	if (!isdigit (*c)){
-		fprintf (stderr, "Unable to determine board revision from /proc/cpuinfo\n") ;
-		fprintf (stderr, "  (Info not found in: %s\n", line) ;
-		exit(1);
+	switch (model){
+		case BOARD_PI1:
+		case BOARD_ZERO: return 0x20000000;
+		case BOARD_PI4:  return 0xFE000000;
 	}
-	
-	finalChar = c [strlen (c) - 2] ;
-	
-	if ((finalChar == '2') || (finalChar == '3')){
-		bsc0 = bsc_rev1;
-		return 1;
-	}else{
-		bsc0 = bsc_rev2;
-		return 2;
+	return 0x3F000000;
+}
+
+/* Core (VPU) clock in Hz, the source of the SPI and I2C dividers. The rate
+ * set by the firmware is read from debugfs when it is readable (root),
+ * otherwise the default of the model is used */
+static uint32_t readCoreClock(int model){
+	unsigned long rate = 0;
+	FILE *fp;
+
+	if ((fp = fopen("/sys/kernel/debug/clk/vpu/clk_rate","r")) != NULL){
+		if (fscanf(fp, "%lu", &rate) != 1) rate = 0;
+		fclose(fp);
+	}
+	if (rate != 0) return rate;
+
+	switch (model){
+		case BOARD_ZERO:
+		case BOARD_PI3: return 400000000;
+		case BOARD_PI4: return 500000000;
 	}
+	return BCM2835_CORE_CLK_HZ;
+}
+
+static void boardInit(){
+	uint32_t code;
+
+	// The simulator behaves as a revision 2 board of unknown model
+	if (arduPiBackend() == ARDUPI_BACKEND_SIM){
+		board_base = readPeripheralBase(BOARD_UNKNOWN);
+		board_clock = BCM2835_CORE_CLK_HZ;
+		return;
+	}
+
+	code = readBoardCode();
+	board_model = boardModel(code);
+	board_base = readPeripheralBase(board_model);
+	board_clock = readCoreClock(board_model);
+
+	// Old style codes 0002 and 0003 (the warranty bits are above)
+	if (!(code & (1 << 23)) && (((code & 0xFFFF) == 0x0002) || ((code & 0xFFFF) == 0x0003)))
+		board_rev = 1;
+}
+
+// Board revision as seen by the pinout: 1 for the first 1B boards, 2 for the rest
+int getBoardRev(){
+	pthread_once(&board_once, boardInit);
+	return board_rev;
+}
+
+int getBoardModel(){
+	pthread_once(&board_once, boardInit);
+	return board_model;
+}
+
+uint32_t getPeripheralBase(){
+	pthread_once(&board_once, boardInit);
+	return board_base;
+}
+
+uint32_t getCoreClock(){
+	pthread_once(&board_once, boardInit);
+	return board_clock;
 }
 
 uint32_t* mapmem(const char *msg, size_t size, int fd, off_t off)
@@ -1473,7 +2195,7 @@ int raspberryPinNumber(int arduinoPin){
 		case 5: return 25; break;
 		case 6: return  4; break;
 		case 7: return 17; break;
-		case 8: if(REV == 1){return 21;}else{return 27;} break;
+		case 8: if(getBoardRev() == 1){return 21;}else{return 27;} break;
 		case 9: return 22; break;
 		case 10: return 8; break;
 		case 11: return 10; break;
@@ -1483,6 +2205,7 @@ int raspberryPinNumber(int arduinoPin){
 }
 
 void ch_gpio_fsel(uint8_t pin, uint8_t mode){
+    BusLock guard(&fsel_mutex);
     // Function selects are 10 pins per 32 bit word, 3 bits per pin
     volatile uint32_t* paddr = (volatile uint32_t*)gpio.map + BCM2835_GPFSEL0/4 + (pin/10);
     uint8_t   shift = (pin % 10) * 3;
@@ -1492,20 +2215,8 @@ void ch_gpio_fsel(uint8_t pin, uint8_t mode){
 }
 
 pthread_t *getThreadIdFromPin(int pin){
-	switch(pin){
-		case 2: return &idThread2; break;
-		case 3: return &idThread3; break;
-		case 4: return &idThread4; break;
-		case 5: return &idThread5; break;
-		case 6: return &idThread6; break;
-		case 7: return &idThread7; break;
-		case 8: return &idThread8; break;
-		case 9: return &idThread9; break;
-		case 10: return &idThread10; break;
-		case 11: return &idThread11; break;
-		case 12: return &idThread12; break;
-		case 13: return &idThread13; break;
-	}
+	if ((pin < 2) || (pin > 13)) return NULL;
+	return &interrupt_thread[pin];
 }
 
 /* This is the function that will be running in a thread if
@@ -1563,6 +2274,43 @@ void * threadFunction(void *args){
 	}
 }
 
+/* This is the function that will be running in a thread if
+ * analogScanBegin() is called */
+void * analogScanFunction(void *){
+	struct AnalogSample sample;
+	struct timespec next;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while(analog_scan_running){
+		pthread_mutex_lock(&adc_mutex);
+		sample.timestamp = micros();
+		// The last transfer of a sweep leaves channel 0 pending, so the
+		// following sweeps only need 8 transactions
+		adcSweep(sample.value);
+		analog_ring[analog_ring_head] = sample;
+		analog_ring_head = (analog_ring_head + 1) % analog_ring_size;
+		if (analog_ring_count < analog_ring_size) analog_ring_count++;
+		pthread_mutex_unlock(&adc_mutex);
+
+		if (analog_scan_period > 0){
+			next.tv_nsec += (analog_scan_period % 1000000) * 1000;
+			next.tv_sec += analog_scan_period / 1000000 + next.tv_nsec / 1000000000;
+			next.tv_nsec %= 1000000000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+	return NULL;
+}
+
+/* This is the function that will be running in a thread if
+ * SPIPi::beginQueue() is called */
+void * spiQueueFunction(void *args){
+	SPIPi *spi = (SPIPi *)args;
+	spi->runQueue();
+	return NULL;
+}
+
 SerialPi Serial = SerialPi();
 WirePi Wire = WirePi();
 SPIPi SPI = SPIPi();
@@ -45,10 +45,12 @@
 #include <limits.h>
 #include <pthread.h>
 #include <poll.h>
+#include <linux/spi/spidev.h>
 #include <bcm2835.h>
 #include <stdarg.h> //Include forva_start, va_arg and va_end strings functions
 
-#define IOBASE   0x3f000000
+// Peripheral base of the board in use, read from /proc/device-tree/soc/ranges
+#define IOBASE   (getPeripheralBase())
 
 
 #define GPIO_BASE2 (IOBASE + 0x200000)
@@ -56,6 +58,15 @@
 
 #define BCM2835_BSC1_BASE2		(IOBASE + 0x804000)
 
+/* Board models, from the revision code in /proc/cpuinfo. The peripheral base
+ * and the core clock depend on them */
+#define BOARD_UNKNOWN   0 ///< Not a Raspberry Pi or simulated, Pi 2 layout assumed
+#define BOARD_PI1       1 ///< BCM2835: 1A, 1B, 1A+, 1B+, CM1. Base 0x20000000, core 250MHz
+#define BOARD_ZERO      2 ///< BCM2835: Zero, Zero W. Base 0x20000000, core 400MHz
+#define BOARD_PI2       3 ///< BCM2836: 2B. Base 0x3F000000, core 250MHz
+#define BOARD_PI3       4 ///< BCM2837: 3B, 3B+, 3A+, CM3, Zero 2 W. Base 0x3F000000, core 400MHz
+#define BOARD_PI4       5 ///< BCM2711: 4B, 400, CM4. Base 0xFE000000, core 500MHz
+
 // Defines for I2C
 // GPIO register offsets from BCM2835_BSC*_BASE.
 // Offsets into the BSC Peripheral block in bytes per 3.1 BSC Register Map
@@ -91,13 +102,10 @@
 #define BCM2835_BSC_S_TA 						0x00000001 ///< Transfer Active
 
 #define BCM2835_BSC_FIFO_SIZE   				16 ///< BSC FIFO size
-#define BCM2835_CORE_CLK_HZ				250000000	///< 250 MHz
-
-#define BSC0_C        *(bsc0.addr + 0x00)
-#define BSC0_S        *(bsc0.addr + 0x01)
-#define BSC0_DLEN    *(bsc0.addr + 0x02)
-#define BSC0_A        *(bsc0.addr + 0x03)
-#define BSC0_FIFO    *(bsc0.addr + 0x04)
+/* 250 MHz, the core clock of the Pi 1 and 2. SPI dividers written for it
+ * keep their SCLK rate on other boards if they are given to SPISettings as
+ * BCM2835_CORE_CLK_HZ / divider. Timing uses getCoreClock() */
+#define BCM2835_CORE_CLK_HZ				250000000
 
 #define BSC_C_I2CEN    (1 << 15)
 #define BSC_C_INTR    (1 << 10)
@@ -213,8 +221,6 @@
 #define SCK		13
 
 
-static int REV = 0;
-
 #define LSBFIRST  0  ///< LSB First
 #define MSBFIRST  1   ///< MSB First
 
@@ -283,21 +289,31 @@ struct ThreadArg{
     int pin;
 };
 
+#define ANALOG_CHANNELS 8
+
+/* One sweep over all the ADC channels taken by the analog scan thread.
+ * timestamp is the micros() value when the sweep started */
+struct AnalogSample{
+    unsigned long timestamp;
+    int value[ANALOG_CHANNELS];
+};
+
 
 
 /* SerialPi Class
- * Class that provides the functionality of arduino Serial library
+ * Class that provides the functionality of arduino Serial library.
+ * Every call is atomic. A thread that needs several calls in a row (a command
+ * and its answer) holds the port with lock()/unlock(), they can be nested
  */
 class SerialPi {
 
 private:
 	int sd,status;
 	const char *serialPort;
-	unsigned char c;
 	struct termios options;
 	int speed;
 	long timeOut;
-	timespec time1, time2;
+	pthread_mutex_t port_mutex;
 	timespec timeDiff(timespec start, timespec end);
 	char * int2bin(int i);
 	char * int2hex(int i);
@@ -310,6 +326,8 @@ public:
 	int available();
 	char read();
 	int readBytes(char message[], int size);
+	int readAvailable(char message[], int size);
+	int waitAvailable(int millis);
 	int readBytesUntil(char character,char buffer[],int length);
 	bool find(const char *target);
 	bool findUntil(const char *target, const char *terminal);
@@ -330,22 +348,26 @@ public:
 	void flush();
 	void setTimeout(long millis);
 	void end();
+	void lock();
+	void unlock();
 };
 
 /* WirePi Class
- * Class that provides the functionality of arduino Wire library
+ * Class that provides the functionality of arduino Wire library.
+ * Every transfer is atomic. The address set by beginTransmission() or
+ * requestFrom() is shared, so other threads are kept out of a whole exchange
+ * with lock()/unlock(), they can be nested
  */
 class WirePi{
 	private:
-		int memfd;
 		int i2c_byte_wait_us;
 		int i2c_bytes_to_read;
-		void dump_bsc_status();
-		int map_peripheral(struct bcm2835_peripheral *p);
-		void unmap_peripheral(struct bcm2835_peripheral *p);
-		void wait_i2c_done();
+		bool i2c_pins_ready;
+		pthread_mutex_t bus_mutex;
 	public:
 		WirePi();
+		void lock();
+		void unlock();
 		void begin();
 		void beginTransmission(unsigned char address);
 		void write(char data);
@@ -357,11 +379,90 @@ class WirePi{
 		uint8_t read_rs(char* regaddr, char* buf, uint32_t len);
 };
 
+#define BCM2835_SPI0_FIFO_SIZE   16 ///< SPI0 FIFO depth in words
+
+/// Backends used to run the SPI transaction queue
+#define SPI_QUEUE_NONE       0 ///< Queue not started
+#define SPI_QUEUE_SPIDEV     1 ///< Batched through /dev/spidev0.x, the kernel driver uses DMA
+#define SPI_QUEUE_POLLED     2 ///< Polled FIFO transfers when spidev is not available
+
+#define SPI_QUEUE_MAX_BATCH  32   ///< Transactions sent in a single SPI_IOC_MESSAGE
+#define SPI_QUEUE_MAX_BYTES  4096 ///< spidev default bufsiz
+
+/* SPI transaction descriptor for the SPI queue. The descriptor and its buffers
+ * must stay valid until the callback is called */
+struct SPITransaction{
+    uint8_t cs;             ///< BCM2835_SPI_CS0, BCM2835_SPI_CS1 or BCM2835_SPI_CS_NONE
+    int cs_pin;             ///< with BCM2835_SPI_CS_NONE, GPIO (arduino pin) held low during the transfer, -1 if none
+    uint8_t mode;           ///< SPI_MODE0 .. SPI_MODE3
+    uint16_t divider;       ///< SPI_CLOCK_DIVxx
+    const uint8_t *tbuf;    ///< bytes to send, NULL sends zeros
+    uint8_t *rbuf;          ///< received bytes, NULL discards them
+    uint32_t len;
+    void (*callback)(struct SPITransaction *t); ///< called when done, may be NULL
+    void *arg;              ///< free for the caller
+    int status;             ///< 0 if ok, -1 if error
+    struct SPITransaction *next;
+};
+
+/* SPISettings Class
+ * Precomputed SPI0 configuration of one device: the CS register image (chip
+ * select, clock polarity and phase) and the clock divider, applied by
+ * SPIPi::beginTransaction().
+ * The chip select is driven by the transfer engine: cs can be a hardware CE
+ * line (BCM2835_SPI_CS0/CS1), a GPIO set with setChipSelectPin(), or
+ * BCM2835_SPI_CS_NONE if the driver handles it. The bit order is always
+ * MSBFIRST, SPI0 has no LSB first mode */
+class SPISettings{
+	private:
+		uint32_t cs_image;
+		uint32_t clk;
+		int cs_pin;
+		friend class SPIPi;
+	public:
+		SPISettings();
+		SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode, uint8_t cs = BCM2835_SPI_CS0);
+		void setChipSelectPin(int pin);
+};
+
 class SPIPi{
+	private:
+		pthread_mutex_t bus_mutex;
+		uint32_t cur_cs_image;
+		uint32_t cur_clk;
+		uint32_t cspol_bits;
+		int txn_depth;
+		bool txn_cs_hold;
+		int txn_cs_pin;
+		bool cs_asserted;
+		int cs_pin_configured;
+		int spidev_fd[2];
+		uint8_t spidev_mode[2];
+		int queue_backend;
+		bool queue_running;
+		bool queue_busy;
+		struct SPITransaction *queue_head;
+		struct SPITransaction *queue_tail;
+		pthread_t queue_thread;
+		pthread_mutex_t queue_mutex;
+		pthread_cond_t queue_cond;
+		pthread_cond_t queue_idle;
+		void transferFifo(const uint8_t* tbuf, uint8_t* rbuf, uint32_t len);
+		void applySettings(uint32_t cs_image, uint32_t clk);
+		void assertChipSelect();
+		void releaseChipSelect();
+		void configureChipSelectPin(int pin);
+		void runQueue();
+		void runTransactions(struct SPITransaction *t);
+		friend void * spiQueueFunction(void *args);
 	public:
 		SPIPi();
   		void begin();
     	void end();
+    	void beginTransaction(const SPISettings &settings);
+    	void endTransaction();
+		void lock();
+		void unlock();
     	void setBitOrder(uint8_t order);
  		void setClockDivider(uint16_t divider);
 		void setDataMode(uint8_t mode);
@@ -369,6 +470,14 @@ class SPIPi{
 		void setChipSelectPolarity(uint8_t cs, uint8_t active);
  		uint8_t transfer(uint8_t value);
  		void transfernb(char* tbuf, char* rbuf, uint32_t len);
+ 		void transfer(const void* tbuf, void* rbuf, size_t len);
+ 		void writenb(const void* tbuf, size_t len);
+ 		void readnb(void* rbuf, size_t len);
+ 		int beginQueue();
+ 		void endQueue();
+ 		int getQueueBackend();
+ 		int queueTransaction(struct SPITransaction *t);
+ 		void waitQueue();
 };
 
 /* Some useful arduino functions */
@@ -379,6 +488,11 @@ void delay(long millis);
 void delayMicroseconds(long micros);
 int digitalRead(int pin);
 int analogRead (int pin);
+void analogReadAll(int out[ANALOG_CHANNELS]);
+int analogScanBegin(long periodMicros, int depth);
+int analogScanAvailable();
+int analogScanRead(struct AnalogSample *sample);
+void analogScanEnd();
 
 
 uint8_t shiftIn  (uint8_t dPin, uint8_t cPin, bcm2835SPIBitOrder order);
@@ -388,9 +502,13 @@ void detachInterrupt(int p);
 void setup();
 void loop();
 long millis();
+unsigned long micros();
 
 /* Helper functions */
 int getBoardRev();
+int getBoardModel();
+uint32_t getPeripheralBase();
+uint32_t getCoreClock();
 uint32_t *mapmem(const char *msg, size_t size, int fd, off_t off);
 void setBoardRev(int rev);
 int raspberryPinNumber(int arduinoPin);
@@ -402,6 +520,8 @@ void ch_peri_write_nb(volatile uint32_t* paddr, uint32_t value);
 void ch_peri_set_bits(volatile uint32_t* paddr, uint32_t value, uint32_t mask);
 void ch_gpio_fsel(uint8_t pin, uint8_t mode);
 void * threadFunction(void *args);
+void * analogScanFunction(void *args);
+void * spiQueueFunction(void *args);
 
 extern SerialPi Serial;
 extern WirePi Wire;
@@ -0,0 +1,613 @@
+/*
+*  Copyright (C) 2012 Libelium Comunicaciones Distribuidas S.L.
+*  http://www.libelium.com
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*  Version 2.4 (For Raspberry Pi 2)
+*  Author: Sergio Martinez, Ruben Martin
+*/
+
+
+#include "arduPiBackend.h"
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+extern struct bcm2835_peripheral gpio;
+extern volatile uint32_t *bcm2835_bsc01;
+extern void *spi0;
+
+bool peri_simulated = false;
+
+static int backend = ARDUPI_BACKEND_BCM;
+static pthread_once_t backend_once = PTHREAD_ONCE_INIT;
+static pthread_once_t peripherals_once = PTHREAD_ONCE_INIT;
+
+
+/*********************************
+ *                               *
+ * Backend selection and mapping *
+ * ----------------------------- *
+ *********************************/
+
+static void backendInit(){
+    const char *name;
+
+    name = getenv("ARDUPI_BACKEND");
+    if (name != NULL){
+        if (strcmp(name, "kernel") == 0) backend = ARDUPI_BACKEND_KERNEL;
+        else if (strcmp(name, "sim") == 0) backend = ARDUPI_BACKEND_SIM;
+        else if (strcmp(name, "bcm") != 0)
+            fprintf(stderr, "Unknown ARDUPI_BACKEND \"%s\", using bcm\n", name);
+    }
+
+    peri_simulated = (backend == ARDUPI_BACKEND_SIM);
+}
+
+int arduPiBackend(){
+    pthread_once(&backend_once, backendInit);
+    return backend;
+}
+
+static void simBegin();
+
+// Memory used as BSC1 and SPI0 blocks by the kernel backend
+static uint32_t kernel_bsc1[BLOCK_SIZE/4];
+static uint32_t kernel_spi0[BLOCK_SIZE/4];
+
+/* Gets the addresses of the GPIO, BSC1 and SPI0 blocks for the selected
+ * backend. The programs that cannot run without them exit here, as the
+ * constructors did before */
+static void peripheralsInit(){
+    int fd;
+
+    switch (arduPiBackend()){
+        case ARDUPI_BACKEND_KERNEL:
+            // The gpiomem driver exposes the GPIO block only, without root
+            if ((fd = open("/dev/gpiomem", O_RDWR | O_SYNC)) < 0){
+                fprintf(stderr, "Unable to open /dev/gpiomem: %s\n", strerror(errno));
+                exit(1);
+            }
+            gpio.mem_fd = fd;
+            gpio.map = mapmem("gpio", BLOCK_SIZE, fd, 0);
+            if (gpio.map == MAP_FAILED) exit(1);
+
+            kernel_bsc1[BCM2835_BSC_DIV/4] = 0x5DC;
+            bcm2835_bsc01 = kernel_bsc1;
+            spi0 = kernel_spi0;
+            break;
+
+        case ARDUPI_BACKEND_SIM:
+            simBegin();
+            break;
+
+        default:
+            if ((fd = open("/dev/mem", O_RDWR | O_SYNC)) < 0){
+                fprintf(stderr, "Unable to open /dev/mem: %s. Run as root or set ARDUPI_BACKEND=kernel\n",
+                    strerror(errno));
+                exit(1);
+            }
+            gpio.mem_fd = fd;
+            gpio.addr_p = GPIO_BASE2;
+            gpio.map = mapmem("gpio", BLOCK_SIZE, fd, gpio.addr_p);
+            bcm2835_bsc01 = mapmem("bsc1", BLOCK_SIZE, fd, BCM2835_BSC1_BASE2);
+            spi0 = mapmem("spi0", BLOCK_SIZE, fd, BCM2835_SPI0_BASE2);
+            if ((gpio.map == MAP_FAILED) || (bcm2835_bsc01 == MAP_FAILED) || (spi0 == MAP_FAILED)) exit(1);
+            break;
+    }
+
+    gpio.addr = (volatile unsigned int *)gpio.map;
+}
+
+void arduPiBackendBegin(){
+    pthread_once(&peripherals_once, peripheralsInit);
+}
+
+static int simModemBegin();
+static char sim_tty[64];
+static pthread_once_t sim_modem_once = PTHREAD_ONCE_INIT;
+
+static void simModemInit(){
+    if (simModemBegin() != 0){
+        fprintf(stderr, "Unable to create the PTY of the simulated modem\n");
+        exit(1);
+    }
+}
+
+const char *arduPiSerialPort(){
+    const char *name;
+
+    if (arduPiBackend() == ARDUPI_BACKEND_SIM){
+        pthread_once(&sim_modem_once, simModemInit);
+        return sim_tty;
+    }
+
+    name = getenv("ARDUPI_TTY");
+    return (name != NULL) ? name : ARDUPI_TTY_DEFAULT;
+}
+
+
+/*********************************
+ *                               *
+ * Kernel backend                *
+ * ----------------------------- *
+ *********************************/
+
+static int i2cdev_fd = -1;
+static int kernel_spidev_fd[2] = {-1, -1};
+static uint32_t kernel_spidev_mode[2] = {0xFFFFFFFF, 0xFFFFFFFF};
+
+// One I2C_RDWR with a write message, a read message or both (repeated start)
+int kernelI2CTransfer(uint8_t address, const char *wbuf, uint32_t wlen, char *rbuf, uint32_t rlen){
+    struct i2c_msg msgs[2];
+    struct i2c_rdwr_ioctl_data data;
+    int n = 0;
+
+    if ((i2cdev_fd < 0) && ((i2cdev_fd = open(ARDUPI_I2CDEV, O_RDWR)) < 0)){
+        fprintf(stderr, "Unable to open %s: %s\n", ARDUPI_I2CDEV, strerror(errno));
+        return -1;
+    }
+
+    if (wlen > 0){
+        msgs[n].addr = address;
+        msgs[n].flags = 0;
+        msgs[n].len = wlen;
+        msgs[n].buf = (__u8 *)wbuf;
+        n++;
+    }
+    if (rlen > 0){
+        msgs[n].addr = address;
+        msgs[n].flags = I2C_M_RD;
+        msgs[n].len = rlen;
+        msgs[n].buf = (__u8 *)rbuf;
+        n++;
+    }
+    if (n == 0) return 0;
+
+    data.msgs = msgs;
+    data.nmsgs = n;
+    return (ioctl(i2cdev_fd, I2C_RDWR, &data) < 0) ? -1 : 0;
+}
+
+/* Gets the spidev of the chip select loaded in the CS register and sets its
+ * mode. A GPIO chip select (BCM2835_SPI_CS_NONE) uses spidev0.0 without CS */
+static int kernelSPIDevice(volatile uint32_t *regs){
+    uint32_t cs = regs[BCM2835_SPI0_CS/4] & BCM2835_SPI0_CS_CS;
+    uint32_t mode = (regs[BCM2835_SPI0_CS/4] >> 2) & 0x03;
+    int index = (cs == BCM2835_SPI_CS1) ? 1 : 0;
+    int fd;
+
+    if (cs == BCM2835_SPI_CS_NONE) mode |= SPI_NO_CS;
+
+    if (kernel_spidev_fd[index] < 0){
+        kernel_spidev_fd[index] = open(index ? ARDUPI_SPIDEV1 : ARDUPI_SPIDEV0, O_RDWR);
+        if (kernel_spidev_fd[index] < 0){
+            fprintf(stderr, "Unable to open %s: %s\n", index ? ARDUPI_SPIDEV1 : ARDUPI_SPIDEV0, strerror(errno));
+            return -1;
+        }
+    }
+    fd = kernel_spidev_fd[index];
+
+    if (kernel_spidev_mode[index] != mode){
+        if (ioctl(fd, SPI_IOC_WR_MODE32, &mode) < 0) return -1;
+        kernel_spidev_mode[index] = mode;
+    }
+    return fd;
+}
+
+/* One transfer with the divider and mode loaded in the SPI0 registers. With
+ * hold the chip select stays asserted for the next transfer, until
+ * kernelSPIRelease() */
+int kernelSPITransfer(volatile uint32_t *regs, bool hold, const uint8_t *tbuf, uint8_t *rbuf, uint32_t len){
+    struct spi_ioc_transfer xfer;
+    uint32_t clk = regs[BCM2835_SPI0_CLK/4];
+    int fd = kernelSPIDevice(regs);
+
+    if (fd < 0) return -1;
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.tx_buf = (unsigned long)tbuf;
+    xfer.rx_buf = (unsigned long)rbuf;
+    xfer.len = len;
+    xfer.speed_hz = getCoreClock() / (clk ? clk : 65536);
+    xfer.bits_per_word = 8;
+    xfer.cs_change = hold ? 1 : 0;
+
+    return (ioctl(fd, SPI_IOC_MESSAGE(1), &xfer) < 0) ? -1 : 0;
+}
+
+// Deasserts a chip select kept by kernelSPITransfer() with an empty message
+void kernelSPIRelease(volatile uint32_t *regs){
+    struct spi_ioc_transfer xfer;
+    int fd = kernelSPIDevice(regs);
+
+    if (fd < 0) return;
+
+    memset(&xfer, 0, sizeof(xfer));
+    ioctl(fd, SPI_IOC_MESSAGE(1), &xfer);
+}
+
+
+/*********************************
+ *                               *
+ * Simulator                     *
+ * ----------------------------- *
+ *********************************/
+
+static uint32_t sim_gpio[BLOCK_SIZE/4];
+static uint32_t sim_bsc1[BLOCK_SIZE/4];
+static uint32_t sim_spi0[BLOCK_SIZE/4];
+
+// GPIO: output latch and levels driven by simGPIOInput()
+static uint32_t sim_gpio_out = 0;
+static uint32_t sim_gpio_in = 0;
+
+// SPI0: devices and RX FIFO
+static struct SimSPIDevice *sim_spi_dev[4];
+static uint8_t sim_spi_rx[BCM2835_SPI0_FIFO_SIZE];
+static uint32_t sim_spi_rx_head = 0;
+static uint32_t sim_spi_rx_count = 0;
+
+// BSC1: devices, bytes of the write in progress and bytes read
+#define SIM_I2C_BUFFER  256
+static struct SimI2CDevice *sim_i2c_dev[128];
+static struct SimI2CDevice sim_mcp23008;
+static struct SimI2CDevice sim_adc;
+static uint8_t sim_i2c_tx[SIM_I2C_BUFFER];
+static uint32_t sim_i2c_tx_count = 0;
+static uint8_t sim_i2c_rx[SIM_I2C_BUFFER];
+static uint32_t sim_i2c_rx_head = 0;
+static uint32_t sim_i2c_rx_count = 0;
+static bool sim_i2c_active = false;
+static uint32_t sim_i2c_status = 0;
+
+// The models are shared by all the threads, the GPIO one by all the buses
+static pthread_mutex_t sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void simBegin(){
+    memset(sim_gpio, 0, sizeof(sim_gpio));
+    memset(sim_bsc1, 0, sizeof(sim_bsc1));
+    memset(sim_spi0, 0, sizeof(sim_spi0));
+    sim_bsc1[BCM2835_BSC_DIV/4] = 0x5DC;
+
+    memset(&sim_mcp23008, 0, sizeof(sim_mcp23008));
+    memset(&sim_adc, 0, sizeof(sim_adc));
+    // MCP23008 IODIR reset value, all inputs
+    sim_mcp23008.reg[0] = 0xFF;
+    sim_i2c_dev[0x20] = &sim_mcp23008;
+    sim_i2c_dev[0x08] = &sim_adc;
+
+    gpio.mem_fd = -1;
+    gpio.map = sim_gpio;
+    bcm2835_bsc01 = sim_bsc1;
+    spi0 = sim_spi0;
+}
+
+void simSPIAttach(uint8_t cs, struct SimSPIDevice *dev){
+    pthread_mutex_lock(&sim_mutex);
+    sim_spi_dev[cs & BCM2835_SPI0_CS_CS] = dev;
+    pthread_mutex_unlock(&sim_mutex);
+}
+
+void simI2CAttach(uint8_t address, struct SimI2CDevice *dev){
+    pthread_mutex_lock(&sim_mutex);
+    sim_i2c_dev[address & 0x7F] = dev;
+    pthread_mutex_unlock(&sim_mutex);
+}
+
+void simGPIOInput(int pin, int value){
+    if ((pin < 0) || (pin > 31)) return;
+    pthread_mutex_lock(&sim_mutex);
+    if (value) sim_gpio_in |= (1UL << pin);
+    else sim_gpio_in &= ~(1UL << pin);
+    pthread_mutex_unlock(&sim_mutex);
+}
+
+// Outputs show the latch, the rest of the pins the level set by simGPIOInput()
+static uint32_t simGPIOLevels(){
+    uint32_t outputs = 0;
+    uint32_t fsel;
+
+    for (int pin = 0; pin < 32; pin++){
+        fsel = (sim_gpio[pin/10] >> ((pin % 10) * 3)) & BCM2835_GPIO_FSEL_MASK;
+        if (fsel == BCM2835_GPIO_FSEL_OUTP) outputs |= (1UL << pin);
+    }
+    return (sim_gpio_out & outputs) | (sim_gpio_in & ~outputs);
+}
+
+static void simI2CWrite(const uint8_t *data, uint32_t len){
+    struct SimI2CDevice *dev = sim_i2c_dev[sim_bsc1[BCM2835_BSC_A/4] & 0x7F];
+
+    if (dev == NULL){
+        sim_i2c_status |= BCM2835_BSC_S_ERR;
+        return;
+    }
+
+    if (dev->write != NULL){
+        if (dev->write(dev, data, len) != 0) sim_i2c_status |= BCM2835_BSC_S_ERR;
+        return;
+    }
+
+    if (len == 0) return;
+    dev->pointer = data[0];
+    for (uint32_t i = 1; i < len; i++) dev->reg[dev->pointer++] = data[i];
+}
+
+static void simI2CRead(uint32_t len){
+    struct SimI2CDevice *dev = sim_i2c_dev[sim_bsc1[BCM2835_BSC_A/4] & 0x7F];
+
+    sim_i2c_rx_head = 0;
+    sim_i2c_rx_count = 0;
+
+    if (dev == NULL){
+        sim_i2c_status |= BCM2835_BSC_S_ERR;
+        return;
+    }
+
+    if (len > SIM_I2C_BUFFER) len = SIM_I2C_BUFFER;
+    if (dev->read != NULL){
+        dev->read(dev, sim_i2c_rx, len);
+    }else{
+        for (uint32_t i = 0; i < len; i++) sim_i2c_rx[i] = dev->reg[dev->pointer++];
+    }
+    sim_i2c_rx_count = len;
+}
+
+// A write transfer ends once DLEN bytes are in the FIFO
+static void simI2CCheckWrite(){
+    if (sim_i2c_active && (sim_i2c_tx_count >= sim_bsc1[BCM2835_BSC_DLEN/4])){
+        simI2CWrite(sim_i2c_tx, sim_i2c_tx_count);
+        sim_i2c_tx_count = 0;
+        sim_i2c_active = false;
+        sim_i2c_status |= BCM2835_BSC_S_DONE;
+    }
+}
+
+static uint32_t simBSCRead(uint32_t reg){
+    uint32_t value;
+
+    switch (reg){
+        case BCM2835_BSC_S/4:
+            value = sim_i2c_status;
+            if (sim_i2c_active) value |= BCM2835_BSC_S_TA;
+            if (sim_i2c_tx_count < SIM_I2C_BUFFER) value |= BCM2835_BSC_S_TXD;
+            if (sim_i2c_tx_count == 0) value |= BCM2835_BSC_S_TXE;
+            if (sim_i2c_rx_count > 0) value |= BCM2835_BSC_S_RXD;
+            return value;
+
+        case BCM2835_BSC_FIFO/4:
+            if (sim_i2c_rx_count == 0) return 0;
+            sim_i2c_rx_count--;
+            return sim_i2c_rx[sim_i2c_rx_head++];
+    }
+    return sim_bsc1[reg];
+}
+
+static void simBSCWrite(uint32_t reg, uint32_t value){
+    switch (reg){
+        case BCM2835_BSC_C/4:
+            if (value & BCM2835_BSC_C_CLEAR_1){
+                sim_i2c_tx_count = 0;
+                sim_i2c_rx_count = 0;
+            }
+            if ((value & BCM2835_BSC_C_I2CEN) && (value & BCM2835_BSC_C_ST)){
+                if (value & BCM2835_BSC_C_READ){
+                    simI2CRead(sim_bsc1[BCM2835_BSC_DLEN/4]);
+                    sim_i2c_status |= BCM2835_BSC_S_DONE;
+                }else{
+                    sim_i2c_active = true;
+                    simI2CCheckWrite();
+                }
+            }
+            sim_bsc1[reg] = value & ~(BCM2835_BSC_C_ST | BCM2835_BSC_C_CLEAR_1 | BCM2835_BSC_C_CLEAR_2);
+            break;
+
+        case BCM2835_BSC_S/4:
+            // Write 1 to clear
+            sim_i2c_status &= ~(value & (BCM2835_BSC_S_CLKT | BCM2835_BSC_S_ERR | BCM2835_BSC_S_DONE));
+            break;
+
+        case BCM2835_BSC_FIFO/4:
+            if (sim_i2c_tx_count < SIM_I2C_BUFFER) sim_i2c_tx[sim_i2c_tx_count++] = value;
+            simI2CCheckWrite();
+            break;
+
+        default:
+            sim_bsc1[reg] = value;
+            break;
+    }
+}
+
+static uint32_t simSPIRead(uint32_t reg){
+    uint32_t value;
+
+    switch (reg){
+        case BCM2835_SPI0_CS/4:
+            // Every byte is transferred as soon as it is written
+            value = sim_spi0[reg] & ~(BCM2835_SPI0_CS_RXF | BCM2835_SPI0_CS_RXR | BCM2835_SPI0_CS_RXD | BCM2835_SPI0_CS_DONE);
+            value |= BCM2835_SPI0_CS_TXD;
+            if (sim_spi_rx_count > 0) value |= BCM2835_SPI0_CS_RXD;
+            if (sim_spi_rx_count == BCM2835_SPI0_FIFO_SIZE) value |= BCM2835_SPI0_CS_RXF;
+            if (value & BCM2835_SPI0_CS_TA) value |= BCM2835_SPI0_CS_DONE;
+            return value;
+
+        case BCM2835_SPI0_FIFO/4:
+            if (sim_spi_rx_count == 0) return 0;
+            value = sim_spi_rx[sim_spi_rx_head];
+            sim_spi_rx_head = (sim_spi_rx_head + 1) % BCM2835_SPI0_FIFO_SIZE;
+            sim_spi_rx_count--;
+            return value;
+    }
+    return sim_spi0[reg];
+}
+
+static void simSPIWrite(uint32_t reg, uint32_t value){
+    struct SimSPIDevice *dev = sim_spi_dev[sim_spi0[BCM2835_SPI0_CS/4] & BCM2835_SPI0_CS_CS];
+    uint32_t previous;
+    uint8_t miso = 0;
+
+    switch (reg){
+        case BCM2835_SPI0_CS/4:
+            previous = sim_spi0[reg];
+            if (value & BCM2835_SPI0_CS_CLEAR_RX){
+                sim_spi_rx_head = 0;
+                sim_spi_rx_count = 0;
+            }
+            sim_spi0[reg] = value & ~BCM2835_SPI0_CS_CLEAR;
+
+            // The device is selected while TA is set
+            if ((previous ^ value) & BCM2835_SPI0_CS_TA){
+                dev = sim_spi_dev[value & BCM2835_SPI0_CS_CS];
+                if ((dev != NULL) && (dev->select != NULL)) dev->select(dev, (value & BCM2835_SPI0_CS_TA) != 0);
+            }
+            break;
+
+        case BCM2835_SPI0_FIFO/4:
+            if (!(sim_spi0[BCM2835_SPI0_CS/4] & BCM2835_SPI0_CS_TA)) break;
+            if (dev != NULL) miso = dev->transfer(dev, value);
+            if (sim_spi_rx_count < BCM2835_SPI0_FIFO_SIZE){
+                sim_spi_rx[(sim_spi_rx_head + sim_spi_rx_count) % BCM2835_SPI0_FIFO_SIZE] = miso;
+                sim_spi_rx_count++;
+            }
+            break;
+
+        default:
+            sim_spi0[reg] = value;
+            break;
+    }
+}
+
+uint32_t simPeriRead(volatile uint32_t *paddr){
+    const uint32_t *p = (const uint32_t *)paddr;
+    uint32_t value;
+
+    pthread_mutex_lock(&sim_mutex);
+    if ((p >= sim_bsc1) && (p < sim_bsc1 + BLOCK_SIZE/4)) value = simBSCRead(p - sim_bsc1);
+    else if ((p >= sim_spi0) && (p < sim_spi0 + BLOCK_SIZE/4)) value = simSPIRead(p - sim_spi0);
+    else if (p == sim_gpio + 13) value = simGPIOLevels();
+    else value = *paddr;
+    pthread_mutex_unlock(&sim_mutex);
+    return value;
+}
+
+void simPeriWrite(volatile uint32_t *paddr, uint32_t value){
+    uint32_t *p = (uint32_t *)paddr;
+
+    pthread_mutex_lock(&sim_mutex);
+    if ((p >= sim_bsc1) && (p < sim_bsc1 + BLOCK_SIZE/4)){
+        simBSCWrite(p - sim_bsc1, value);
+    }else if ((p >= sim_spi0) && (p < sim_spi0 + BLOCK_SIZE/4)){
+        simSPIWrite(p - sim_spi0, value);
+    }else if (p == sim_gpio + 7){
+        sim_gpio_out |= value;
+    }else if (p == sim_gpio + 10){
+        sim_gpio_out &= ~value;
+    }else{
+        *paddr = value;
+    }
+    pthread_mutex_unlock(&sim_mutex);
+}
+
+
+/*********************************
+ *                               *
+ * Simulated modem               *
+ * ----------------------------- *
+ *********************************/
+
+static const struct SimModemRule sim_default_rules[] = {
+    {"AT", "\r\nOK\r\n", 0},
+    {NULL, NULL, 0}
+};
+
+static const struct SimModemRule *sim_rules = sim_default_rules;
+static int sim_master_fd = -1;
+static int sim_slave_fd = -1;
+static pthread_t sim_modem_thread;
+static pthread_mutex_t sim_modem_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void simModemRules(const struct SimModemRule *rules){
+    pthread_mutex_lock(&sim_modem_mutex);
+    sim_rules = (rules != NULL) ? rules : sim_default_rules;
+    pthread_mutex_unlock(&sim_modem_mutex);
+}
+
+void simModemSend(const char *data){
+    if (sim_master_fd < 0) return;
+
+    pthread_mutex_lock(&sim_modem_mutex);
+    unistd::write(sim_master_fd, data, strlen(data));
+    pthread_mutex_unlock(&sim_modem_mutex);
+}
+
+// Answers a complete line with the first rule it starts with
+static void simModemAnswer(const char *line){
+    const struct SimModemRule *rule;
+    const char *answer = "\r\nERROR\r\n";
+    uint32_t delay_ms = 0;
+
+    pthread_mutex_lock(&sim_modem_mutex);
+    for (rule = sim_rules; rule->command != NULL; rule++){
+        if (strncmp(line, rule->command, strlen(rule->command)) == 0){
+            answer = rule->answer;
+            delay_ms = rule->delay_ms;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sim_modem_mutex);
+
+    if (delay_ms > 0) unistd::usleep(delay_ms * 1000);
+    if (answer != NULL) simModemSend(answer);
+}
+
+/* This is the function that will be running in a thread once the simulated
+ * serial port is used. It reads the lines written to the PTY */
+static void *simModemFunction(void *){
+    char line[SIM_MODEM_LINE];
+    size_t length = 0;
+    char c;
+
+    while (unistd::read(sim_master_fd, &c, 1) == 1){
+        if ((c == '\r') || (c == '\n')){
+            if (length == 0) continue;
+            line[length] = '\0';
+            length = 0;
+            simModemAnswer(line);
+        }else if (length < sizeof(line) - 1){
+            line[length++] = c;
+        }
+    }
+    return NULL;
+}
+
+/* Creates the PTY. The slave side is kept open so the modem keeps reading
+ * while SerialPi is closed, and it is left raw until SerialPi::begin() */
+static int simModemBegin(){
+    struct termios options;
+    char *name;
+
+    if ((sim_master_fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0) return -1;
+    if ((grantpt(sim_master_fd) < 0) || (unlockpt(sim_master_fd) < 0)) return -1;
+    if ((name = ptsname(sim_master_fd)) == NULL) return -1;
+
+    if ((sim_slave_fd = open(name, O_RDWR | O_NOCTTY)) < 0) return -1;
+    tcgetattr(sim_slave_fd, &options);
+    cfmakeraw(&options);
+    tcsetattr(sim_slave_fd, TCSANOW, &options);
+
+    snprintf(sim_tty, sizeof(sim_tty), "%s", name);
+
+    if (pthread_create(&sim_modem_thread, NULL, simModemFunction, NULL) != 0) return -1;
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+*  Copyright (C) 2012 Libelium Comunicaciones Distribuidas S.L.
+*  http://www.libelium.com
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*  Version 2.4 (For Raspberry Pi 2)
+*  Author: Sergio Martinez, Ruben Martin
+*/
+
+#ifndef arduPiBackend_h
+#define arduPiBackend_h
+
+#include "arduPi.h"
+
+/* Hardware backends
+ * The backend is selected with the ARDUPI_BACKEND environment variable before
+ * the program starts. SerialPi, WirePi, SPIPi and the GPIO functions work the
+ * same way on all of them */
+#define ARDUPI_BACKEND_BCM      0 ///< "bcm": BCM2835 registers mapped from /dev/mem (default)
+#define ARDUPI_BACKEND_KERNEL   1 ///< "kernel": /dev/gpiomem, spidev, i2c-dev and the tty driver, root not needed
+#define ARDUPI_BACKEND_SIM      2 ///< "sim": register models in memory and a modem behind a PTY, no Raspberry Pi needed
+
+/* The serial port is /dev/ttyAMA0 unless ARDUPI_TTY names another one. The
+ * simulator ignores ARDUPI_TTY and uses the slave side of its PTY */
+#define ARDUPI_TTY_DEFAULT      "/dev/ttyAMA0"
+
+/// Devices used by the kernel backend
+#define ARDUPI_SPIDEV0          "/dev/spidev0.0"
+#define ARDUPI_SPIDEV1          "/dev/spidev0.1"
+#define ARDUPI_I2CDEV           "/dev/i2c-1"
+
+/// Size of the simulated I2C register files and of the modem line buffer
+#define SIM_I2C_REGISTERS       256
+#define SIM_MODEM_LINE          512
+
+// Selected backend, read from ARDUPI_BACKEND the first time it is needed
+int arduPiBackend();
+// Maps (or simulates) the GPIO, BSC1 and SPI0 blocks, only the first call does it
+void arduPiBackendBegin();
+// Device of SerialPi
+const char *arduPiSerialPort();
+
+/* Kernel backend
+ * The BSC1 and SPI0 blocks are plain memory there, so the register writes of
+ * setDataMode(), chipSelect()... are kept and the transfers read the settings
+ * from them. Return 0 if ok, -1 if the ioctl failed */
+int kernelI2CTransfer(uint8_t address, const char *wbuf, uint32_t wlen, char *rbuf, uint32_t rlen);
+int kernelSPITransfer(volatile uint32_t *regs, bool hold, const uint8_t *tbuf, uint8_t *rbuf, uint32_t len);
+void kernelSPIRelease(volatile uint32_t *regs);
+
+/* Simulator
+ * ch_peri_read*()/ch_peri_write*() hand the accesses to the simulated blocks
+ * to these models while peri_simulated is set */
+extern bool peri_simulated;
+uint32_t simPeriRead(volatile uint32_t *paddr);
+void simPeriWrite(volatile uint32_t *paddr, uint32_t value);
+
+/* Simulated SPI device. transfer() gets every byte sent while its chip select
+ * is asserted and returns the byte received. select() is called when the chip
+ * select changes, it may be NULL */
+struct SimSPIDevice{
+    uint8_t (*transfer)(struct SimSPIDevice *dev, uint8_t mosi);
+    void (*select)(struct SimSPIDevice *dev, bool active);
+    void *arg;
+};
+
+/* Simulated I2C device. write() gets the bytes of a write transfer and
+ * returns 0 (ACK) or 1 (NACK), read() fills the bytes of a read transfer.
+ * With write and read NULL the device is a register file: the first byte
+ * written selects the register and the pointer increments, like the MCP23008 */
+struct SimI2CDevice{
+    uint8_t (*write)(struct SimI2CDevice *dev, const uint8_t *data, uint32_t len);
+    void (*read)(struct SimI2CDevice *dev, uint8_t *data, uint32_t len);
+    uint8_t reg[SIM_I2C_REGISTERS];
+    uint8_t pointer;
+    void *arg;
+};
+
+// Connects a device to a chip select, BCM2835_SPI_CS0, CS1, CS2 or CS_NONE for a GPIO chip select. NULL disconnects it
+void simSPIAttach(uint8_t cs, struct SimSPIDevice *dev);
+// Connects a device to an I2C address, NULL disconnects it. The MCP23008 (0x20) and the ADC (0x08) are register files by default
+void simI2CAttach(uint8_t address, struct SimI2CDevice *dev);
+// Drives a GPIO (BCM number) that is not an output
+void simGPIOInput(int pin, int value);
+
+/* Answer of the simulated modem to the lines starting with command. The
+ * answer is sent delay_ms after the line is received. A table ends with a
+ * NULL command */
+struct SimModemRule{
+    const char *command;
+    const char *answer;
+    uint32_t delay_ms;
+};
+
+// Replaces the rules of the modem, NULL restores the default one: "\r\nOK\r\n" to every line starting with "AT". Lines without a rule get "\r\nERROR\r\n"
+void simModemRules(const struct SimModemRule *rules);
+// Sends unsolicited data from the modem
+void simModemSend(const char *data);
+
+#endif
@@ -26,6 +26,21 @@ else
   fi
 fi 
 
+file="./arduPiBackend.o"
+if [ -e $file ]; then
+  if [ "$1" == "-clean" ]; then
+    echo "arduPiBackend.o -> purged"
+    rm ./arduPiBackend.o
+  else
+    echo "arduPiBackend already compiled"
+  fi
+else 
+  if [ "$1" != "-clean" ]; then
+    echo "Compiling arduPiBackend..."
+    g++ -c arduPiBackend.cpp -o arduPiBackend.o
+  fi
+fi 
+
 #compile arduPi-api
 cd "$ARDUPIAPI_DIR"
 file="./arduPiUART.o"
@@ -73,6 +88,21 @@ else
   fi
 fi 
 
+file="./arduPiFrame.o"
+if [ -e $file ]; then
+  if [ "$1" == "-clean" ]; then
+    echo "arduPiFrame.o -> purged"
+    rm ./arduPiFrame.o
+  else
+	echo "arduPiFrame already compiled"
+  fi
+else 
+  if [ "$1" != "-clean" ]; then
+	echo "Compiling arduPiFrame..."
+    g++ -c arduPiFrame.cpp -o arduPiFrame.o
+  fi
+fi 
+
 #compile library
 cd "$LIBRARY_DIR"
 file="./arduPiLoRa.o"
@@ -110,7 +140,9 @@ if [ "$1" != "-clean" ]; then
       "$ARDUPIAPI_DIR/arduPiUART.o" \
       "$ARDUPIAPI_DIR/arduPiUtils.o" \
       "$ARDUPIAPI_DIR/arduPiMultiprotocol.o" \
+      "$ARDUPIAPI_DIR/arduPiFrame.o" \
       "$ARDUPI_DIR/arduPi.o" \
+      "$ARDUPI_DIR/arduPiBackend.o" \
       -I"$ARDUPI_DIR" \
       -I"$ARDUPIAPI_DIR" \
       -I"$LIBRARY_DIR" \
@@ -34,7 +34,6 @@
 #include <time.h>
 #include <string.h>
 
-#define pgm_read_word(addr) (*(const intptr_t*)(addr))
 
 //! class constructor
 arduPi4G::arduPi4G()
@@ -51,10 +50,12 @@ arduPi4G::arduPi4G()
 // Private Methods ////////////////////////////////////////////////////////////
 
 /*
- * Function: This function parses the error copde returned by the module. At the
+ * Function: This function gets the error code returned by the module. At the
  * point this function is called, the UART is supposed to have received:
- * "+CME ERROR: <err>\r\n" and the first part of the response has been already
- * detected: "+CME ERROR:", so this function needs to parse the error code
+ * "+CME ERROR: <err>\r\n" or "+CMS ERROR: <err>\r\n". The UART receives the
+ * whole error line along with the answer, so the code is normally taken from
+ * the result of the last command. Otherwise the end of the line is waited for
+ * and parsed.
  *
  * If error code is parsed succesfully then the attribute _errorCode stores
  * this error information
@@ -64,7 +65,17 @@ arduPi4G::arduPi4G()
 uint8_t arduPi4G::getErrorCode()
 {
     uint8_t status;
-    char format[20];
+    struct ATResult result = getResult();
+
+    if ((result.cme >= 0) || (result.cms >= 0))
+    {
+        _errorCode = (result.cme >= 0) ? result.cme : result.cms;
+
+        #if DEBUG_ARDUPI4G > 0
+            printErrorCode( _errorCode );
+        #endif
+        return 0;
+    }
 
     // wait for " <err>\r\n"
     status = waitFor((char*)"\r\n", 3000);
@@ -112,7 +123,7 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
     uint32_t previous, max_time;
 
     char command_name[20];
-    char buffer1[40];
+    char buffer1[60];
     char buffer2[20];
     char buffer3[20];
 
@@ -121,9 +132,9 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
     previous = millis();
 
     //// 1. Check if the module has the GPRS connection active
-    strcpy(buffer1, (char*)pgm_read_word(&(table_4G[26]))); // "AT#GPRS?\r"
-    strcpy(buffer2, (char*)pgm_read_word(&(table_4G[27]))); // "GPRS: 1"
-    strcpy(buffer3, (char*)pgm_read_word(&(table_4G[28]))); // "GPRS: 0"
+    strcpy(buffer1, LE910_string_26); // "AT#GPRS?\r"
+    strcpy(buffer2, LE910_string_27); // "GPRS: 1"
+    strcpy(buffer3, LE910_string_28); // "GPRS: 0"
 
     // send command
     answer = sendCommand(buffer1, buffer2, buffer3, 2000);
@@ -136,15 +147,15 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
     }
 
     //// 2. Check Network Registration Report
-    strcpy(buffer1, (char*)pgm_read_word(&(table_4G[0])));    //AT+CREG?\r
-    strcpy(buffer2, (char*)pgm_read_word(&(table_4G[1])));    //+CREG: 0,
+    strcpy(buffer1, LE910_string_00);    //AT+CREG?\r
+    strcpy(buffer2, LE910_string_01);    //+CREG: 0,
     do{
         // Sends the command and waits for the answer (0,1 for home network and 0,5 for roaming)
         answer = sendCommand(buffer1, buffer2, 2000);
 
         if (answer == 1)
         {
-            answer = serialRead(UART0) - 0x30;
+            answer = readByte(100) - 0x30;
         }
         delay(2000);
         // Condition to avoid an overflow (DO NOT REMOVE)
@@ -161,15 +172,15 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
     }
 
     //// 3. Check GPRS Network Registration Status
-    strcpy(buffer1, (char*)pgm_read_word(&(table_4G[2])));    //AT+CGREG?\r
-    strcpy(buffer2, (char*)pgm_read_word(&(table_4G[3])));    //+CGREG: 0,
+    strcpy(buffer1, LE910_string_02);    //AT+CGREG?\r
+    strcpy(buffer2, LE910_string_03);    //+CGREG: 0,
 
     do{
         // Sends the command and waits for the answer (0,1 for home network and 0,5 for roaming)
         answer = sendCommand(buffer1, buffer2, 2000);
         if (answer == 1)
         {
-            answer = serialRead(UART0) - 0x30;
+            answer = readByte(100) - 0x30;
         }
         delay(2000);
         // Condition to avoid an overflow (DO NOT REMOVE)
@@ -183,7 +194,10 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
 
     //// 4. Define PDP Context
     // AT+CGDCONT=1,"IP","<APN>"\r
-    sprintf(buffer1, (char*)pgm_read_word(&(table_4G[29])), _apn); //"AT+CGDCONT=1,\"IP\",\"%s\"\r"
+    if (snprintf(buffer1, sizeof(buffer1), LE910_string_29, _apn) >= (int)sizeof(buffer1)) //"AT+CGDCONT=1,\"IP\",\"%s\"\r"
+    {
+        return 12;
+    }
     answer = sendCommand(buffer1, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
     if (answer != 1)
     {
@@ -192,7 +206,10 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
 
     //// 5. Set Authentication User ID
     // AT#USERID="<login>"\r
-    sprintf(buffer1, (char*)pgm_read_word(&(table_4G[5])), _apn_login);
+    if (snprintf(buffer1, sizeof(buffer1), LE910_string_05, _apn_login) >= (int)sizeof(buffer1))
+    {
+        return 13;
+    }
     answer = sendCommand(buffer1, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
     if (answer != 1)
     {
@@ -201,7 +218,10 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
 
     //// 6. Set Authentication Password
     // AT#PASSW="<pass>"\r
-    sprintf(buffer1, (char*)pgm_read_word(&(table_4G[6])), _apn_password);
+    if (snprintf(buffer1, sizeof(buffer1), LE910_string_06, _apn_password) >= (int)sizeof(buffer1))
+    {
+        return 14;
+    }
     answer = sendCommand(buffer1, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
     if (answer != 1)
     {
@@ -212,8 +232,8 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
     //// 7. GPRS Context Activation
     // "AT#GPRS=1\r"
 
-    strcpy(buffer1, (char*)pgm_read_word(&(table_4G[31]))); // "AT#GPRS=1\r"
-    strcpy(buffer2, (char*)pgm_read_word(&(table_4G[39]))); // "+IP: "
+    strcpy(buffer1, LE910_string_31); // "AT#GPRS=1\r"
+    strcpy(buffer2, LE910_string_39); // "+IP: "
 
     answer = sendCommand(buffer1, buffer2, LE910_ERROR_CODE, LE910_ERROR, 15000);
 
@@ -223,7 +243,7 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
     }
 
     // delimiters <--- "+IP: \"\r\n"
-    strcpy(buffer1, (char*)pgm_read_word(&(table_4G[32])));
+    strcpy(buffer1, LE910_string_32);
 
     // get IP address in response
     answer = parseString(_ip, sizeof(_ip), buffer1);
@@ -238,7 +258,7 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
 
     //// 7. GPRS Context Activation
     // "AT#GPRS=1\r"
-    strcpy(buffer1, (char*)pgm_read_word(&(table_4G[31])));
+    strcpy(buffer1, LE910_string_31);
     answer = sendCommand(buffer1, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 15000);
     if (answer != 1)
     {
@@ -246,7 +266,7 @@ uint8_t arduPi4G::checkDataConnection(uint8_t time)
     }
 
     // delimiters <--- "+IP: \"\r\n"
-    strcpy(buffer1, (char*)pgm_read_word(&(table_4G[32])));
+    strcpy(buffer1, LE910_string_32);
 
     // get IP address in response
     answer = parseString(_ip, sizeof(_ip), buffer1);
@@ -323,12 +343,13 @@ uint8_t arduPi4G::httpRequest(uint8_t method,
     uint8_t answer;
     char command_name[20];
     char command_buffer[500];
-    char aux[3];
-    memset( aux, 0x00, sizeof(aux) );
 
     // Step1: Configure HTTP parameters
     // Generate: AT#HTTPCFG=0,"<url>",<port>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_HTTP[0])), url, port);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_HTTP_00, url, port) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR, LE910_ERROR_CODE, 2000);
@@ -358,7 +379,10 @@ uint8_t arduPi4G::httpRequest(uint8_t method,
         (method == arduPi4G::HTTP_DELETE))
     {
         // AT#HTTPQRY=0,<method>,"<resource>"\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_HTTP[1])), method, resource);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_HTTP_01, method, resource) >= (int)sizeof(command_buffer))
+        {
+            return 2;
+        }
 
         // send command
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR, 5000);
@@ -377,10 +401,13 @@ uint8_t arduPi4G::httpRequest(uint8_t method,
     {
         // 2a. Send HTTP POST or PUT request
         // AT#HTTPSND=0,<method>,"<resource>",<data_length>
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_HTTP[2])),
-                method - 3,
-                resource,
-                length);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_HTTP_02,
+                    method - 3,
+                    resource,
+                    length) >= (int)sizeof(command_buffer))
+        {
+            return 2;
+        }
 
         // send command
         answer = sendCommand(command_buffer, LE910_DATA_TO_MODULE, LE910_ERROR, 5000);
@@ -404,13 +431,16 @@ uint8_t arduPi4G::httpRequest(uint8_t method,
 
         // 2a. Perform the request
         // "/getpost_frame_parser.php"
-        strcpy(php_file, (char*)pgm_read_word(&(table_HTTP[5])));
+        strcpy(php_file, LE910_HTTP_05);
 
         // AT#HTTPSND=0,0,"<php_file>",<data_length>
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_HTTP[2])),
-                0,
-                php_file,
-                6 + (length * 2));
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_HTTP_02,
+                    0,
+                    php_file,
+                    6 + (length * 2)) >= (int)sizeof(command_buffer))
+        {
+            return 2;
+        }
 
         answer = sendCommand(command_buffer, LE910_DATA_TO_MODULE, LE910_ERROR, 5000);
         if (answer != 1)
@@ -419,16 +449,22 @@ uint8_t arduPi4G::httpRequest(uint8_t method,
         }
 
         // Add "frame="
-        strcpy(command_buffer, (char*)pgm_read_word(&(table_HTTP[6])));
+        strcpy(command_buffer, LE910_HTTP_06);
         printString(command_buffer, UART0);
 
         // Add frame contents in ASCII representation: 3C3D3E...
-        for(uint16_t x = 0; x < length; x++)
+        // The frame is converted in blocks that fit in 'command_buffer'
+        for(uint16_t x = 0; x < length; )
         {
-            // make conversion from byte to hex representation in ASCII (2Bytes)
-            Utils.hex2str((uint8_t*)&data[x], aux, 1);
-            printByte(aux[0], UART0);
-            printByte(aux[1], UART0);
+            uint16_t block = length - x;
+            if (block > (sizeof(command_buffer) - 1) / 2)
+            {
+                block = (sizeof(command_buffer) - 1) / 2;
+            }
+
+            Utils.hexEncode(&data[x], block, command_buffer, sizeof(command_buffer));
+            printString(command_buffer, UART0);
+            x += block;
         }
 
 
@@ -459,13 +495,13 @@ uint8_t arduPi4G::httpRequest(uint8_t method,
  */
 uint8_t arduPi4G::httpWaitResponse(uint32_t wait_timeout)
 {
-    char *pointer;
     uint8_t answer;
     uint16_t data_size;
+    uint32_t size;
     char command_buffer[50];
 
     // 1. Wait URC: "#HTTPRING: 0,"
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_HTTP[3])));
+    strcpy(command_buffer, LE910_HTTP_03);
 
     answer = waitFor(command_buffer, wait_timeout);
     if (answer == 0)
@@ -480,42 +516,32 @@ uint8_t arduPi4G::httpWaitResponse(uint32_t wait_timeout)
         return 2;
     }
 
-    // 3. Read <http_status_code>
-    pointer = strtok((char*)_buffer, ",");
+    // 3. Read <http_status_code> and store it in attribute
+    arduPiParser parser(_buffer, _length, ",\r");
 
-    if (pointer == NULL)
+    if (parser.getInt(&_httpCode) != 0)
     {
         return 3;
     }
-    else
-    {
-        // Store the HTTP code in attribute
-        _httpCode = atoi(pointer);
-    }
-
 
     // 4. Skip <content_type>
-    strtok(NULL, ",");
-
+    parser.skip(1);
 
     // 5. Read <data_size>
-    pointer = strtok((char*)_buffer, ",");
-
-    if (pointer == NULL)
+    if (parser.getUint32(&size) != 0)
     {
         return 5;
     }
-    else
-    {
-        // Store the HTTP code in attribute
-        data_size = atoi(pointer);
-    }
+    data_size = size;
 
     // 6. Read data received
     if (data_size > 0)
     {
         // AT#HTTPRCV=0,0\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_HTTP[4])), 0, 0);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_HTTP_04, 0, 0) >= (int)sizeof(command_buffer))
+        {
+            return 4;
+        }
 
         // send command
         answer = sendCommand(command_buffer, LE910_DATA_FROM_MODULE, LE910_ERROR, 2000);
@@ -567,7 +593,10 @@ uint8_t arduPi4G::ftpFileSize( char* ftp_file)
 
     // AT#FTPFSIZE=<ftp_file>\r
     memset(command_buffer,0x00,sizeof(command_buffer));
-    sprintf(command_buffer,(char*)pgm_read_word(&(table_FTP[5])),ftp_file);
+    if (snprintf(command_buffer, sizeof(command_buffer),LE910_FTP_05,ftp_file) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 15000);
@@ -616,6 +645,7 @@ uint8_t arduPi4G::ftpFileSize( char* ftp_file)
  */
 uint8_t arduPi4G::getSocketStatus(uint8_t socketId)
 {
+    char* saveptr;
     uint8_t answer;
     char delimiters[20];
     char command_name[20];
@@ -631,7 +661,10 @@ uint8_t arduPi4G::getSocketStatus(uint8_t socketId)
     memset(socketStatus[socketId].remoteIp, 0x00, sizeof(socketStatus[socketId].remoteIp));
 
     // AT#SS=<socketId>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[0])), socketId+1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_00, socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -660,7 +693,7 @@ uint8_t arduPi4G::getSocketStatus(uint8_t socketId)
     #endif
 
     // delimiters <-- "#SS: "
-    strcpy(delimiters, (char*)pgm_read_word(&(table_IP[20])));
+    strcpy(delimiters, LE910_IP_SOCKET_20);
 
     // seek pattern in module response
     // the response is something similar to this:
@@ -677,10 +710,10 @@ uint8_t arduPi4G::getSocketStatus(uint8_t socketId)
     }
 
     // delimiters <-- "#SS: ,\r\n"
-    strcpy(delimiters, (char*)pgm_read_word(&(table_IP[21])));
+    strcpy(delimiters, LE910_IP_SOCKET_21);
 
     // find first value skipping delimiters
-    pointer = strtok(pointer, delimiters);
+    pointer = strtok_r(pointer, delimiters, &saveptr);
 
     // iterate through response
     for (int i = 0; i < 6; i++)
@@ -725,7 +758,7 @@ uint8_t arduPi4G::getSocketStatus(uint8_t socketId)
             break;
         }
 
-        pointer = strtok (NULL, " ,\r\n");
+        pointer = strtok_r(NULL, " ,\r\n", &saveptr);
     }
 
     #if DEBUG_ARDUPI4G > 1
@@ -752,6 +785,7 @@ uint8_t arduPi4G::getSocketStatus(uint8_t socketId)
  */
 uint8_t arduPi4G::getAllSocketStatus()
 {
+    char* saveptr;
     uint8_t answer;
     char command_pattern[20];
     char command_buffer[20];
@@ -761,7 +795,7 @@ uint8_t arduPi4G::getAllSocketStatus()
     memset(socketStatus, 0x00, sizeof(socketStatus));
 
     // "AT#SS\r"
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[31])));
+    strcpy(command_buffer, LE910_IP_SOCKET_31);
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -792,16 +826,19 @@ uint8_t arduPi4G::getAllSocketStatus()
     for (int profile = 0; profile < 6; profile++)
     {
         // "#SS: %u,"
-        sprintf(command_pattern, (char*)pgm_read_word(&(table_IP[32])), profile+1);
+        if (snprintf(command_pattern, sizeof(command_pattern), LE910_IP_SOCKET_32, profile+1) >= (int)sizeof(command_pattern))
+        {
+            return 1;
+        }
 
         // seek start of correct index
         pointer = strstr((char*)_buffer, command_pattern);
 
         // delimiters <-- "#SS: ,\r\n"
-        strcpy(command_pattern, (char*)pgm_read_word(&(table_IP[21])));
+        strcpy(command_pattern, LE910_IP_SOCKET_21);
 
         // find first value skipping delimiters
-        pointer = strtok(pointer, command_pattern);
+        pointer = strtok_r(pointer, command_pattern, &saveptr);
 
         // iterate through response
         for (int i = 0; i < 6; i++)
@@ -846,7 +883,7 @@ uint8_t arduPi4G::getAllSocketStatus()
                 break;
             }
 
-            pointer = strtok (NULL, " ,\r\n");
+            pointer = strtok_r(NULL, " ,\r\n", &saveptr);
         }
     }
 
@@ -877,6 +914,7 @@ uint8_t arduPi4G::getAllSocketStatus()
  */
 uint8_t arduPi4G::getSocketStatusSSL(uint8_t socketId)
 {
+    char* saveptr;
     uint8_t answer;
     char delimiters[20];
     char command_name[20];
@@ -888,7 +926,10 @@ uint8_t arduPi4G::getSocketStatusSSL(uint8_t socketId)
     socketStatusSSL[socketId].state = 0;
 
     // AT#SSLS=<socketId>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[13])), socketId+1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_13, socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -912,7 +953,7 @@ uint8_t arduPi4G::getSocketStatusSSL(uint8_t socketId)
     }
 
     // delimiters <-- "#SSLS: "
-    strcpy(delimiters, (char*)pgm_read_word(&(table_IP[22])));
+    strcpy(delimiters, LE910_IP_SOCKET_22);
 
     // seek pattern in module response
     // the response is something similar to this:
@@ -928,10 +969,10 @@ uint8_t arduPi4G::getSocketStatusSSL(uint8_t socketId)
     }
 
     // delimiters <-- "#SSLS: ,\r\n"
-    strcpy(delimiters, (char*)pgm_read_word(&(table_IP[23])));
+    strcpy(delimiters, LE910_IP_SOCKET_23);
 
     // find first value skipping delimiters
-    pointer = strtok(pointer, delimiters);
+    pointer = strtok_r(pointer, delimiters, &saveptr);
 
     // iterate through response
     for (int i = 0; i < 2; i++)
@@ -954,7 +995,7 @@ uint8_t arduPi4G::getSocketStatusSSL(uint8_t socketId)
             break;
         }
 
-        pointer = strtok (NULL, " ,\r\n");
+        pointer = strtok_r(NULL, " ,\r\n", &saveptr);
     }
 
     #if DEBUG_ARDUPI4G > 1
@@ -981,6 +1022,7 @@ uint8_t arduPi4G::getSocketStatusSSL(uint8_t socketId)
  */
 uint8_t arduPi4G::getSocketInfo(uint8_t socketId)
 {
+    char* saveptr;
     uint8_t answer;
     char delimiters[20];
     char command_name[20];
@@ -995,7 +1037,10 @@ uint8_t arduPi4G::getSocketInfo(uint8_t socketId)
     socketInfo[socketId].ack = 0;
 
     // AT#SI=<socketId>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[1])), socketId+1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_01, socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -1011,7 +1056,7 @@ uint8_t arduPi4G::getSocketInfo(uint8_t socketId)
     }
 
     // delimiters <-- #SI: "
-    strcpy(delimiters, (char*)pgm_read_word(&(table_IP[24])));
+    strcpy(delimiters, LE910_IP_SOCKET_24);
 
     // seek pattern in module response
     // the reponse is something similar to this:
@@ -1024,10 +1069,10 @@ uint8_t arduPi4G::getSocketInfo(uint8_t socketId)
     }
 
     // delimiters <-- "#SI: ,\r\n"
-    strcpy(delimiters, (char*)pgm_read_word(&(table_IP[25])));
+    strcpy(delimiters, LE910_IP_SOCKET_25);
 
     // find first value skipping delimiters
-    pointer = strtok(pointer, delimiters);
+    pointer = strtok_r(pointer, delimiters, &saveptr);
 
     // iterate through response
     for (int i = 0; i < 5; i++)
@@ -1059,7 +1104,7 @@ uint8_t arduPi4G::getSocketInfo(uint8_t socketId)
             break;
         }
 
-        pointer = strtok (NULL, " ,\r\n");
+        pointer = strtok_r(NULL, " ,\r\n", &saveptr);
     }
 
     #if DEBUG_ARDUPI4G > 1
@@ -1150,7 +1195,7 @@ uint8_t arduPi4G::ON()
     // Set Report Mobile Equipment Error (CMEE)
     counter = 3;
     answer = 0;
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[19])));    //AT+CMEE=1\r
+    strcpy(command_buffer, LE910_string_19);    //AT+CMEE=1\r
     while ((counter > 0) && (answer == 0))
     {
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR, 500);
@@ -1167,7 +1212,7 @@ uint8_t arduPi4G::ON()
     // Disable command echo
     counter = 3;
     answer = 0;
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[20])));    //ATE0\r
+    strcpy(command_buffer, LE910_string_20);    //ATE0\r
     while ((counter > 0) && (answer == 0))
     {
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR, 500);
@@ -1185,7 +1230,7 @@ uint8_t arduPi4G::ON()
 /*
     counter = 3;
     answer = 0;
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[21])));    //AT#NITZ=7\r
+    strcpy(command_buffer, LE910_string_21);    //AT#NITZ=7\r
     while ((counter > 0) && (answer == 0))
     {
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR, 500);
@@ -1242,7 +1287,7 @@ void arduPi4G::OFF()
         // Software Shutdown
         counter = 4;
         answer = 0;
-        strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[38])));    //AT#SHDN\r
+        strcpy(command_buffer, LE910_string_38);    //AT#SHDN\r
         while ((counter > 0) && (answer == 0))
         {
              answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR, 1000);
@@ -1303,12 +1348,18 @@ uint8_t arduPi4G::enterPIN(char* code, char* new_code)
     if (new_code == NULL)
     {
         // AT+CPIN="<code>"\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_PIN[18])), code);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_PIN_18, code) >= (int)sizeof(command_buffer))
+        {
+            return 1;
+        }
     }
     else
     {
         // AT+CPIN="<code>","<new_code>"\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_PIN[19])), code, new_code);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_PIN_19, code, new_code) >= (int)sizeof(command_buffer))
+        {
+            return 1;
+        }
     }
 
     // send command
@@ -1357,7 +1408,7 @@ uint8_t arduPi4G::checkPIN()
     uint8_t answer;
 
     // command: AT+CPIN?\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_PIN[0])));
+    strcpy(command_buffer, LE910_PIN_00);
 
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
     if (answer != 1)
@@ -1372,7 +1423,7 @@ uint8_t arduPi4G::checkPIN()
     // Seeks a code
     for (int x = 0; x < 17; x++ )
     {
-        strcpy(command_answer, (char*)pgm_read_word(&(table_PIN[x+1])));
+        strcpy(command_answer, table_PIN[x+1]);
         answer = find( _buffer, _length, command_answer);
         if (answer == 1)
         {
@@ -1406,8 +1457,8 @@ uint8_t arduPi4G::checkConnection(uint8_t time)
     max_time = (unsigned long)time * 1000;
     previous = millis();
 
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[0])));     //AT+CREG?\r
-    strcpy(command_answer, (char*)pgm_read_word(&(table_4G[1])));     //+CREG: 0,
+    strcpy(command_buffer, LE910_string_00);     //AT+CREG?\r
+    strcpy(command_answer, LE910_string_01);     //+CREG: 0,
 
     do{
         // Sends the command and waits for the answer (0,1 for home network and 0,5 for roaming)
@@ -1469,11 +1520,11 @@ uint8_t arduPi4G::checkConnectionEPS(uint8_t time)
 
     //// 1. Generate command
     // "AT+CEREG?\r"
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[44])));
+    strcpy(command_buffer, LE910_string_44);
 
     //// 2. Generate answer
     // "+CEREG: 0,"
-    strcpy(command_answer, (char*)pgm_read_word(&(table_4G[45])));
+    strcpy(command_answer, LE910_string_45);
 
     //// 3. Iterate until status is correct
     while ((status != 1) && (status != 5))
@@ -1574,10 +1625,10 @@ uint8_t arduPi4G::manageIncomingData(unsigned long wait_time)
     _incomingType = 0;
 
     // "+CMTI"
-    strcpy(sms_incoming, (char*)pgm_read_word(&(table_4G[22])));
+    strcpy(sms_incoming, LE910_string_22);
 
     // "SRING: "
-    strcpy(IP_incoming, (char*)pgm_read_word(&(table_4G[23])));
+    strcpy(IP_incoming, LE910_string_23);
 
     // Wait for data
     answer = waitFor(sms_incoming, IP_incoming, wait_time);
@@ -1660,7 +1711,10 @@ uint8_t arduPi4G::manageIncomingData(unsigned long wait_time)
             {
                 // accept connection in command mode
                 // AT#SA=<socketId>,1\r
-                sprintf(command_buffer, (char*)pgm_read_word(&(table_4G[37])), _socketIndex+1);
+                if (snprintf(command_buffer, sizeof(command_buffer), LE910_string_37, _socketIndex+1) >= (int)sizeof(command_buffer))
+                {
+                    return 1;
+                }
 
                 // send command
                 answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -1775,7 +1829,10 @@ uint8_t arduPi4G::manageSockets(unsigned long wait_time)
         {
             // accept connection in command mode
             // AT#SA=<socketId>,1\r
-            sprintf(command_buffer, (char*)pgm_read_word(&(table_4G[37])), profile+1);
+            if (snprintf(command_buffer, sizeof(command_buffer), LE910_string_37, profile+1) >= (int)sizeof(command_buffer))
+            {
+                return 1;
+            }
 
             // send command
             answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -1840,7 +1897,7 @@ uint8_t arduPi4G::configureSMS()
 
     // 1. Configure format, storage and indication parameters
     memset(command_buffer,0x00,sizeof(command_buffer));
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_SMS[0])));   //AT+CMGF=1
+    strcpy(command_buffer, LE910_SMS_00);   //AT+CMGF=1
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR,1000);
     if (answer != 1)
     {
@@ -1851,7 +1908,7 @@ uint8_t arduPi4G::configureSMS()
     }
 
     memset(command_buffer,0x00,sizeof(command_buffer));
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_SMS[1])));   //AT+CPMS="SM","SM","SM"
+    strcpy(command_buffer, LE910_SMS_01);   //AT+CPMS="SM","SM","SM"
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR,1000);
     if (answer != 1)
     {
@@ -1862,7 +1919,7 @@ uint8_t arduPi4G::configureSMS()
     }
 
     memset(command_buffer,0x00,sizeof(command_buffer));
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_SMS[2])));   //AT+CNMI=2,1,0,0,0
+    strcpy(command_buffer, LE910_SMS_02);   //AT+CNMI=2,1,0,0,0
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR,1000);
     if (answer != 1)
     {
@@ -1907,7 +1964,10 @@ uint8_t arduPi4G::sendSMS(char* phone_number, char* sms_string)
     #endif
 
     // AT+CMGS="<phone_number>"
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_SMS[4])), phone_number);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_SMS_04, phone_number) >= (int)sizeof(command_buffer))
+    {
+        return 5;
+    }
 
     // send command
     answer = sendCommand(command_buffer, (char*)">");
@@ -1951,6 +2011,7 @@ uint8_t arduPi4G::readNewSMS()
  */
 uint8_t arduPi4G::readNewSMS(uint32_t timeout)
 {   
+    char* saveptr;
     uint8_t answer;
     char command_buffer[50];
     char command_answer[10];
@@ -1970,11 +2031,11 @@ uint8_t arduPi4G::readNewSMS(uint32_t timeout)
     //// 3. Read unread message
     // AT+CMGL="REC UNREAD"\r
     memset(command_buffer, 0x00, sizeof(command_buffer));
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[36])));
+    strcpy(command_buffer, LE910_string_36);
     
     // "+CMGL: "
     memset(command_answer, 0x00, sizeof(command_answer));
-    sprintf(command_answer, (char*)pgm_read_word(&(table_4G[42])));
+    strcpy(command_answer, LE910_string_42);
     
     // get current time
     previous = millis();
@@ -1992,7 +2053,7 @@ uint8_t arduPi4G::readNewSMS(uint32_t timeout)
 
             // _buffer stores a response like:
             //  19,"REC UNREAD","+345901000118833","","16/06/20,12:20:20+08"    
-            pointer = strtok((char*)_buffer,"\",");
+            pointer = strtok_r((char*)_buffer,"\",", &saveptr);
             
             for (int i = 0; i < 5; i++) 
             {   
@@ -2026,7 +2087,7 @@ uint8_t arduPi4G::readNewSMS(uint32_t timeout)
                     strncpy(_smsTime, pointer, sizeof(_smsTime));       
                 }
                 
-                pointer = strtok(NULL, "\",");  
+                pointer = strtok_r(NULL, "\",", &saveptr);  
             }
             
             // Get body
@@ -2076,6 +2137,7 @@ uint8_t arduPi4G::readNewSMS(uint32_t timeout)
 */
 uint8_t arduPi4G::readSMS(uint8_t sms_index)
 {   
+    char* saveptr;
     char command_buffer[40];
     char command_answer[15];
     uint8_t answer;
@@ -2087,12 +2149,15 @@ uint8_t arduPi4G::readSMS(uint8_t sms_index)
         
     //// 1. Generate command request
     // AT+CMGR=<sms_index>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_SMS[3])), sms_index);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_SMS_03, sms_index) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
     
     //// 2. Generate expected answer
     // +CMGR: 
     memset(command_answer, 0x00, sizeof(command_answer));
-    sprintf(command_answer,(char*)pgm_read_word(&(table_4G[43])));
+    strcpy(command_answer, LE910_string_43);
 
     // send command
     answer = sendCommand(command_buffer, command_answer, LE910_ERROR_CODE, LE910_ERROR, LE910_OK, 5000);
@@ -2113,7 +2178,7 @@ uint8_t arduPi4G::readSMS(uint8_t sms_index)
     // _buffer stores a response like:
     //  "REC READ","+34666666666","","16/06/20,10:12:34+08"
     
-    pointer = strtok((char*)_buffer,"\",");
+    pointer = strtok_r((char*)_buffer,"\",", &saveptr);
     
     for (int i = 0; i < 4; i++) 
     {   
@@ -2140,7 +2205,7 @@ uint8_t arduPi4G::readSMS(uint8_t sms_index)
             strncpy(_smsTime, pointer, sizeof(_smsTime));       
         }
         
-        pointer = strtok(NULL, "\",");  
+        pointer = strtok_r(NULL, "\",", &saveptr);  
     }
     
     // Get body
@@ -2190,7 +2255,10 @@ uint8_t arduPi4G::deleteSMS(uint8_t sms_index, uint8_t del_flag)
     #endif
 
     // AT+CMGD=<sms_index>,<del_flag>\r
-    sprintf(command_buffer,(char*)pgm_read_word(&(table_SMS[6])), sms_index, del_flag);
+    if (snprintf(command_buffer, sizeof(command_buffer),LE910_SMS_06, sms_index, del_flag) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
@@ -2368,11 +2436,14 @@ uint8_t arduPi4G::ftpOpenSession(char* server,
 
     // 2. Configure FTP parameters and open the connection
     // AT#FTPOPEN="<server>:<port>","<username>","<password>",1\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_FTP[0])),
-            server,
-            port,
-            username,
-            password);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_FTP_00,
+                server,
+                port,
+                username,
+                password) >= (int)sizeof(command_buffer))
+    {
+        return 16;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, LE910_FTP_CONF_TIMEOUT);
@@ -2391,7 +2462,7 @@ uint8_t arduPi4G::ftpOpenSession(char* server,
 
     // 3. Set binary transfer. Once connected we can call the AT#FTPTYPE command
     // AT#FTPTYPE=0\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_FTP[4])));
+    strcpy(command_buffer, LE910_FTP_04);
 
     // mandatory delay
     delay(2000);
@@ -2433,7 +2504,7 @@ uint8_t arduPi4G::ftpCloseSession()
     delay(1000);
 
     //AT#FTPCLOSE\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_FTP[1])));
+    strcpy(command_buffer, LE910_FTP_01);
 
     counter = 4;
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 10000);
@@ -2529,7 +2600,10 @@ uint8_t arduPi4G::ftpUpload( char* ftp_file, char* sd_file)
 
     // 5. Open the PUT connection
     // AT#FTPPUT=<ftp_file>,0\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_FTP[2])), ftp_file);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_FTP_02, ftp_file) >= (int)sizeof(command_buffer))
+    {
+        return 6;
+    }
 
     // send command
     answer = sendCommand(command_buffer, (char *)"CONNECT", (char *)"NO CARRIER", 15000);
@@ -2583,9 +2657,9 @@ uint8_t arduPi4G::ftpUpload( char* ftp_file, char* sd_file)
     delay(2000);
 
     // "+++"
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_FTP[11])));
+    strcpy(command_buffer, LE910_FTP_11);
     // "NO CARRIER"
-    strcpy(command_answer, (char*)pgm_read_word(&(table_FTP[12])));
+    strcpy(command_answer, LE910_FTP_12);
 
     counter = 3;
     answer = 0;
@@ -2693,7 +2767,10 @@ uint8_t arduPi4G::ftpDownload( char* sd_file, char* ftp_file)
     /// 3. Open the GET connection
     // AT#FTPGETPKT="<ftp_file>"\r
     memset(command_buffer,0x00,sizeof(command_buffer));
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_FTP[3])),ftp_file);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_FTP_03,ftp_file) >= (int)sizeof(command_buffer))
+    {
+        return 6;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, LE910_FTP_TIMEOUT);
@@ -2711,7 +2788,7 @@ uint8_t arduPi4G::ftpDownload( char* sd_file, char* ftp_file)
         return 6;
     }
 
-    // calculate delay for retrieving packets depending on file size
+    // calculate the gap between packet requests depending on file size
     uint32_t delay_ms;
 
     if (_filesize > 50000)
@@ -2731,7 +2808,7 @@ uint8_t arduPi4G::ftpDownload( char* sd_file, char* ftp_file)
     delay(1000);
 
     // "#FTPRECV: "
-    sprintf(command_answer, (char*)pgm_read_word(&(table_FTP[13])));
+    strcpy(command_answer, LE910_FTP_13);
 
     /// 4. Read data from the module
     while ((server_filesize > 0) && (error_counter > 0))
@@ -2748,7 +2825,10 @@ uint8_t arduPi4G::ftpDownload( char* sd_file, char* ftp_file)
         //// 6b Request data
         // AT#FTPRECV=<packet_size>\r
         memset(command_buffer, 0x00, sizeof(command_buffer));
-        sprintf(command_buffer,(char*)pgm_read_word(&(table_FTP[6])),packet_size);
+        if (snprintf(command_buffer, sizeof(command_buffer),LE910_FTP_06,packet_size) >= (int)sizeof(command_buffer))
+        {
+            return 7;
+        }
 
         // send command
         answer = sendCommand(command_buffer, command_answer, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -3049,11 +3129,14 @@ uint8_t arduPi4G::openSocketClient(uint8_t socketId,
     #endif
 
     // AT#SCFGEXT=<socketId>,0,0,<keep_alive>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[3])),
-                socketId+1,
-                0,
-                0,
-                keep_alive);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_03,
+                    socketId+1,
+                    0,
+                    0,
+                    keep_alive) >= (int)sizeof(command_buffer))
+    {
+        return 22;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
@@ -3075,7 +3158,10 @@ uint8_t arduPi4G::openSocketClient(uint8_t socketId,
 
     //// 4. Socket Configuration Extended 3
     // AT#SCFGEXT3=<socketId>,1\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[5])), socketId+1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_05, socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 23;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
@@ -3106,12 +3192,15 @@ uint8_t arduPi4G::openSocketClient(uint8_t socketId,
 
     // AT#SD=<socketId>,<protocol>,<remote_port>,"<remote_IP>",0,<local_port>,1\r
     // AT#SD=1,0,15010,"intranet.libelium.com",0,4000,1
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[6])), //"AT#SD=%u,%d,%u,\"%s\",0,%u,1\r"
-            socketId+1,
-            protocol,
-            remote_port,
-            remote_IP,
-            local_port);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_06, //"AT#SD=%u,%d,%u,\"%s\",0,%u,1\r"
+                socketId+1,
+                protocol,
+                remote_port,
+                remote_IP,
+                local_port) >= (int)sizeof(command_buffer))
+    {
+        return 24;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -3221,11 +3310,14 @@ uint8_t arduPi4G::openSocketServer(uint8_t socketId,
     #endif
     
     // AT#SCFGEXT=<socketId>,0,0,<keep_alive>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[3])), 
-            socketId+1, 
-            0,
-            0,
-            keep_alive);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_03, 
+                socketId+1, 
+                0,
+                0,
+                keep_alive) >= (int)sizeof(command_buffer))
+    {
+        return 22;
+    }
     
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
@@ -3253,19 +3345,25 @@ uint8_t arduPi4G::openSocketServer(uint8_t socketId,
     if (protocol == arduPi4G::TCP)
     {
         // AT#SL=<socketId>,1,<local_port>,255\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[29])), 
-                socketId+1,
-                1,
-                local_port,
-                255);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_29, 
+                    socketId+1,
+                    1,
+                    local_port,
+                    255) >= (int)sizeof(command_buffer))
+        {
+            return 23;
+        }
     }
     else if (protocol == arduPi4G::UDP)
     {
         // AT#SLUDP=<socketId>,1,<local_port>\r     
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[30])), 
-                socketId+1,
-                1,
-                local_port);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_30, 
+                    socketId+1,
+                    1,
+                    local_port) >= (int)sizeof(command_buffer))
+        {
+            return 23;
+        }
     }
     else
     {
@@ -3352,7 +3450,10 @@ uint8_t arduPi4G::openSocketSSL(uint8_t socketId,
         
     //// 1. Enable a SSL socket
     // "AT#SSLEN=<socketId>,1\r"
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[33])), socketId+1, 1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_33, 1) >= (int)sizeof(command_buffer))
+    {
+        return 27;
+    }
     
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -3401,10 +3502,13 @@ uint8_t arduPi4G::openSocketSSL(uint8_t socketId,
     
     //// 4. Socket Dial
     // AT#SSLD=1,<remote_port>,"<remote_IP>",0,1\r
-    sprintf(command_buffer, 
-            (char*)pgm_read_word(&(table_IP[12])),
-            remote_port,
-            remote_IP);
+    if (snprintf(command_buffer, sizeof(command_buffer), 
+                LE910_IP_SOCKET_12,
+                remote_port,
+                remote_IP) >= (int)sizeof(command_buffer))
+    {
+        return 26;
+    }
     
     // send command 
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 15000);
@@ -3465,7 +3569,7 @@ uint8_t arduPi4G::closeSocketClient(uint8_t socketId)
 {
     uint8_t answer;
     char command_name[10];
-    char command_buffer[10];
+    char command_buffer[50];
 
     //// 1. Check socket status
     answer = getSocketStatus(socketId);
@@ -3480,7 +3584,10 @@ uint8_t arduPi4G::closeSocketClient(uint8_t socketId)
 
     //// 2. Configure connection
     // AT#SH=<socketId>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[7])), socketId+1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_07, socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -3542,7 +3649,7 @@ uint8_t arduPi4G::closeSocketClient(uint8_t socketId)
 uint8_t arduPi4G::closeSocketServer(uint8_t socketId, uint8_t protocol)
 {
     uint8_t answer;
-    char command_buffer[10];
+    char command_buffer[50];
                 
     //// 1. Check socket status 
     answer = getSocketStatus(socketId);
@@ -3560,19 +3667,25 @@ uint8_t arduPi4G::closeSocketServer(uint8_t socketId, uint8_t protocol)
     if (protocol == arduPi4G::TCP)
     {
         // AT#SL=<socketId>,0,<local_port>,255\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[29])), 
-                socketId+1,
-                0,
-                socketStatus[socketId].localPort,
-                255);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_29, 
+                    socketId+1,
+                    0,
+                    socketStatus[socketId].localPort,
+                    255) >= (int)sizeof(command_buffer))
+        {
+            return 1;
+        }
     }
     else if (protocol == arduPi4G::UDP)
     {
         // AT#SLUDP=<socketId>,0,<local_port>\r     
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[30])), 
-                socketId+1,
-                0,
-                socketStatus[socketId].localPort);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_30, 
+                    socketId+1,
+                    0,
+                    socketStatus[socketId].localPort) >= (int)sizeof(command_buffer))
+        {
+            return 1;
+        }
     }
     else
     {
@@ -3598,7 +3711,10 @@ uint8_t arduPi4G::closeSocketServer(uint8_t socketId, uint8_t protocol)
     
     //// 3. Configure connection    
     // AT#SH=<socketId>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[7])), socketId+1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_07, socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -3661,7 +3777,7 @@ uint8_t arduPi4G::closeSocketSSL(uint8_t socketId)
 {
     uint8_t answer, counter;
     char command_name[10];
-    char command_buffer[10];
+    char command_buffer[50];
 
     //// 1. Check socket status
     answer = getSocketStatusSSL(socketId);
@@ -3676,7 +3792,10 @@ uint8_t arduPi4G::closeSocketSSL(uint8_t socketId)
 
     //// 2. Configure connection
     // AT#SSLH=<socketId>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[19])), socketId+1);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_19, socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     counter = 3;
@@ -3726,9 +3845,12 @@ uint8_t arduPi4G::closeSocketSSL(uint8_t socketId)
 
             //// 4. disable SSL channel
             // AT#SSLEN=<SSId>, <Enable>\r
-            sprintf( command_buffer,
-                     (char*)pgm_read_word(&(table_IP[33])),
-                     0); // Disable
+            if (snprintf(command_buffer, sizeof(command_buffer),
+                         LE910_IP_SOCKET_33,
+                         0) >= (int)sizeof(command_buffer)) // Disable
+            {
+                return 1;
+            }
 
             // send command
             answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -3810,10 +3932,13 @@ uint8_t arduPi4G::send(uint8_t socketId,
 
     //// 2. Send data
     // AT#SSENDEXT=<socketId>,<data_length>\r
-    sprintf(command_buffer,
-            (char*)pgm_read_word(&(table_IP[8])),
-            socketId+1,
-            data_length);
+    if (snprintf(command_buffer, sizeof(command_buffer),
+                LE910_IP_SOCKET_08,
+                socketId+1,
+                data_length) >= (int)sizeof(command_buffer))
+    {
+        return 3;
+    }
 
     // send command
     answer = sendCommand(command_buffer, (char*)">", LE910_ERROR_CODE, LE910_ERROR);
@@ -3931,10 +4056,12 @@ uint8_t arduPi4G::sendSSL(uint8_t socketId,
 
     //// 2. Send data
     // AT#SSLSEND=<socketId>\r
-    sprintf(command_buffer,
-            (char*)pgm_read_word(&(table_IP[14])),
-            socketId+1,
-            data_length);
+    if (snprintf(command_buffer, sizeof(command_buffer),
+                LE910_IP_SOCKET_14,
+                socketId+1) >= (int)sizeof(command_buffer))
+    {
+        return 3;
+    }
 
     // send command
     answer = sendCommand(command_buffer, (char*)">", LE910_ERROR_CODE, LE910_ERROR);
@@ -4077,13 +4204,19 @@ uint8_t arduPi4G::receive(uint8_t socketId, uint32_t timeout)
     //// 2. Send command to read received data and save it
     // generate the expected response
     // AT#SRECV: <socketId>,
-    sprintf(command_answer,(char*)pgm_read_word(&(table_IP[9])), socketId+1);
+    if (snprintf(command_answer, sizeof(command_answer),LE910_IP_SOCKET_09, socketId+1) >= (int)sizeof(command_answer))
+    {
+        return 1;
+    }
 
     // generate command
     // AT#SRECV=<socketId>,<LE910_MAX_DL_PAYLOAD>\r
-    sprintf(command_buffer,(char*)pgm_read_word(&(table_IP[26])),
-            socketId+1,
-            LE910_MAX_DL_PAYLOAD);
+    if (snprintf(command_buffer, sizeof(command_buffer),LE910_IP_SOCKET_26,
+                socketId+1,
+                LE910_MAX_DL_PAYLOAD) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, command_answer, 2000);
@@ -4174,15 +4307,18 @@ uint8_t arduPi4G::receiveSSL(uint8_t socketId, uint32_t timeout)
 
     // generate command
     // AT#SSLRECV=<socketId>,<MaxNumBytes>\r
-    sprintf(command_buffer,
-            (char*)pgm_read_word(&(table_IP[15])),
-            socketId+1,
-            LE910_MAX_DL_PAYLOAD);
+    if (snprintf(command_buffer, sizeof(command_buffer),
+                LE910_IP_SOCKET_15,
+                socketId+1,
+                LE910_MAX_DL_PAYLOAD) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // Generate answers
-    strcpy(answer1, (char*)pgm_read_word(&(table_IP[16])));   //"#SSLRECV: "
-    strcpy(answer2, (char*)pgm_read_word(&(table_IP[17])));   //"TIMEOUT\r\n"
-    strcpy(answer3, (char*)pgm_read_word(&(table_IP[18])));   //"DISCONNECTED\r\n"
+    strcpy(answer1, LE910_IP_SOCKET_16);   //"#SSLRECV: "
+    strcpy(answer2, LE910_IP_SOCKET_17);   //"TIMEOUT\r\n"
+    strcpy(answer3, LE910_IP_SOCKET_18);   //"DISCONNECTED\r\n"
 
     //// 1. Send command to read received data and save it
     do
@@ -4341,9 +4477,12 @@ uint8_t arduPi4G::manageSSL(uint8_t socketId,
 
     //// 1. Enable a SSL socket
     // AT#SSLEN=<SSId>, <Enable>\r
-    sprintf( command_buffer,
-             (char*)pgm_read_word(&(table_IP[33])),
-             1); // Enable
+    if (snprintf(command_buffer, sizeof(command_buffer),
+                 LE910_IP_SOCKET_33,
+                 1) >= (int)sizeof(command_buffer)) // Enable
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -4363,8 +4502,8 @@ uint8_t arduPi4G::manageSSL(uint8_t socketId,
 /*
     //// Configure security parameters of a SSL socket
     // AT#SSLSECCFG=<SSId>,<CipherSuite>,<SecLevel>
-    sprintf( command_buffer,
-             (char*)pgm_read_word(&(table_IP[34])),
+    snprintf(command_buffer, sizeof(command_buffer),
+             LE910_IP_SOCKET_34,
              0,  // Chiper Suite is chosen by remote Server [default]
              1); // Manage server authentication
 
@@ -4385,12 +4524,15 @@ uint8_t arduPi4G::manageSSL(uint8_t socketId,
     if ((action == SSL_ACTION_STORE) && (data != NULL))
     {
         // AT#SSLSECDATA=<socketId>,<action>,<dataType>,<data_length>\r
-        sprintf(  command_buffer,
-                    (char*)pgm_read_word(&(table_IP[10])),
-                    socketId+1,
-                    action,
-                    dataType,
-                    strlen(data));
+        if (snprintf(command_buffer, sizeof(command_buffer),
+                        LE910_IP_SOCKET_10,
+                        socketId+1,
+                        action,
+                        dataType,
+                        (unsigned int)strlen(data)) >= (int)sizeof(command_buffer))
+        {
+            return 2;
+        }
 
         // send command
         answer = sendCommand(command_buffer, (char*)">", LE910_ERROR_CODE, LE910_ERROR);
@@ -4426,14 +4568,17 @@ uint8_t arduPi4G::manageSSL(uint8_t socketId,
     else if (action == SSL_ACTION_READ)
     {
         // command_buffer <-- AT#SSLSECDATA=<socketId>,<action>,<dataType>\r
-        sprintf(  command_buffer,
-                  (char*)pgm_read_word(&(table_IP[11])),
-                  socketId+1,
-                  action,
-                  dataType);
+        if (snprintf(command_buffer, sizeof(command_buffer),
+                      LE910_IP_SOCKET_11,
+                      socketId+1,
+                      action,
+                      dataType) >= (int)sizeof(command_buffer))
+        {
+            return 4;
+        }
 
         // command_answer <-- "#SSLSECDATA: "
-        strcpy( command_answer, (char*)pgm_read_word(&(table_IP[27])));
+        strcpy( command_answer, LE910_IP_SOCKET_27);
 
         // send command
         answer = sendCommand(command_buffer, command_answer, LE910_ERROR_CODE, LE910_ERROR);
@@ -4457,11 +4602,14 @@ uint8_t arduPi4G::manageSSL(uint8_t socketId,
     else if (action == SSL_ACTION_DELETE)
     {
         // AT#SSLSECDATA=<socketId>,<action>,<dataType>\r
-        sprintf(  command_buffer,
-                  (char*)pgm_read_word(&(table_IP[11])),
-                  socketId+1,
-                  action,
-                  dataType);
+        if (snprintf(command_buffer, sizeof(command_buffer),
+                      LE910_IP_SOCKET_11,
+                      socketId+1,
+                      action,
+                      dataType) >= (int)sizeof(command_buffer))
+        {
+            return 5;
+        }
 
         // send command
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
@@ -4558,7 +4706,10 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
 
     //// 1. Set reset mode
     // AT$GPSR=<reset_mode>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[2])), reset_mode);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_02, reset_mode) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -4576,11 +4727,11 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
     //// 2. Check if the GPS engine is powered on
     //// In that case, we return OK; if not we start the gps power
     // AT$GPSP?\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_GPS[13])));
+    strcpy(command_buffer, LE910_GPS_13);
 
     // Generate answer to be parsed
     // "GPSP: 1"
-    strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[14])));
+    strcpy(command_answer, LE910_GPS_14);
 
     // send command
     answer = sendCommand(command_buffer, command_answer, LE910_ERROR_CODE, LE910_ERROR, 1000);
@@ -4605,7 +4756,10 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
     {
         //// GPS Power Management: GPS controller is powered up
         // "AT$GPSP=1\r"
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[0])), 1);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_00, 1) >= (int)sizeof(command_buffer))
+        {
+            return 3;
+        }
 
         // send command
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 1000);
@@ -4634,7 +4788,10 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
 
         //// 5. Define PDP Context
         // AT+CGDCONT=1,"IP","<APN>"\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_4G[29])), _apn);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_string_29, _apn) >= (int)sizeof(command_buffer))
+        {
+            return 6;
+        }
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
         if (answer != 1)
         {
@@ -4643,7 +4800,10 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
 
         //// 6. Set Authentication User ID
         // AT#USERID="<login>"\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_4G[5])), _apn_login);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_string_05, _apn_login) >= (int)sizeof(command_buffer))
+        {
+            return 7;
+        }
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
         if (answer != 1)
         {
@@ -4652,7 +4812,10 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
 
         //// 7. Set Authentication Password
         // AT#PASSW="<pass>"\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_4G[6])), _apn_password);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_string_06, _apn_password) >= (int)sizeof(command_buffer))
+        {
+            return 8;
+        }
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 5000);
         if (answer != 1)
         {
@@ -4661,7 +4824,10 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
 
         //// 8.
         // AT#SCFG=1,1,300,90,600,50\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_IP[2])), 1, 1, 300, 90, 600, 50);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_IP_SOCKET_02, 1, 1, 300, 90, 600, 50) >= (int)sizeof(command_buffer))
+        {
+            return 9;
+        }
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR);
         if (answer != 1)
         {
@@ -4691,7 +4857,10 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
 
         //// 3.3. Set the version of supported SUPL
         // AT$SUPLV=%u\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[20])), 1);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_20, 1) >= (int)sizeof(command_buffer))
+        {
+            return 12;
+        }
 
         // send command
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 1000);
@@ -4730,10 +4899,13 @@ uint8_t arduPi4G::gpsStart(uint8_t gps_mode, uint8_t reset_mode)
 
         //// 3.4. GPS Start Location Service Request:
         // AT$GPSSLSR=<transport_protocol>,<gps_mode>,,,,,1\r
-        sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[1])),
-                    1,
-                    gps_mode,
-                    1);
+        if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_01,
+                        1,
+                        gps_mode,
+                        1) >= (int)sizeof(command_buffer))
+        {
+            return 17;
+        }
 
         // send command
         answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 1000);
@@ -4774,7 +4946,10 @@ uint8_t arduPi4G::gpsStop()
     char command_buffer[20];
 
     // AT$GPSP=0\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[0])), 0);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_00, 0) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 1000);
@@ -4798,6 +4973,7 @@ uint8_t arduPi4G::gpsStop()
  */
 int8_t arduPi4G::checkGPS()
 {
+    char* saveptr;
     char *pointer;
     uint8_t answer;
     char command_name[20];
@@ -4806,10 +4982,10 @@ int8_t arduPi4G::checkGPS()
 
     //// 1. Check if the GPS position is fixed
     // AT$GPSACP\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_GPS[4])));
+    strcpy(command_buffer, LE910_GPS_04);
 
     // pattern <--- "$GPSACP: ,"
-    strcpy(command_pattern, (char*)pgm_read_word(&(table_GPS[15])));
+    strcpy(command_pattern, LE910_GPS_15);
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -4852,10 +5028,10 @@ int8_t arduPi4G::checkGPS()
     // $GPSACP: 073041.000,4139.7780N,00051.3417W,500.0,-394.4,2,0.0,0.0,0.0,050515,00
 
     // pattern <--- "\r\n$GPSACP: .,"
-    strcpy(command_pattern, (char*)pgm_read_word(&(table_GPS[16])));
+    strcpy(command_pattern, LE910_GPS_16);
 
     // skip first characters
-    pointer = strtok((char*)_buffer, command_pattern);
+    pointer = strtok_r((char*)_buffer, command_pattern, &saveptr);
     if (pointer == NULL)
     {
         return 3;
@@ -4870,14 +5046,14 @@ int8_t arduPi4G::checkGPS()
     strncpy(_time, pointer, 6);
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 4;
     }
 
     // skip '.000' after time field
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 5;
@@ -4896,7 +5072,7 @@ int8_t arduPi4G::checkGPS()
     _latitude[strlen(_latitude)-1] = '\0';
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 6;
@@ -4915,7 +5091,7 @@ int8_t arduPi4G::checkGPS()
     _longitude[strlen(_longitude)-1] = '\0';
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 7;
@@ -4929,7 +5105,7 @@ int8_t arduPi4G::checkGPS()
     _hdop = atof(pointer);
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 8;
@@ -4943,7 +5119,7 @@ int8_t arduPi4G::checkGPS()
     _altitude = atof(pointer);
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 9;
@@ -4957,7 +5133,7 @@ int8_t arduPi4G::checkGPS()
     _fixMode = atoi(pointer);
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 10;
@@ -4972,7 +5148,7 @@ int8_t arduPi4G::checkGPS()
     strcpy(_courseOG, pointer);
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 11;
@@ -4986,7 +5162,7 @@ int8_t arduPi4G::checkGPS()
     _speedOG = atof(pointer);
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 12;
@@ -4997,7 +5173,7 @@ int8_t arduPi4G::checkGPS()
     #endif
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 13;
@@ -5012,7 +5188,7 @@ int8_t arduPi4G::checkGPS()
     strncpy(_date, pointer, 6);
 
     // skip ','
-    pointer = strtok(NULL, ",");
+    pointer = strtok_r(NULL, ",", &saveptr);
     if (pointer == NULL)
     {
         return 14;
@@ -5248,14 +5424,17 @@ uint8_t arduPi4G::gpsSetQualityOfService( uint32_t horiz_accuracy,
     char command_buffer[80];
 
     // "AT$GPSQOS=%lu,%u,%u,%lu,%u,%u,%u\r"
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[19])),
-                horiz_accuracy,
-                vertic_accuracy,
-                rsp_time,
-                age_of_location_info,
-                location_type,
-                nav_profile,
-                velocity_request);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_19,
+                    (unsigned long)horiz_accuracy,
+                    vertic_accuracy,
+                    rsp_time,
+                    (unsigned long)age_of_location_info,
+                    location_type,
+                    nav_profile,
+                    velocity_request) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = (int)sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -5288,38 +5467,56 @@ bool arduPi4G::getNMEAString(uint8_t NMEA)
     {
         case LE910_GGA:
             // AT$GPSNMUN=3,1,0,0,0,0,0\r
-            sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[17])), 1, 0, 0, 0, 0, 0);
-            strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[10])));   //$GPGGA
+            if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_17, 1, 0, 0, 0, 0, 0) >= (int)sizeof(command_buffer))
+            {
+                return 1;
+            }
+            strcpy(command_answer, LE910_GPS_10);   //$GPGGA
             break;
         case LE910_GSA:
             // AT$GPSNMUN=3,0,0,1,0,0,0\r
-            sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[17])), 0, 0, 1, 0, 0, 0);
-            strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[9])));    //$GPGSA
+            if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_17, 0, 0, 1, 0, 0, 0) >= (int)sizeof(command_buffer))
+            {
+                return 1;
+            }
+            strcpy(command_answer, LE910_GPS_09);    //$GPGSA
             break;
         case LE910_GLL:
             // AT$GPSNMUN=3,0,1,0,0,0,0\r
-            sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[17])), 0, 1, 0, 0, 0, 0);
-            strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[7])));    //$GPGLL
+            if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_17, 0, 1, 0, 0, 0, 0) >= (int)sizeof(command_buffer))
+            {
+                return 1;
+            }
+            strcpy(command_answer, LE910_GPS_07);    //$GPGLL
             break;
         case LE910_VTG:
             // AT$GPSNMUN=3,0,0,0,0,1,0\r
-            sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[17])), 0, 0, 0, 0, 1, 0);
-            strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[11])));   //$GPRMC
+            if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_17, 0, 0, 0, 0, 1, 0) >= (int)sizeof(command_buffer))
+            {
+                return 1;
+            }
+            strcpy(command_answer, LE910_GPS_11);   //$GPRMC
             break;
         case LE910_RMC:
             // AT$GPSNMUN=3,0,0,0,0,0,1\r
-            sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[17])), 0, 0, 0, 0, 0, 1);
-            strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[8])));    //$GPVTG
+            if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_17, 0, 0, 0, 0, 0, 1) >= (int)sizeof(command_buffer))
+            {
+                return 1;
+            }
+            strcpy(command_answer, LE910_GPS_08);    //$GPVTG
             break;
         case LE910_GSV:
             // AT$GPSNMUN=3,0,0,0,1,0,0\r
-            sprintf(command_buffer, (char*)pgm_read_word(&(table_GPS[17])), 0, 0, 0, 1, 0, 0);
-            strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[12])));   //$GPGSV
+            if (snprintf(command_buffer, sizeof(command_buffer), LE910_GPS_17, 0, 0, 0, 1, 0, 0) >= (int)sizeof(command_buffer))
+            {
+                return 1;
+            }
+            strcpy(command_answer, LE910_GPS_12);   //$GPGSV
             break;
     }
 
     //command_answer <-- "CONNECT\r\n"
-    strcpy(command_answer, (char*)pgm_read_word(&(table_GPS[6])));
+    strcpy(command_answer, LE910_GPS_06);
     answer = sendCommand(command_buffer, command_answer, 5000);
     if (answer != 1)
     {
@@ -5327,7 +5524,7 @@ bool arduPi4G::getNMEAString(uint8_t NMEA)
     }
 
     // "+++"
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_GPS[18])));
+    strcpy(command_buffer, LE910_GPS_18);
 
     answer = waitFor((char*)"\r\n", 5000);
     if (answer != 1)
@@ -5366,13 +5563,14 @@ bool arduPi4G::getNMEAString(uint8_t NMEA)
 */
 uint8_t arduPi4G::getTemp()
 {
+    char* saveptr;
     int answer;
     char *ptr;
     char command_answer[20];
     char command_buffer[20];
 
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[8]))); //AT#TEMPMON=1
-    strcpy(command_answer, (char*)pgm_read_word(&(table_4G[9]))); //#TEMPMEAS:
+    strcpy(command_buffer, LE910_string_08); //AT#TEMPMON=1
+    strcpy(command_answer, LE910_string_09); //#TEMPMEAS:
 
     // send command
     answer = (int)sendCommand(command_buffer, command_answer, LE910_ERROR, 2000);
@@ -5388,7 +5586,7 @@ uint8_t arduPi4G::getTemp()
     }
 
     // Get temperature interval
-    ptr = strtok((char*)_buffer, ",");
+    ptr = strtok_r((char*)_buffer, ",", &saveptr);
 
     if (ptr == NULL)
     {
@@ -5398,7 +5596,7 @@ uint8_t arduPi4G::getTemp()
     _tempInterval = atoi(ptr);
 
     // Get temperature in Celsius degrees
-    ptr = strtok(NULL, "\r");
+    ptr = strtok_r(NULL, "\r", &saveptr);
 
     if (ptr == NULL)
     {
@@ -5421,7 +5619,7 @@ uint8_t arduPi4G::getRSSI()
     char delimiters[30];
 
     // AT+CSQ\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[10])));
+    strcpy(command_buffer, LE910_string_10);
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR, 2000);
@@ -5430,7 +5628,7 @@ uint8_t arduPi4G::getRSSI()
     if (answer == 1)
     {
         // delimiters <-- "AT+CSQ\r\n: ,"
-        strcpy(delimiters, (char*)pgm_read_word(&(table_4G[33])));
+        strcpy(delimiters, LE910_string_33);
 
         error = parseInt(&_rssi, delimiters);
 
@@ -5488,7 +5686,7 @@ uint8_t arduPi4G::getNetworkType()
     char delimiters[30];
 
     // AT#PSNT?\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[11])));
+    strcpy(command_buffer, LE910_string_11);
 
     // send command
     answer =  sendCommand(command_buffer, LE910_OK, LE910_ERROR, 2000);
@@ -5496,7 +5694,7 @@ uint8_t arduPi4G::getNetworkType()
     if (answer == 1)
     {
         // delimiters <-- "AT#PSNT?\r: ,"
-        strcpy(delimiters, (char*)pgm_read_word(&(table_4G[34])));
+        strcpy(delimiters, LE910_string_34);
 
         // parse response
         error = parseInt(&_networkType, delimiters);
@@ -5518,12 +5716,13 @@ uint8_t arduPi4G::getNetworkType()
 */
 uint8_t arduPi4G::getOperator(char* answer_storage)
 {
+    char* saveptr;
     uint8_t answer;
     char command_buffer[50];
     char* pointer;
 
     // AT+COPS?\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[24])));
+    strcpy(command_buffer, LE910_string_24);
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -5539,14 +5738,14 @@ uint8_t arduPi4G::getOperator(char* answer_storage)
     }
 
     // parse response: "+COPS: 0,0,"<answer>",7"\r\n
-    pointer = strtok((char*)_buffer, "\"");
+    pointer = strtok_r((char*)_buffer, "\"", &saveptr);
 
     if (pointer == NULL)
     {
         return 2;
     }
 
-    strcpy(answer_storage, (char*) strtok(NULL, "\""));
+    strcpy(answer_storage, (char*) strtok_r(NULL, "\"", &saveptr));
 
     return 0;
 }
@@ -5573,37 +5772,37 @@ int8_t arduPi4G::getInfo(uint8_t info_req)
         case 0:
             // Hardware revision
             // "AT#HWREV\r"
-            strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[12])));
+            strcpy(command_buffer, LE910_string_12);
             break;
         case 1:
             // Manufacturer identification
             // "AT#CGMI\r"
-            strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[13])));
+            strcpy(command_buffer, LE910_string_13);
             break;
         case 2:
             // Model identification
             // "AT#CGMM\r"
-            strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[14])));
+            strcpy(command_buffer, LE910_string_14);
             break;
         case 3:
             // Revision identification
             // "AT#CGMR\r"
-            strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[15])));
+            strcpy(command_buffer, LE910_string_15);
             break;
         case 4:
             // IMEI
             // "AT#CGSN\r"
-            strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[16])));
+            strcpy(command_buffer, LE910_string_16);
             break;
         case 5:
             // IMSI
             // "AT#CIMI\r"
-            strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[17])));
+            strcpy(command_buffer, LE910_string_17);
             break;
         case 6:
             // ICCID
             // "AT#CCID\r"
-            strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[18])));
+            strcpy(command_buffer, LE910_string_18);
             break;
     }
 
@@ -5630,9 +5829,9 @@ int8_t arduPi4G::getInfo(uint8_t info_req)
 
         if (answer == 0)
         {
-            memset(_buffer, 0x00 ,sizeof(_buffer));
             _length = strlen(aux);
-            strncpy((char*)_buffer, aux, strlen(aux));
+            memcpy(_buffer, aux, _length);
+            _buffer[_length] = 0x00;
             return 0;
         }
         return 1;
@@ -5662,7 +5861,10 @@ uint8_t arduPi4G::setWirelessNetwork(uint8_t n)
     char command_buffer[20];
 
     // "AT+WS46=<n>\r"
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_4G[41])), n);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_string_41, n) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -5701,7 +5903,7 @@ uint8_t arduPi4G::setTimeFrom4G()
     char output[128];
 
     // AT+CCLK?\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[25])));
+    strcpy(command_buffer, LE910_string_25);
 
     // send command
     answer =  sendCommand(command_buffer, (char*)"\"", LE910_ERROR, 2000);
@@ -5711,7 +5913,7 @@ uint8_t arduPi4G::setTimeFrom4G()
         waitFor((char*)"\"", 2000);
 
         // format <-- "%2hhu%*c%2hhu%*c%2hhu%*c%2hhu%*c%2hhu%*c%2hhu%hhd\""
-        strcpy(format, (char*)pgm_read_word(&(table_4G[35])));
+        strcpy(format, LE910_string_35);
 
         sscanf( (char*)_buffer,
                 format,
@@ -5751,7 +5953,7 @@ uint8_t arduPi4G::showTimeFrom4G()
     uint8_t hour, minute, second, timezone;
 
     // AT+CCLK?\r
-    strcpy(command_buffer, (char*)pgm_read_word(&(table_4G[25])));
+    strcpy(command_buffer, LE910_string_25);
 
     // send command
     answer =  sendCommand(command_buffer, (char *)"\"", LE910_ERROR, 2000);
@@ -5761,7 +5963,7 @@ uint8_t arduPi4G::showTimeFrom4G()
         waitFor((char *)"\"", 2000);
 
         // format <-- "%2hhu%*c%2hhu%*c%2hhu%*c%2hhu%*c%2hhu%*c%2hhu%hhd\""
-        strcpy(format, (char*)pgm_read_word(&(table_4G[35])));
+        strcpy(format, LE910_string_35);
 
         sscanf( (char*)_buffer,
                 format,
@@ -5847,7 +6049,10 @@ uint8_t arduPi4G::emailSetServerSMTP(char* serverSMTP)
     char command_buffer[80];
 
     // AT#ESMTP="<SMTP server>"\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[0])),serverSMTP);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_EMAIL_00,serverSMTP) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -5875,7 +6080,10 @@ uint8_t arduPi4G::emailConfigureSMTP(uint8_t security, uint16_t port)
     char answer[20];
     
     // AT#SMTPCFG=<ssl_encryption>,<port>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[7])),security,port);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_EMAIL_07,security,port) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
     
     // send command
     error = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -5903,7 +6111,10 @@ uint8_t arduPi4G::emailSetSender(char* address, char* user, char* password)
     
     //// 1. Set sender address
     // AT#EADDR="<address>"\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[1])),address);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_EMAIL_01,address) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
 
     // send command
@@ -5921,7 +6132,10 @@ uint8_t arduPi4G::emailSetSender(char* address, char* user, char* password)
       
     //// 2. Set sender user
     // AT#EUSER="<user>"\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[2])),user);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_EMAIL_02,user) >= (int)sizeof(command_buffer))
+    {
+        return 2;
+    }
     
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -5938,7 +6152,10 @@ uint8_t arduPi4G::emailSetSender(char* address, char* user, char* password)
         
     //// 3. Set sender password
     // AT#EPASSW="<passsword>"\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[3])),password);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_EMAIL_03,password) >= (int)sizeof(command_buffer))
+    {
+        return 3;
+    }
     
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -5967,10 +6184,13 @@ uint8_t arduPi4G::emailActivateContext(char* user, char* password)
     char answer[20];
     
     // AT#SGACT=1,1,"<APN user>","<APN pass>"\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[5])),user,password);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_EMAIL_05,user,password) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // "#SGACT: "
-    sprintf(answer, (char*)pgm_read_word(&(table_EMAIL_LE910[6])));
+    strcpy(answer, LE910_EMAIL_06);
     
     // send command
     error = sendCommand(command_buffer, answer, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -6007,7 +6227,10 @@ uint8_t arduPi4G::emailSend(char* address,char* subject,char* body)
     
     //// 2. Send email
     // AT#EMAILD=<address>,<subject>\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[8])),address,subject);
+    if (snprintf(command_buffer, sizeof(command_buffer), LE910_EMAIL_08,address,subject) >= (int)sizeof(command_buffer))
+    {
+        return 1;
+    }
 
     // send command
     error = sendCommand(command_buffer, (char *)">", LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -6056,7 +6279,7 @@ uint8_t arduPi4G::emailReset()
     char command_buffer[15];
     
     // AT#ERST\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[9])));
+    strcpy(command_buffer, LE910_EMAIL_09);
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -6089,7 +6312,7 @@ uint8_t arduPi4G::emailSave()
     char command_buffer[15];
     
     // AT#ESAV\r
-    sprintf(command_buffer, (char*)pgm_read_word(&(table_EMAIL_LE910[10])));
+    strcpy(command_buffer, LE910_EMAIL_10);
 
     // send command
     answer = sendCommand(command_buffer, LE910_OK, LE910_ERROR_CODE, LE910_ERROR, 2000);
@@ -6250,6 +6473,6 @@ void arduPi4G::printErrorCode( uint16_t error )
 
 // Preinstantiate Objects /////////////////////////////////////////////////////
 
-arduPi4G _4G = arduPi4G();
+arduPi4G _4G;
 
 ///////////////////////////////////////////////////////////////////////////////
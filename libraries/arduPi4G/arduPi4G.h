@@ -144,11 +144,12 @@ private:
      */
     char _apn_password[30]; 
     
-    /*! This function parses the error copde returned by the module. At the
+    /*! This function gets the error code returned by the module. At the
      * point this function is called, the UART is supposed to have received: 
      * "+CME ERROR: <err>\r\n" and the first part of the response has been 
-     * already detected: "+CME ERROR:", so this function needs to parse the 
-     * error code.
+     * already detected: "+CME ERROR:". The rest of the line is received with 
+     * the answer, so the code is taken from the result of the last command 
+     * without waiting again.
      * 
      * If error code is parsed succesfully then the attribute _errorCode stores
      * this error information
@@ -89,57 +89,6 @@ const char LE910_string_44[]     = "AT+CEREG?\r";                   //44
 const char LE910_string_45[]     = "+CEREG: 0,";                    //45
 
 
-const char* const table_4G[]  = 
-{
-    LE910_string_00,    //0
-    LE910_string_01,    //1
-    LE910_string_02,    //2
-    LE910_string_03,    //3
-    LE910_string_04,    //4
-    LE910_string_05,    //5
-    LE910_string_06,    //6 
-    LE910_string_07,    //7
-    LE910_string_08,    //8
-    LE910_string_09,    //9
-    LE910_string_10,    //10
-    LE910_string_11,    //11
-    LE910_string_12,    //12
-    LE910_string_13,    //13
-    LE910_string_14,    //14
-    LE910_string_15,    //15
-    LE910_string_16,    //16
-    LE910_string_17,    //17
-    LE910_string_18,    //18
-    LE910_string_19,    //19
-    LE910_string_20,    //20
-    LE910_string_21,    //21
-    LE910_string_22,    //22
-    LE910_string_23,    //23
-    LE910_string_24,    //24
-    LE910_string_25,    //25
-    LE910_string_26,    //26
-    LE910_string_27,    //27
-    LE910_string_28,    //28
-    LE910_string_29,    //29
-    LE910_string_30,    //30
-    LE910_string_31,    //31
-    LE910_string_32,    //32
-    LE910_string_33,    //33
-    LE910_string_34,    //34
-    LE910_string_35,    //35
-    LE910_string_36,    //36
-    LE910_string_37,    //37
-    LE910_string_38,    //38
-    LE910_string_39,    //39
-    LE910_string_40,    //40
-    LE910_string_41,    //41
-    LE910_string_42,    //42
-    LE910_string_43,    //43
-    LE910_string_44,    //44
-    LE910_string_45,    //45
-};
-
-
 /// table_PIN  /////////////////////////////////////////////////////////////////
 
 const char LE910_PIN_00[]    = "AT+CPIN?\r";                 //0
@@ -201,18 +150,6 @@ const char LE910_SMS_05[]    = "AT+CMGD=%u\r";                      //5
 const char LE910_SMS_06[]    = "AT+CMGD=%u,%u\r";                   //6
 const char LE910_SMS_07[]    = "+CMGR:";                            //7
 
-const char* const table_SMS[]  = 
-{
-    LE910_SMS_00,   //0
-    LE910_SMS_01,   //1
-    LE910_SMS_02,   //2
-    LE910_SMS_03,   //3
-    LE910_SMS_04,   //4
-    LE910_SMS_05,   //5
-    LE910_SMS_06,   //6
-    LE910_SMS_07,   //7
-};
-
 
 /// table_HTTP  ////////////////////////////////////////////////////////////////
 
@@ -227,17 +164,6 @@ const char LE910_HTTP_04[]   = "AT#HTTPRCV=%u,%u\r";            //4
 const char LE910_HTTP_05[]   = "/getpost_frame_parser.php";     //5
 const char LE910_HTTP_06[]   = "frame=";                        //6
 
-const char* const table_HTTP[]  = 
-{
-    LE910_HTTP_00,  //0
-    LE910_HTTP_01,  //1
-    LE910_HTTP_02,  //2
-    LE910_HTTP_03,  //3
-    LE910_HTTP_04,  //4
-    LE910_HTTP_05,  //5
-    LE910_HTTP_06,  //6
-};
-
 
 /// table_FTP  /////////////////////////////////////////////////////////////////
 
@@ -259,24 +185,6 @@ const char LE910_FTP_11[]    = "+++";                           // 11
 const char LE910_FTP_12[]    = "NO CARRIER";                    // 12
 const char LE910_FTP_13[]    = "#FTPRECV: ";                    // 13
 
-const char* const table_FTP[]  = 
-{
-    LE910_FTP_00,   //0
-    LE910_FTP_01,   //1
-    LE910_FTP_02,   //2
-    LE910_FTP_03,   //3
-    LE910_FTP_04,   //4
-    LE910_FTP_05,   //5
-    LE910_FTP_06,   //6
-    LE910_FTP_07,   //7
-    LE910_FTP_08,   //8
-    LE910_FTP_09,   //9
-    LE910_FTP_10,   //10
-    LE910_FTP_11,   //11
-    LE910_FTP_12,   //12
-    LE910_FTP_13,   //13
-};
-
 
 /// table_IP  //////////////////////////////////////////////////////////////////
 
@@ -319,45 +227,6 @@ const char LE910_IP_SOCKET_32[]  = "#SS: %u,";                          //32
 const char LE910_IP_SOCKET_33[]  = "AT#SSLEN=1,%u\r";                   //33
 const char LE910_IP_SOCKET_34[]  = "AT#SSLSECCFG=1,%u,%u\r";            //34
 
-const char* const table_IP[]  = 
-{
-    LE910_IP_SOCKET_00,     //0
-    LE910_IP_SOCKET_01,     //1
-    LE910_IP_SOCKET_02,     //2
-    LE910_IP_SOCKET_03,     //3
-    LE910_IP_SOCKET_04,     //4
-    LE910_IP_SOCKET_05,     //5
-    LE910_IP_SOCKET_06,     //6
-    LE910_IP_SOCKET_07,     //7
-    LE910_IP_SOCKET_08,     //8
-    LE910_IP_SOCKET_09,     //9
-    LE910_IP_SOCKET_10,     //10
-    LE910_IP_SOCKET_11,     //11
-    LE910_IP_SOCKET_12,     //12
-    LE910_IP_SOCKET_13,     //13    
-    LE910_IP_SOCKET_14,     //14
-    LE910_IP_SOCKET_15,     //15
-    LE910_IP_SOCKET_16,     //16
-    LE910_IP_SOCKET_17,     //17
-    LE910_IP_SOCKET_18,     //18
-    LE910_IP_SOCKET_19,     //19
-    LE910_IP_SOCKET_20,     //20
-    LE910_IP_SOCKET_21,     //21
-    LE910_IP_SOCKET_22,     //22
-    LE910_IP_SOCKET_23,     //23
-    LE910_IP_SOCKET_24,     //24
-    LE910_IP_SOCKET_25,     //25
-    LE910_IP_SOCKET_26,     //26
-    LE910_IP_SOCKET_27,     //27
-    LE910_IP_SOCKET_28,     //28
-    LE910_IP_SOCKET_29,     //29
-    LE910_IP_SOCKET_30,     //30
-    LE910_IP_SOCKET_31,     //31
-    LE910_IP_SOCKET_32,     //32
-    LE910_IP_SOCKET_33,     //33
-    LE910_IP_SOCKET_34,     //34
-};
-
 
 /// table_GPS  /////////////////////////////////////////////////////////////////
 
@@ -383,31 +252,6 @@ const char LE910_GPS_18[]    = "+++";                               //18
 const char LE910_GPS_19[]    = "AT$GPSQOS=%lu,%u,%u,%lu,%u,%u,%u\r";//19
 const char LE910_GPS_20[]    = "AT$SUPLV=%u\r";                     //20
 
-const char* const table_GPS[]  = 
-{
-    LE910_GPS_00,   //0
-    LE910_GPS_01,   //1
-    LE910_GPS_02,   //2
-    LE910_GPS_03,   //3
-    LE910_GPS_04,   //4
-    LE910_GPS_05,   //5
-    LE910_GPS_06,   //6
-    LE910_GPS_07,   //7
-    LE910_GPS_08,   //8
-    LE910_GPS_09,   //9
-    LE910_GPS_10,   //10
-    LE910_GPS_11,   //11
-    LE910_GPS_12,   //12
-    LE910_GPS_13,   //13
-    LE910_GPS_14,   //14
-    LE910_GPS_15,   //15
-    LE910_GPS_16,   //16
-    LE910_GPS_17,   //17
-    LE910_GPS_18,   //18
-    LE910_GPS_19,   //19
-    LE910_GPS_20,   //20
-};
-
 
 /// table_EMAIL_LE910 ////////////////////////////////////////////////////////////
 
@@ -423,19 +267,4 @@ const char LE910_EMAIL_08[] = "AT#EMAILD=\"%s\",\"%s\"\r";      //8
 const char LE910_EMAIL_09[] = "AT#ERST\r";                      //9
 const char LE910_EMAIL_10[] = "AT#ESAV\r";                      //10
 
-const char* const table_EMAIL_LE910[] = 
-{
-    LE910_EMAIL_00, //0
-    LE910_EMAIL_01, //1
-    LE910_EMAIL_02, //2
-    LE910_EMAIL_03, //3
-    LE910_EMAIL_04, //4
-    LE910_EMAIL_05, //5
-    LE910_EMAIL_06, //6
-    LE910_EMAIL_07, //7
-    LE910_EMAIL_08, //8
-    LE910_EMAIL_09, //9
-    LE910_EMAIL_10  //10
-};
-
 #endif
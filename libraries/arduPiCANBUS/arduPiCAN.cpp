@@ -32,7 +32,7 @@
  * Constructors
  ***********************************************************************/
 
-CAN::CAN(void){}
+CAN::CAN(void) : spiSettings(BCM2835_CORE_CLK_HZ / SPI_CLOCK_DIV32, MSBFIRST, SPI_MODE0), rxBufferToggle(0){}
 
 
 /***********************************************************************
@@ -79,21 +79,16 @@ bool CAN::begin(uint16_t speed)
 	#endif
 
 	//Initialization SPI
+	//Bit order, mode 0 (both mode 0 & 3 should work) and frequency are
+	//kept in spiSettings and applied on every transaction
 	SPI.begin();
-	//SPI.detachInterrupt();	
-	SPI.setBitOrder(MSBFIRST);
-	// both mode 0 & 3 should work
-	SPI.setDataMode(SPI_MODE0); 
-	
-	//Set the SPI frequency
-	SPI.setClockDivider(SPI_CLOCK_DIV32);
 	
 	#if (DEBUGMODE==1)
 		printf("SPI configured\n");
 	#endif
 	
 	//Configure MCP2515 pins
-	pinMode(CAN_CS,OUTPUT);
+	//CAN_CS is the CE0 line, driven by the SPI engine in every transaction
 	pinMode(CAN_INT,INPUT);
 	
 	//Software resets MCP2515
@@ -102,6 +97,9 @@ bool CAN::begin(uint16_t speed)
 	
 	//After the reset enters configuration mode	
 	
+	//Keep the socket SPI enabled for the whole configuration
+	Utils.holdCSSocket0(); //Multiprotocol v2.0
+	
 	//Choose the rate of CAN-bus
 	switch(speed){
 	  
@@ -109,7 +107,7 @@ bool CAN::begin(uint16_t speed)
 		#if (DEBUGMODE==1)
 			printf("Speed=1Mbps\n");
 		#endif
-			digitalWrite(CAN_CS,LOW); //Embebed Socket 	
+			SPI.beginTransaction(spiSettings);
             Utils.setCSSocket0(); //Multiprotocol v2.0
 				
 			SPI.transfer(SPI_WRITE);
@@ -117,15 +115,15 @@ bool CAN::begin(uint16_t speed)
 			SPI.transfer((1<<PHSEG21));	
 			SPI.transfer((1<<BTLMODE)|(1<<PHSEG11));
 				
-			digitalWrite(CAN_CS,HIGH); //Embebed Socket		
             Utils.unsetCSSocket0(); //Multiprotocol v2.0
+			SPI.endTransaction();
       	break;
 
     	case 500:
 		#if (DEBUGMODE==1)
 			printf("Speed=500kps\n");
 		#endif
-			digitalWrite(CAN_CS,LOW); //Embebed Socket 	
+			SPI.beginTransaction(spiSettings);
             Utils.setCSSocket0(); //Multiprotocol v2.0
       		SPI.transfer(SPI_WRITE);
 
@@ -134,15 +132,15 @@ bool CAN::begin(uint16_t speed)
 			SPI.transfer((1<<BTLMODE)|(1<<PHSEG11));
 			SPI.transfer((1<<BRP0));
 				
-			digitalWrite(CAN_CS,HIGH); //Embebed Socket		
             Utils.unsetCSSocket0(); //Multiprotocol v2.0
+			SPI.endTransaction();
 		break;
 
     	case 250:
 		#if (DEBUGMODE==1)
 			printf("Speed=250kps\n");
 		#endif
-			digitalWrite(CAN_CS,LOW); //Embebed Socket 	
+			SPI.beginTransaction(spiSettings);
             Utils.setCSSocket0(); //Multiprotocol v2.0
 
 			SPI.transfer(SPI_WRITE);
@@ -151,15 +149,15 @@ bool CAN::begin(uint16_t speed)
 			SPI.transfer((1<<BTLMODE)|(1<<PHSEG12)|(1<<PHSEG11)|(1<<PHSEG10));
 			SPI.transfer((1<<BRP0));					
 					
-			digitalWrite(CAN_CS,HIGH); //Embebed Socket		
             Utils.unsetCSSocket0(); //Multiprotocol v2.0
+			SPI.endTransaction();
 		break;
 
 		default:
 		#if (DEBUGMODE==1)
 			printf("The rate requested is unavailable, is set to 125 Kbit/s by default\n");
 		#endif
-			digitalWrite(CAN_CS,LOW); //Embebed Socket 	
+			SPI.beginTransaction(spiSettings);
             Utils.setCSSocket0(); //Multiprotocol v2.0
 
 			SPI.transfer(SPI_WRITE);
@@ -168,8 +166,8 @@ bool CAN::begin(uint16_t speed)
 			SPI.transfer((1<<BTLMODE)|(1<<PHSEG11));
 			SPI.transfer((1<<BRP2)|(1<<BRP1)|(1<<BRP0));		
 
-			digitalWrite(CAN_CS,HIGH); //Embebed Socket		
             Utils.unsetCSSocket0(); //Multiprotocol v2.0
+			SPI.endTransaction();
 		break;
 
   	}
@@ -200,6 +198,8 @@ bool CAN::begin(uint16_t speed)
 	//Set normal mode
 	setMode(NORMAL_MODE);
 	
+	Utils.releaseCSSocket0(); //Multiprotocol v2.0
+	
 	//Test its correct mode
 	/*
 	if (read_register(CANSTAT) != 0) {
@@ -226,7 +226,6 @@ char CAN::getMessage(messageCAN *rec_msje)
 	//Bought that buffer is the message
 	char status = readStatus(SPI_RX_STATUS);
 	char addr;
-	static uint8_t previoSerialuffer;
 
 	/*	
 		if (bit_is_set(status,6)) {	    
@@ -245,7 +244,7 @@ char CAN::getMessage(messageCAN *rec_msje)
 
 	if ( (((status & 0b11000000)>>6)&0b00000011) >2 )
 	{
-		addr=SPI_READ_RX | (previoSerialuffer++ & 0x01)<<2;
+		addr=SPI_READ_RX | (rxBufferToggle++ & 0x01)<<2;
 		#if (DEBUGMODE==1)
 			printf("Data in buffer available\n");
 		#endif
@@ -273,7 +272,10 @@ char CAN::getMessage(messageCAN *rec_msje)
 		return 0;
 	}
 	
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
+	//Keep the socket SPI enabled to read the message and clear its flag
+	Utils.holdCSSocket0(); //Multiprotocol v2.0
+	
+	SPI.beginTransaction(spiSettings);
         Utils.setCSSocket0(); //Multiprotocol v2.0
 
 	SPI.transfer(addr);
@@ -297,8 +299,8 @@ char CAN::getMessage(messageCAN *rec_msje)
 			rec_msje->data[i] = SPI.transfer(0xFF);
 	    }
 	    
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
         Utils.unsetCSSocket0(); //Multiprotocol v2.0
+	SPI.endTransaction();
 	
 	//Delete the interruptions flags
 	    if (bit_is_set(status, 6)) {
@@ -308,6 +310,8 @@ char CAN::getMessage(messageCAN *rec_msje)
 			bitModify(CANINTF, (1<<RX1IF), 0);
 		}
 	
+	Utils.releaseCSSocket0(); //Multiprotocol v2.0
+	
 	return status;
 }
 
@@ -344,7 +348,10 @@ char CAN::sendMessage(messageCAN *send_msje)
 		return 0;
 	}
 	
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
+	//Keep the socket SPI enabled to load and send the message
+	Utils.holdCSSocket0(); //Multiprotocol v2.0
+	
+	SPI.beginTransaction(spiSettings);
         Utils.setCSSocket0(); //Multiprotocol v2.0
 
 	SPI.transfer(SPI_WRITE_TX | address);
@@ -370,18 +377,20 @@ char CAN::sendMessage(messageCAN *send_msje)
 			}
 		}
 //Mirar esto, es necesario?	
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
         Utils.unsetCSSocket0(); //Multiprotocol v2.0
+	SPI.endTransaction();
 	
 	//Send message
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
+	SPI.beginTransaction(spiSettings);
         Utils.setCSSocket0(); //Multiprotocol v2.0
 
 	address = (address == 0) ? 1 : address;
 	SPI.transfer(SPI_RTS | address);
 
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
         Utils.unsetCSSocket0(); //Multiprotocol v2.0
+	SPI.endTransaction();
+	
+	Utils.releaseCSSocket0(); //Multiprotocol v2.0
 	
 	return address;
 }
@@ -830,9 +839,7 @@ void CAN::CiARequest(uint8_t PID)
 //Write a MCP2515 register
 void CAN::writeRegister( char direction, char data )
 {
-	//CS low to select the MCP2515 
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
-        Utils.setCSSocket0(); //Multiprotocol v2.0
+	//write16() selects the MCP2515 for the whole command
 
 	/*SPI.transfer(SPI_WRITE);
 	SPI.transfer(direction);
@@ -842,11 +849,6 @@ void CAN::writeRegister( char direction, char data )
 	txbuf[1] = direction;	
 	txbuf[2] = data;
 	write16(3);	
-	
-	//CS line again to release 
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
-        Utils.unsetCSSocket0(); //Multiprotocol v2.0
-
 }
 
 
@@ -857,9 +859,7 @@ char CAN::readRegister(char direction)
 {
 	char data;
 	
-	//CS low to select the MCP2515 
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
-        Utils.setCSSocket0(); //Multiprotocol v2.0
+	//write16() selects the MCP2515 for the whole command
 	
 	/*SPI.transfer(SPI_READ);
 	SPI.transfer(direction);*/
@@ -873,11 +873,6 @@ char CAN::readRegister(char direction)
 	//Read data SPI
 	//data = SPI.transfer(0xff);	
 
-	
-	//CS line again to release 
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
-        Utils.unsetCSSocket0(); //Multiprotocol v2.0
-
 	return rxbuf[2];
 	//return data;
 }
@@ -888,9 +883,7 @@ char CAN::readRegister(char direction)
 //Modify a bit of the MCP2515 registers
 void CAN::bitModify(char direction, char mask, char data)
 {
-	//CS low to select the MCP2515 
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
-        Utils.setCSSocket0(); //Multiprotocol v2.0
+	//write16() selects the MCP2515 for the whole command
 	
 	/*SPI.transfer(SPI_BIT_MODIFY);
 	SPI.transfer(direction);
@@ -902,12 +895,6 @@ void CAN::bitModify(char direction, char mask, char data)
 	txbuf[2] = mask;
 	txbuf[3] = data;
 	write16(4);	
-	
-	
-	//CS line again to release 
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
-        Utils.unsetCSSocket0(); //Multiprotocol v2.0
-
 }
 
 
@@ -918,9 +905,7 @@ char CAN::readStatus(char type)
 {
 	//char data;
 	
-	//CS low to select the MCP2515 
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
-        Utils.setCSSocket0(); //Multiprotocol v2.0
+	//write16() selects the MCP2515 for the whole command
 		
 	/*SPI.transfer(type);	
 	//Read data SPI 
@@ -930,11 +915,6 @@ char CAN::readStatus(char type)
 	txbuf[1] = 0xFF;
 	write16(2);	
 	 	
-	 	
-	//CS line again to release 
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
-        Utils.unsetCSSocket0(); //Multiprotocol v2.0
-	
 	return rxbuf[1];
 
 	//return data;
@@ -965,14 +945,14 @@ bool CAN::checkFreeBuffer(void)
 void CAN::reset(void)
 {
 	//CS low to select the MCP2515 
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
+	SPI.beginTransaction(spiSettings);
         Utils.setCSSocket0(); //Multiprotocol v2.0
 
 	SPI.transfer(SPI_RESET);	
 	//CS line again to release 
 
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
         Utils.unsetCSSocket0(); //Multiprotocol v2.0
+	SPI.endTransaction();
 
 
 	//Wait a bit to be stabilized after the reset MCP2515
@@ -985,12 +965,12 @@ void CAN::reset(void)
 
 void CAN::write16(int num)
 {
-	digitalWrite(CAN_CS,LOW); //Embebed Socket
+	SPI.beginTransaction(spiSettings);
         Utils.setCSSocket0(); //Multiprotocol v2.0
 
 	SPI.transfernb(txbuf, rxbuf, num);
 
-	digitalWrite(CAN_CS,HIGH); //Embebed Socket
         Utils.unsetCSSocket0(); //Multiprotocol v2.0
+	SPI.endTransaction();
 }
 
@@ -452,6 +452,11 @@ class CAN
 		char txbuf[5];
 		char rxbuf[4];
 		void write16(int num);
+		
+		// SPI configuration of the MCP2515
+		SPISettings spiSettings;
+		// Receive buffer read last when both are full, per object
+		uint8_t rxBufferToggle;
 
 
 	public:
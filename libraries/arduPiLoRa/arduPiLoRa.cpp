@@ -66,13 +66,9 @@ uint8_t SX1272::ON()
   delayMicroseconds(100);
  
   //Configure the MISO, MOSI, CS, SPCR.
+  //Bit order, clock divider and data mode are kept in _spiSettings
+  //and applied on every register access
   SPI.begin();
-  //Set Most significant bit first
-  SPI.setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);
-  //Divide the clock frequency
-  SPI.setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_64);
-  //Set data mode
-  SPI.setDataMode(BCM2835_SPI_MODE0);
   delayMicroseconds(100);
   setMaxCurrent(0x1B);
   #if (SX1272_debug_mode > 1)
@@ -192,14 +188,12 @@ void SX1272::OFF()
 */
 byte SX1272::readRegister(byte address)
 {
-	digitalWrite(SX1272_SS,LOW);
     bitClear(address, 7);		// Bit 7 cleared to write in registers
     //SPI.transfer(address);
     //value = SPI.transfer(0x00);
     txbuf[0] = address;
 	txbuf[1] = 0x00;
 	maxWrite16();
-	digitalWrite(SX1272_SS,HIGH);
 
     #if (SX1272_debug_mode > 1)
         printf("## Reading:  ##\tRegister ");
@@ -221,15 +215,12 @@ byte SX1272::readRegister(byte address)
 */
 void SX1272::writeRegister(byte address, byte data)
 {
-	digitalWrite(SX1272_SS,LOW);
-	delayMicroseconds(1);
     bitSet(address, 7);			// Bit 7 set to read from registers
     //SPI.transfer(address);
     //SPI.transfer(data);
     txbuf[0] = address;
 	txbuf[1] = data;
 	maxWrite16();
-	//digitalWrite(SX1272_SS,HIGH);
 
     #if (SX1272_debug_mode > 1)
         printf("## Writing:  ##\tRegister ");
@@ -251,9 +242,11 @@ void SX1272::writeRegister(byte address, byte data)
 */
 void SX1272::maxWrite16()
 {
-	digitalWrite(SX1272_SS,LOW);
+	// SX1272_SS is the CE0 line: the SPI engine asserts it for the
+	// whole transaction and releases it in endTransaction()
+	SPI.beginTransaction(_spiSettings);
 	SPI.transfernb(txbuf, rxbuf, 2);
-	digitalWrite(SX1272_SS,HIGH);
+	SPI.endTransaction();
 }
 
 /*
@@ -300,7 +300,7 @@ public:
 	\param void
 	\return void
   	 */
-   	SX1272()
+   	SX1272() : _spiSettings(BCM2835_CORE_CLK_HZ / BCM2835_SPI_CLOCK_DIVIDER_64, MSBFIRST, SPI_MODE0)
     {
 		// Initialize class variables
 		_bandwidth = BW_125;
@@ -1226,6 +1226,9 @@ private:
 
 	char txbuf[2];
 	char rxbuf[2];
+
+	// SPI configuration of the SX1272
+	SPISettings _spiSettings;
 };
 
 extern SX1272	sx1272;
@@ -27,8 +27,6 @@
 
 #include "arduPiLoRaWAN.h"
 
-#define pgm_read_word(addr) (*(const intptr_t*)(addr))
-
 /******************************************************************************
  * FLASH DEFINITIONS COMMANDS
  ******************************************************************************/
@@ -114,92 +112,6 @@
  const char command_79[]    =   "mac set rxdelay1 %u\r\n";
  const char command_80[]    =   "mac reset\r\n";
 
-
-const char* const table_LoRaWAN_COMMANDS[] =    
-{   
-  command_00, 
-  command_01,
-  command_02,
-  command_03,
-  command_04,
-  command_05,
-  command_06,
-  command_07,
-  command_08,
-  command_09,
-  command_10,
-  command_11,
-  command_12,
-  command_13,
-  command_14,
-  command_15,
-  command_16,
-  command_17,
-  command_18,
-  command_19,
-  command_20,
-  command_21,
-  command_22,
-  command_23,
-  command_24,
-  command_25,
-  command_26,
-  command_27,
-  command_28,
-  command_29,
-  command_30,
-  command_31,
-  command_32,
-  command_33,
-  command_34,
-  command_35,
-  command_36,
-  command_37,
-  command_38,
-  command_39,
-  command_40,
-  command_41,
-  command_42,
-  command_43,
-  command_44,
-  command_45, 
-  command_46,
-  command_47,
-  command_48,
-  command_49,
-  command_50,
-  command_51,
-  command_52,
-  command_53,
-  command_54,
-  command_55,
-  command_56,
-  command_57,
-  command_58,
-  command_59,
-  command_60,
-  command_61,
-  command_62,
-  command_63,
-  command_64,
-  command_65,
-  command_66,
-  command_67,     
-  command_68,
-  command_69,
-  command_70,
-  command_71,
-  command_72,
-  command_73,
-  command_74,
-  command_75,
-  command_76,
-  command_77,
-  command_78,
-  command_79,
-  command_80
-};
-
 /******************************************************************************
  * FLASH DEFINITIONS ANSWERS
  ******************************************************************************/
@@ -226,32 +138,6 @@ const char* const table_LoRaWAN_COMMANDS[] =
  const char answer_20[]   = "RN2903";
 
 
-const char* const table_LoRaWAN_ANSWERS[] =     
-{   
-  answer_00, 
-  answer_01,
-  answer_02,
-  answer_03,
-  answer_04,
-  answer_05,
-  answer_06,
-  answer_07,
-  answer_08,
-  answer_09,
-  answer_10,
-  answer_11,
-  answer_12,
-  answer_13,
-  answer_14,
-  answer_15,
-  answer_16,
-  answer_17,
-  answer_18,
-  answer_19,
-  answer_20
-};
-
-
 /******************************************************************************
  * User API
  ******************************************************************************/
@@ -332,20 +218,18 @@ uint8_t arduPiLoRaWAN::OFF(uint8_t socket)
 uint8_t arduPiLoRaWAN::reset()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "sys reset" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[0])));
+  strcpy(_command, command_00);
 
   // create "RN2483" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[5])));
+  ans1 = (char*)answer_05;
   // create "RN2903" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[20])));
+  ans2 = (char*)answer_20;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,600);
@@ -381,19 +265,17 @@ uint8_t arduPiLoRaWAN::reset()
 uint8_t arduPiLoRaWAN::factoryReset()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "sys factoryRESET" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[1])));
+  strcpy(_command, command_01);
   // create "RN2483" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[5])));
+  ans1 = (char*)answer_05;
   // create "RN2903" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[20])));
+  ans2 = (char*)answer_20;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,5000);
@@ -428,16 +310,16 @@ uint8_t arduPiLoRaWAN::factoryReset()
  */
 uint8_t arduPiLoRaWAN::getEUI()
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "sys get hweui" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[2])));
+  strcpy(_command, command_02);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -448,7 +330,7 @@ uint8_t arduPiLoRaWAN::getEUI()
   }
   else if (status == 1)
   {   
-    char* pch = strtok((char*)_buffer,"\r\n");
+    char* pch = strtok_r((char*)_buffer,"\r\n", &saveptr);
     if (pch != NULL)
     {
       memset(_eui,0x00,sizeof(_eui));
@@ -477,16 +359,16 @@ uint8_t arduPiLoRaWAN::getEUI()
  */
 uint8_t arduPiLoRaWAN::getAddr()
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "sys get hweui" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[2])));
+  strcpy(_command, command_02);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -497,7 +379,7 @@ uint8_t arduPiLoRaWAN::getAddr()
   }
   else if (status == 1)
   {   
-    char* pch = strtok((char*)_buffer,"\r\n");
+    char* pch = strtok_r((char*)_buffer,"\r\n", &saveptr);
     if (pch != NULL)
     {
       memset(_devAddr,0x00,sizeof(_devAddr));
@@ -527,15 +409,14 @@ uint8_t arduPiLoRaWAN::getAddr()
 uint8_t arduPiLoRaWAN::getSupplyPower()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "sys get vdd" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[3])));
+  strcpy(_command, command_03);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -573,23 +454,20 @@ uint8_t arduPiLoRaWAN::getSupplyPower()
 uint8_t arduPiLoRaWAN::check()
 { 
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
 
   // create "sys get ver" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[68])));
+  strcpy(_command, command_68);
   // create "RN2483" command
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[5])));
+  ans1 = (char*)answer_05;
   // create "RN2903" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[20])));
+  ans2 = (char*)answer_20;
   // create "invalid_param" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans3 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,1000);
@@ -637,12 +515,10 @@ uint8_t arduPiLoRaWAN::check()
 uint8_t arduPiLoRaWAN::resetMacConfig(char* band)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   if ((strcmp(band, "433")) && (strcmp(band, "868")) && (strcmp(band, "900")))
   {
@@ -653,11 +529,11 @@ uint8_t arduPiLoRaWAN::resetMacConfig(char* band)
   {
 
     // create "mac reset" command
-    sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[80])));
+    strcpy(_command, command_80);
     // create "ok" answer
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+    ans1 = (char*)answer_00;
     // create "invalid_param" answer
-    sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+    ans2 = (char*)answer_01;
 
     //send command and wait for ans
     status = sendCommand(_command,ans1,ans2,1000);
@@ -678,11 +554,14 @@ uint8_t arduPiLoRaWAN::resetMacConfig(char* band)
   }
 
   // create "mac reset" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[4])), band);
+  if (snprintf(_command, sizeof(_command),command_04, band) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,1000);
@@ -743,31 +622,26 @@ uint8_t arduPiLoRaWAN::setDeviceEUI()
 uint8_t arduPiLoRaWAN::setDeviceEUI(char* eui)
 {
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // check eui length
   if (strlen(eui)!=16) return LORAWAN_INPUT_ERROR;
 
   // check if eui is a hexadecimal string
-  for (uint8_t i=0;i<16;i++)
-  {
-    if (((eui[i] < 0x30) || (eui[i] > 0x39)) && ((eui[i] < 0x41) || (eui[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  if (Utils.hexSpan(eui, 16) != 16) return LORAWAN_INPUT_ERROR;
 
   // create "mac set deveui" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[12])), eui);
+  if (snprintf(_command, sizeof(_command),command_12, eui) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -799,16 +673,16 @@ uint8_t arduPiLoRaWAN::setDeviceEUI(char* eui)
  */
 uint8_t arduPiLoRaWAN::getDeviceEUI()
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get deveui" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[25])));
+  strcpy(_command, command_25);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -819,7 +693,7 @@ uint8_t arduPiLoRaWAN::getDeviceEUI()
   }
   else if (status == 1)
   {   
-    char* pch = strtok((char*)_buffer,"\r\n");
+    char* pch = strtok_r((char*)_buffer,"\r\n", &saveptr);
     if (pch != NULL)
     {
       memset(_devEUI,0x00,sizeof(_devEUI));
@@ -873,31 +747,26 @@ uint8_t arduPiLoRaWAN::setDeviceAddr()
 uint8_t arduPiLoRaWAN::setDeviceAddr(char* addr)
 {
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // check addr length
   if (strlen(addr)!=8) return LORAWAN_INPUT_ERROR;
 
   // check if addr is a hexadecimal string
-  for (uint8_t i=0;i<8;i++)
-  {
-    if (((addr[i] < 0x30) || (addr[i] > 0x39)) && ((addr[i] < 0x41) || (addr[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  if (Utils.hexSpan(addr, 8) != 8) return LORAWAN_INPUT_ERROR;
 
   // create "mac set devaddr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[11])), addr);
+  if (snprintf(_command, sizeof(_command),command_11, addr) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -930,16 +799,16 @@ uint8_t arduPiLoRaWAN::setDeviceAddr(char* addr)
  */
 uint8_t arduPiLoRaWAN::getDeviceAddr()
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get devaddr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[24])));
+  strcpy(_command, command_24);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -950,7 +819,7 @@ uint8_t arduPiLoRaWAN::getDeviceAddr()
   }
   else if (status == 1)
   {   
-    char* pch = strtok((char*)_buffer,"\r\n");
+    char* pch = strtok_r((char*)_buffer,"\r\n", &saveptr);
     if (pch != NULL)
     {
       memset(_devAddr,0x00,sizeof(_devAddr));
@@ -988,31 +857,26 @@ uint8_t arduPiLoRaWAN::getDeviceAddr()
 uint8_t arduPiLoRaWAN::setNwkSessionKey(char* key)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // check key length
   if (strlen(key)!=32) return LORAWAN_INPUT_ERROR;
 
   // check if key is a hexadecimal string
-  for (uint8_t i=0;i<32;i++)
-  {
-    if (((key[i] < 0x30) || (key[i] > 0x39)) && ((key[i] < 0x41) || (key[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  if (Utils.hexSpan(key, 32) != 32) return LORAWAN_INPUT_ERROR;
 
   // create "mac set nwkskey" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[14])), key);
+  if (snprintf(_command, sizeof(_command),command_14, key) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -1053,31 +917,26 @@ uint8_t arduPiLoRaWAN::setNwkSessionKey(char* key)
 uint8_t arduPiLoRaWAN::setAppEUI(char* eui)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // check eui length
   if (strlen(eui)!=16) return LORAWAN_INPUT_ERROR;
 
   //check if eui is a hexadecimal string
-  for (uint8_t i=0;i<16;i++)
-  {
-    if (((eui[i] < 0x30) || (eui[i] > 0x39)) && ((eui[i] < 0x41) || (eui[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  if (Utils.hexSpan(eui, 16) != 16) return LORAWAN_INPUT_ERROR;
 
   // create "mac set appeui" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[13])), eui);
+  if (snprintf(_command, sizeof(_command),command_13, eui) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -1110,16 +969,16 @@ uint8_t arduPiLoRaWAN::setAppEUI(char* eui)
  */
 uint8_t arduPiLoRaWAN::getAppEUI()
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get appeui" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[26])));
+  strcpy(_command, command_26);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -1130,7 +989,7 @@ uint8_t arduPiLoRaWAN::getAppEUI()
   }
   else if(status == 1)
   {   
-    char* pch = strtok((char*)_buffer,"\r\n");
+    char* pch = strtok_r((char*)_buffer,"\r\n", &saveptr);
     if (pch != NULL)
     {
       memset(_appEUI,0x00,sizeof(_appEUI));
@@ -1167,31 +1026,26 @@ uint8_t arduPiLoRaWAN::getAppEUI()
 uint8_t arduPiLoRaWAN::setAppKey(char* key)
 {
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // check key length
   if (strlen(key)!=32) return LORAWAN_INPUT_ERROR;
 
   //check if key is a hexadecimal string
-  for (uint8_t i=0;i<32;i++)
-  {
-    if (((key[i] < 0x30) || (key[i] > 0x39)) && ((key[i] < 0x41) || (key[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  if (Utils.hexSpan(key, 32) != 32) return LORAWAN_INPUT_ERROR;
 
   // create "mac set appkey" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[16])), key);
+  if (snprintf(_command, sizeof(_command),command_16, key) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -1233,31 +1087,26 @@ uint8_t arduPiLoRaWAN::setAppKey(char* key)
 uint8_t arduPiLoRaWAN::setAppSessionKey(char* key)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // check key length
   if (strlen(key)!=32) return LORAWAN_INPUT_ERROR;
 
   // check if key is a hexadecimal string
-  for (uint8_t i=0;i<32;i++)
-  {
-    if (((key[i] < 0x30) || (key[i] > 0x39)) && ((key[i] < 0x41) || (key[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  if (Utils.hexSpan(key, 32) != 32) return LORAWAN_INPUT_ERROR;
 
   // create "mac set appskey" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[15])), key);
+  if (snprintf(_command, sizeof(_command),command_15, key) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -1305,12 +1154,10 @@ uint8_t arduPiLoRaWAN::setAppSessionKey(char* key)
 uint8_t arduPiLoRaWAN::setPower(uint8_t index)
 {
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   switch (_version)
   {
@@ -1339,11 +1186,14 @@ uint8_t arduPiLoRaWAN::setPower(uint8_t index)
   }
 
   // create "mac set pwrindx" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[17])), index);
+  if (snprintf(_command, sizeof(_command),command_17, index) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -1371,15 +1221,14 @@ uint8_t arduPiLoRaWAN::setPower(uint8_t index)
 uint8_t arduPiLoRaWAN::getPower()
 {
   uint8_t status; 
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get pwrindx" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[29])));
+  strcpy(_command, command_29);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,100);
@@ -1432,12 +1281,10 @@ uint8_t arduPiLoRaWAN::getPower()
 uint8_t arduPiLoRaWAN::setDataRate(uint8_t datarate)
 {
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   switch (_version)
   {
@@ -1454,11 +1301,14 @@ uint8_t arduPiLoRaWAN::setDataRate(uint8_t datarate)
   }
 
   // create "mac set dr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[18])), datarate);
+  if (snprintf(_command, sizeof(_command),command_18, datarate) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -1491,15 +1341,14 @@ uint8_t arduPiLoRaWAN::setDataRate(uint8_t datarate)
 uint8_t arduPiLoRaWAN::getDataRate()
 {
   uint8_t status; 
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get dr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[27])));
+  strcpy(_command, command_27);
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,100);
@@ -1532,19 +1381,17 @@ uint8_t arduPiLoRaWAN::getDataRate()
 uint8_t arduPiLoRaWAN::saveConfig()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "mac save" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[8])));
+  strcpy(_command, command_08);
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,4000);
@@ -1576,32 +1423,28 @@ uint8_t arduPiLoRaWAN::saveConfig()
 uint8_t arduPiLoRaWAN::joinABP()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
 
   // create "mac join abp" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[7])));
+  strcpy(_command, command_07);
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   // create "keys_not_init" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[17])));
+  ans3 = (char*)answer_17;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,500);
 
   if (status == 1)
   {
-    memset(ans1,0x00,sizeof(ans1));
     // create "accepted" answer
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[6])));
+    ans1 = (char*)answer_06;
 
     //wait for response
     if (waitFor(ans1,800) == 1)
@@ -1640,35 +1483,30 @@ uint8_t arduPiLoRaWAN::joinABP()
 uint8_t arduPiLoRaWAN::joinOTAA()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
 
   // create "mac join otaa" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[76])));
+  strcpy(_command, command_76);
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   // create "keys_not_init" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[17])));
+  ans3 = (char*)answer_17;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,500);
 
   if (status == 1)
   {
-    memset(ans1,0x00,sizeof(ans1));
     // create "accepted" answer
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[6])));
-    memset(ans2,0x00,sizeof(ans2));
+    ans1 = (char*)answer_06;
     // create "denied" answer
-    sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[19])));
+    ans2 = (char*)answer_19;
 
     //wait for response
     if (waitFor(ans1,ans2,20000) == 1)
@@ -1719,41 +1557,38 @@ uint8_t arduPiLoRaWAN::joinOTAA()
  */
 uint8_t arduPiLoRaWAN::sendConfirmed(uint8_t port, char* payload)
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[20];
-  char ans2[20];
-  char ans3[20];
-  char ans4[20];
+  uint16_t length;
+  char* ans1;
+  char* ans2;
+  char* ans3;
+  char* ans4;
 
   // clear data received flag
   _dataReceived = false;
 
   // clear buffers
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
 
   // check port
   if (port > 223) return LORAWAN_INPUT_ERROR;
 
   // check if payload is a hexadecimal string
-  for (uint8_t i=0;i<strlen(payload);i++)
-  {
-    if (((payload[i] < 0x30) || (payload[i] > 0x39)) && ((payload[i] < 0x41) || (payload[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  length = strlen(payload);
+  if (Utils.hexSpan(payload, length) != length) return LORAWAN_INPUT_ERROR;
 
   // create "mac tx cnf <port> <data>" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[5])),port,payload);
+  if (snprintf(_command, sizeof(_command),command_05,port,payload) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   // create "not_joined" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[18])));
+  ans3 = (char*)answer_18;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,1000);
@@ -1761,19 +1596,15 @@ uint8_t arduPiLoRaWAN::sendConfirmed(uint8_t port, char* payload)
   if (status == 1)
   {
     // clear buffer
-    memset(ans1,0x00,sizeof(ans1));
-    memset(ans2,0x00,sizeof(ans2));
-    memset(ans3,0x00,sizeof(ans3));
-    memset(ans4,0x00,sizeof(ans4));
 
     // mac_rx
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[3])));
+    ans1 = (char*)answer_03;
     // mac_tx_ok
-    strcpy(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[8])));
+    ans2 = (char*)answer_08;
     // mac_err
-    strcpy(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[15])));
+    ans3 = (char*)answer_15;
     // invalid_data_len
-    strcpy(ans4,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[16])));
+    ans4 = (char*)answer_16;
 
     //wait for response
     status = waitFor(ans1, ans2, ans3, ans4, 180000);
@@ -1783,9 +1614,9 @@ uint8_t arduPiLoRaWAN::sendConfirmed(uint8_t port, char* payload)
       waitFor((char*)"\r\n",500);
       if (_length > 0)
       {
-        char* pch = strtok((char*) _buffer,(char*)" \r\n");
+        char* pch = strtok_r((char*) _buffer,(char*)" \r\n", &saveptr);
         _port = atoi(pch);
-        pch = strtok(NULL,(char*)" \r\n");
+        pch = strtok_r(NULL,(char*)" \r\n", &saveptr);
 
         while (pch != NULL)
         {
@@ -1868,40 +1699,37 @@ uint8_t arduPiLoRaWAN::sendConfirmed(uint8_t port, char* payload)
  */
 uint8_t arduPiLoRaWAN::sendUnconfirmed(uint8_t port, char* payload)
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[20];
-  char ans2[20];
-  char ans3[20];
-  char ans4[20];
+  uint16_t length;
+  char* ans1;
+  char* ans2;
+  char* ans3;
+  char* ans4;
 
   // clear data received flag
   _dataReceived = false;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
 
   // check port
   if (port > 223) return LORAWAN_INPUT_ERROR;
 
   // check if payload is a hexadecimal string
-  for (uint8_t i=0;i<strlen(payload);i++)
-  {
-    if (((payload[i] < 0x30) || (payload[i] > 0x39)) && ((payload[i] < 0x41) || (payload[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
-  }
+  length = strlen(payload);
+  if (Utils.hexSpan(payload, length) != length) return LORAWAN_INPUT_ERROR;
 
   // create "mac tx uncnf <port> <data>" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[6])),port,payload);
+  if (snprintf(_command, sizeof(_command),command_06,port,payload) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   // create "not_joined" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[18])));
+  ans3 = (char*)answer_18;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,500);
@@ -1909,19 +1737,15 @@ uint8_t arduPiLoRaWAN::sendUnconfirmed(uint8_t port, char* payload)
   if (status == 1)
   {
     // clear buffer
-    memset(ans1,0x00,sizeof(ans1));
-    memset(ans2,0x00,sizeof(ans2));
-    memset(ans3,0x00,sizeof(ans3));
-    memset(ans4,0x00,sizeof(ans4));
       
     // mac_rx <port>
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[3])));
+    ans1 = (char*)answer_03;
     // mac_tx_ok
-    sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[8])));
+    ans2 = (char*)answer_08;
     // mac_err
-    sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[15])));
+    ans3 = (char*)answer_15;
     // invalid_data_len
-    sprintf(ans4,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[16])));
+    ans4 = (char*)answer_16;
     
     //wait for response
     status = waitFor(ans1, ans2, ans3, ans4, 20000);
@@ -1932,10 +1756,10 @@ uint8_t arduPiLoRaWAN::sendUnconfirmed(uint8_t port, char* payload)
 
       if (_length > 0)
       {
-        char* pch = strtok((char*) _buffer," \r\n");
+        char* pch = strtok_r((char*) _buffer," \r\n", &saveptr);
         _port = atoi(pch);
 
-        pch = strtok(NULL," \r\n");
+        pch = strtok_r(NULL," \r\n", &saveptr);
 
         memset(_data,0x00,sizeof(_data));
         strncpy(_data, pch, sizeof(_data)-1);
@@ -2004,22 +1828,23 @@ uint8_t arduPiLoRaWAN::sendUnconfirmed(uint8_t port, char* payload)
 uint8_t arduPiLoRaWAN::setADR(char* state)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   // check state
   if ((strcmp(state, "on")) && (strcmp(state, "off"))) return LORAWAN_INPUT_ERROR;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "mac set adr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[19])),state);
+  if (snprintf(_command, sizeof(_command),command_19,state) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -2053,21 +1878,18 @@ uint8_t arduPiLoRaWAN::setADR(char* state)
 uint8_t arduPiLoRaWAN::getADR()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
   
   // create "mac get adr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[30])));
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[9])));
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[10])));
+  strcpy(_command, command_30);
+  ans1 = (char*)answer_09;
+  ans2 = (char*)answer_10;
   // create "invalid_param" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans3 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,500);
@@ -2105,15 +1927,14 @@ uint8_t arduPiLoRaWAN::getADR()
 uint8_t arduPiLoRaWAN::getDutyCyclePrescaler()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get dcycle" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[31])));
+  strcpy(_command, command_31);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -2149,19 +1970,17 @@ uint8_t arduPiLoRaWAN::getDutyCyclePrescaler()
 uint8_t arduPiLoRaWAN::macPause()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "mac pause" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[9])));
+  strcpy(_command, command_09);
   // create "4294967245" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[14])));
+  ans1 = (char*)answer_14;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -2191,19 +2010,17 @@ uint8_t arduPiLoRaWAN::macPause()
 uint8_t arduPiLoRaWAN::macResume()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "mac resume" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[10])));
+  strcpy(_command, command_10);
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -2240,8 +2057,8 @@ uint8_t arduPiLoRaWAN::macResume()
 uint8_t arduPiLoRaWAN::setChannelFreq(uint8_t channel, uint32_t freq)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   //check module (this function is only available for RN2483)
   if (_version == RN2903_MODULE)
@@ -2259,15 +2076,16 @@ uint8_t arduPiLoRaWAN::setChannelFreq(uint8_t channel, uint32_t freq)
 
   // clear buffers
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "mac set ch freq" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[20])),channel,freq);
+  if (snprintf(_command, sizeof(_command),command_20,channel,(unsigned long)freq) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -2304,10 +2122,9 @@ uint8_t arduPiLoRaWAN::setChannelFreq(uint8_t channel, uint32_t freq)
 uint8_t arduPiLoRaWAN::getChannelFreq(uint8_t channel)
 {
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
 
   switch (_version)
   {
@@ -2330,9 +2147,12 @@ uint8_t arduPiLoRaWAN::getChannelFreq(uint8_t channel)
   }
 
   // create "mac get ch freq" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[35])),channel);
+  if (snprintf(_command, sizeof(_command),command_35,channel) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -2375,12 +2195,10 @@ uint8_t arduPiLoRaWAN::setChannelDutyCycle(uint8_t channel, uint16_t dcycle)
 {
   uint8_t status;
   float dutycycle;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   //check module (this function is only available for RN2483)
   if (_version == RN2903_MODULE)
@@ -2392,11 +2210,14 @@ uint8_t arduPiLoRaWAN::setChannelDutyCycle(uint8_t channel, uint16_t dcycle)
   if (channel > 15) return LORAWAN_INPUT_ERROR;
 
   // create "mac set ch dcycle" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[21])),channel,dcycle);
+  if (snprintf(_command, sizeof(_command),command_21,channel,dcycle) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2);
@@ -2435,10 +2256,9 @@ uint8_t arduPiLoRaWAN::setChannelDutyCycle(uint8_t channel, uint16_t dcycle)
 uint8_t arduPiLoRaWAN::getChannelDutyCycle(uint8_t channel)
 {
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
 
   //check module (this function is only available for RN2483)
   if (_version == RN2903_MODULE)
@@ -2450,9 +2270,12 @@ uint8_t arduPiLoRaWAN::getChannelDutyCycle(uint8_t channel)
   if (channel > 15) return LORAWAN_INPUT_ERROR;
 
   // create "mac get ch dcycle" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[36])),channel);
+  if (snprintf(_command, sizeof(_command),command_36,channel) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -2500,12 +2323,10 @@ uint8_t arduPiLoRaWAN::getChannelDutyCycle(uint8_t channel)
 uint8_t arduPiLoRaWAN::setChannelDRRange(uint8_t channel, uint8_t minDR, uint8_t maxDR)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   switch (_version)
   {
@@ -2528,11 +2349,14 @@ uint8_t arduPiLoRaWAN::setChannelDRRange(uint8_t channel, uint8_t minDR, uint8_t
   }
 
   // create "mac set ch drrange" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[22])),channel,minDR,maxDR);
+  if (snprintf(_command, sizeof(_command),command_22,channel,minDR,maxDR) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -2569,11 +2393,11 @@ uint8_t arduPiLoRaWAN::setChannelDRRange(uint8_t channel, uint8_t minDR, uint8_t
  */
 uint8_t arduPiLoRaWAN::getChannelDRRange(uint8_t channel)
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   switch (_version)
   {
@@ -2596,9 +2420,12 @@ uint8_t arduPiLoRaWAN::getChannelDRRange(uint8_t channel)
   }
 
   // create "mac get ch drrange" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[37])),channel);
+  if (snprintf(_command, sizeof(_command),command_37,channel) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -2606,15 +2433,15 @@ uint8_t arduPiLoRaWAN::getChannelDRRange(uint8_t channel)
   if (status == 1)
   {
     char * pch; 
-    pch = strtok((char*) _buffer," \r\n");
+    pch = strtok_r((char*) _buffer," \r\n", &saveptr);
     if (pch != NULL)
     {
       _drrMin[channel] = strtoul(pch,NULL, 10);
-      pch = strtok(NULL," \r\n");
+      pch = strtok_r(NULL," \r\n", &saveptr);
       if (pch != NULL)
       {
         _drrMax[channel] = strtoul(pch,NULL, 10);
-        pch = strtok(pch," \r\n");
+        pch = strtok_r(pch," \r\n", &saveptr);
         return LORAWAN_ANSWER_OK;
       }
       return LORAWAN_ANSWER_ERROR;
@@ -2648,12 +2475,10 @@ uint8_t arduPiLoRaWAN::getChannelDRRange(uint8_t channel)
 uint8_t arduPiLoRaWAN::setChannelStatus(uint8_t channel, char* state)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // check state
   if ((strcmp(state, "on")) && (strcmp(state, "off"))) return LORAWAN_INPUT_ERROR;
@@ -2678,15 +2503,15 @@ uint8_t arduPiLoRaWAN::setChannelStatus(uint8_t channel, char* state)
         return LORAWAN_VERSION_ERROR;
   }
 
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-
   // create "mac set ch state" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[23])),channel,state);
+  if (snprintf(_command, sizeof(_command),command_23,channel,state) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -2723,14 +2548,11 @@ uint8_t arduPiLoRaWAN::setChannelStatus(uint8_t channel, char* state)
 uint8_t arduPiLoRaWAN::getChannelStatus(uint8_t channel)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
 
   switch (_version)
   {
@@ -2753,13 +2575,16 @@ uint8_t arduPiLoRaWAN::getChannelStatus(uint8_t channel)
   }
 
   // create "mac get ch status" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[38])),channel);
+  if (snprintf(_command, sizeof(_command),command_38,channel) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "on" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[9])));
+  ans1 = (char*)answer_09;
   // create "off" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[10])));
+  ans2 = (char*)answer_10;
   // create "invalid_param" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans3 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,500);
@@ -2799,19 +2624,20 @@ uint8_t arduPiLoRaWAN::getChannelStatus(uint8_t channel)
 uint8_t arduPiLoRaWAN::setRetries(uint8_t retries)
 {
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "mac set retx" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[69])),retries);
+  if (snprintf(_command, sizeof(_command),command_69,retries) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,100);
@@ -2843,15 +2669,14 @@ uint8_t arduPiLoRaWAN::setRetries(uint8_t retries)
 uint8_t arduPiLoRaWAN::getRetries()
 {
   uint8_t status; 
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get retx" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[70])));
+  strcpy(_command, command_70);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,100);
@@ -2888,10 +2713,9 @@ uint8_t arduPiLoRaWAN::getRetries()
 uint8_t arduPiLoRaWAN::getBand()
 {
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
 
   //check module (this function is only available for RN2483)
   if (_version == RN2903_MODULE)
@@ -2900,9 +2724,9 @@ uint8_t arduPiLoRaWAN::getBand()
   }
 
   // create "mac get band" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[28])));
+  strcpy(_command, command_28);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -2935,15 +2759,14 @@ uint8_t arduPiLoRaWAN::getBand()
 uint8_t arduPiLoRaWAN::getMargin()
 {
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get mrgn" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[32])));
+  strcpy(_command, command_32);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -2976,15 +2799,14 @@ uint8_t arduPiLoRaWAN::getMargin()
 uint8_t arduPiLoRaWAN::getGatewayNumber()
 {
   uint8_t status;
-  char ans1[50];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "mac get gwnb" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[33])));
+  strcpy(_command, command_33);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,300);
@@ -3019,19 +2841,20 @@ uint8_t arduPiLoRaWAN::getGatewayNumber()
 uint8_t arduPiLoRaWAN::setUpCounter(uint32_t counter)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "mac set upctr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[72])),counter);
+  if (snprintf(_command, sizeof(_command),command_72,(unsigned long)counter) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -3065,15 +2888,14 @@ uint8_t arduPiLoRaWAN::setUpCounter(uint32_t counter)
 uint8_t arduPiLoRaWAN::getUpCounter()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
 
   // create "mac get upctr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[73])));
+  strcpy(_command, command_73);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,100);
@@ -3108,19 +2930,20 @@ uint8_t arduPiLoRaWAN::getUpCounter()
 uint8_t arduPiLoRaWAN::setDownCounter(uint32_t counter)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "mac set dnctr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[74])),counter);
+  if (snprintf(_command, sizeof(_command),command_74,(unsigned long)counter) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -3155,19 +2978,20 @@ uint8_t arduPiLoRaWAN::setDownCounter(uint32_t counter)
 uint8_t arduPiLoRaWAN::setLinkCheck(uint16_t time)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "mac set dnctr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[77])),time);
+  if (snprintf(_command, sizeof(_command),command_77,time) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -3199,15 +3023,14 @@ uint8_t arduPiLoRaWAN::setLinkCheck(uint16_t time)
 uint8_t arduPiLoRaWAN::getDownCounter()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
 
   // create "mac get dnctr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[75])));
+  strcpy(_command, command_75);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,100);
@@ -3252,42 +3075,37 @@ uint8_t arduPiLoRaWAN::getDownCounter()
  */
 uint8_t arduPiLoRaWAN::sendRadio(char * message)
 { 
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   uint8_t status;
+  uint16_t length;
   
   // clear buffers
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // check if payload is a hexadecimal string
-  for (uint8_t i=0;i<strlen(message);i++)
+  length = strlen(message);
+  if (Utils.hexSpan(message, length) != length) return LORAWAN_INPUT_ERROR;
+
+  if (snprintf(_command, sizeof(_command),command_40, message) >= (int)sizeof(_command))
   {
-    if (((message[i] < 0x30) || (message[i] > 0x39)) && ((message[i] < 0x41) || (message[i] > 0x46)))
-    {
-      return LORAWAN_INPUT_ERROR;
-    }
+    return LORAWAN_ANSWER_ERROR;
   }
-
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[40])), message);
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,600);
 
   if (status == 1)
   {
-    memset(ans1,0x00,sizeof(ans1));
-    memset(ans2,0x00,sizeof(ans2));
     
     // create "radio_tx_ok" answer
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[4])));
+    ans1 = (char*)answer_04;
     // create "radio_err" answer
-    sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[12])));
+    ans2 = (char*)answer_12;
     
     //wait for response
     status = waitFor(ans1,ans2,3000);
@@ -3332,9 +3150,9 @@ uint8_t arduPiLoRaWAN::receiveRadio(uint32_t timeout)
 {
   uint8_t error;  
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
     
   //set watch dog radio to timeout
   error = setRadioWDT(timeout);
@@ -3342,30 +3160,26 @@ uint8_t arduPiLoRaWAN::receiveRadio(uint32_t timeout)
   {
     //start radio receiving
     memset(_command,0x00,sizeof(_command));
-    memset(ans1,0x00,sizeof(ans1));
-    memset(ans2,0x00,sizeof(ans2));
     
     // create "radio rx" command
-    sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[39])));
+    strcpy(_command, command_39);
     // create "ok" answer
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+    ans1 = (char*)answer_00;
     // create "invalid_param" answer
-    sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+    ans2 = (char*)answer_01;
     
     //send command and wait for ans
     status = sendCommand(_command,ans1,ans2,100);
     
     if (status == 1)
     {
-      memset(ans1,0x00,sizeof(ans1));
-      memset(ans2,0x00,sizeof(ans2));
       
       // create "radio_rx  " answer
-      sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[7])));
+      ans1 = (char*)answer_07;
       // create "\r\n" answer
-      sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[13])));
+      ans2 = (char*)answer_13;
       // create "radio_err" answer
-      sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[12])));
+      ans3 = (char*)answer_12;
       
       //wait for response
       status = waitFor(ans1,ans3,timeout);
@@ -3403,18 +3217,16 @@ uint8_t arduPiLoRaWAN::receiveRadio(uint32_t timeout)
 uint8_t arduPiLoRaWAN::test_ON()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[41])));
+  strcpy(_command, command_41);
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2);
@@ -3447,23 +3259,20 @@ uint8_t arduPiLoRaWAN::test_ON()
 uint8_t arduPiLoRaWAN::test_OFF()
 {
   uint8_t status; 
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
 
   // create "radio cw off" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[42])));
+  strcpy(_command, command_42);
   // create "RN2483" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[5])));
+  ans1 = (char*)answer_05;
   // create "RN2903" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[20])));
+  ans2 = (char*)answer_20;
   // create "invalid_param" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans3 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3);
@@ -3501,16 +3310,15 @@ uint8_t arduPiLoRaWAN::test_OFF()
 uint8_t arduPiLoRaWAN::getRadioSNR()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get snr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[65])));
+  strcpy(_command, command_65);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -3551,19 +3359,20 @@ uint8_t arduPiLoRaWAN::getRadioSNR()
 uint8_t arduPiLoRaWAN::setRadioSF(char* sprfact)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "radio set sf" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[46])),sprfact);
+  if (snprintf(_command, sizeof(_command),command_46,sprfact) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -3596,15 +3405,14 @@ uint8_t arduPiLoRaWAN::setRadioSF(char* sprfact)
 uint8_t arduPiLoRaWAN::getRadioSF()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get sf" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[59])));
+  strcpy(_command, command_59);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -3642,13 +3450,11 @@ uint8_t arduPiLoRaWAN::getRadioSF()
 uint8_t arduPiLoRaWAN::setRadioPower(int8_t pwr)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   // create "radio set pwr" command
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   switch (_version)
   {
@@ -3664,11 +3470,14 @@ uint8_t arduPiLoRaWAN::setRadioPower(int8_t pwr)
         return LORAWAN_VERSION_ERROR;
   }
 
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[45])),pwr);
+  if (snprintf(_command, sizeof(_command),command_45,pwr) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -3700,15 +3509,14 @@ uint8_t arduPiLoRaWAN::setRadioPower(int8_t pwr)
 uint8_t arduPiLoRaWAN::getRadioPower()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get pwr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[58])));
+  strcpy(_command, command_58);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -3742,19 +3550,20 @@ uint8_t arduPiLoRaWAN::getRadioPower()
 uint8_t arduPiLoRaWAN::setRadioMode(char* mode)
 {
   uint8_t status;
-  char ans1[50];
-  char ans2[50];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "radio set mod" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[43])),mode);
+  if (snprintf(_command, sizeof(_command),command_43,mode) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,300);
@@ -3788,15 +3597,14 @@ uint8_t arduPiLoRaWAN::setRadioMode(char* mode)
 uint8_t arduPiLoRaWAN::getRadioMode()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get mod" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[56])));
+  strcpy(_command, command_56);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -3834,8 +3642,8 @@ uint8_t arduPiLoRaWAN::getRadioMode()
 uint8_t arduPiLoRaWAN::setRadioFreq(uint32_t freq)
 {
   uint8_t status;
-  char ans1[50];
-  char ans2[50];
+  char* ans1;
+  char* ans2;
 
   switch (_version)
   {
@@ -3854,15 +3662,16 @@ uint8_t arduPiLoRaWAN::setRadioFreq(uint32_t freq)
   }
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "radio set freq" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[44])),freq);
+  if (snprintf(_command, sizeof(_command),command_44,(unsigned long)freq) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -3896,15 +3705,14 @@ uint8_t arduPiLoRaWAN::setRadioFreq(uint32_t freq)
 uint8_t arduPiLoRaWAN::getRadioFreq()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get freq" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[57])));
+  strcpy(_command, command_57);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -3938,36 +3746,44 @@ uint8_t arduPiLoRaWAN::getRadioFreq()
  */
 uint8_t arduPiLoRaWAN::setRadioReceivingBW(float bandwidth)
 {
+  char* saveptr;
   uint8_t status;
   char bandw[6];
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   char integer[4];
   char decimal[4];
 
   memset(_command,0x00,sizeof(_command));
   memset(bandw,0x00,sizeof(bandw));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   memset(integer,0x00,sizeof(integer));
   memset(decimal,0x00,sizeof(decimal));
 
   //dtostrf (bandwidth,NULL,1,bandw);
-        Utils.float2String (bandwidth, bandw, 1);
+  Utils.formatFloat(bandwidth, 1, bandw, sizeof(bandw));
 
-  char* pch = strtok(bandw,".\r\n");
-  snprintf(integer, sizeof(integer), "%s",pch);
-  pch = strtok(NULL,"\r\n");
-  snprintf(decimal, sizeof(decimal), "%s",pch);
+  char* pch = strtok_r(bandw,".\r\n", &saveptr);
+  if (snprintf(integer, sizeof(integer), "%s",pch) >= (int)sizeof(integer))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
+  pch = strtok_r(NULL,"\r\n", &saveptr);
+  if (snprintf(decimal, sizeof(decimal), "%s",pch) >= (int)sizeof(decimal))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   
   if (decimal == "0")
   {
     // create "radio set rxbw" command
-    sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[47])),integer);
+    if (snprintf(_command, sizeof(_command),command_47,integer) >= (int)sizeof(_command))
+    {
+      return LORAWAN_ANSWER_ERROR;
+    }
     // create "ok" answer
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+    ans1 = (char*)answer_00;
     // create "invalid_param" answer
-    sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+    ans2 = (char*)answer_01;
     
     //send command and wait for ans
     status = sendCommand(_command,ans1,ans2,500);
@@ -3975,11 +3791,14 @@ uint8_t arduPiLoRaWAN::setRadioReceivingBW(float bandwidth)
   else
   { 
     // create "radio set rxbw" command
-    sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[48])),integer,decimal);
+    if (snprintf(_command, sizeof(_command),command_48,integer,decimal) >= (int)sizeof(_command))
+    {
+      return LORAWAN_ANSWER_ERROR;
+    }
     // create "ok" answer
-    sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+    ans1 = (char*)answer_00;
     // create "invalid_param" answer
-    sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+    ans2 = (char*)answer_01;
     
     //send command and wait for ans
     status = sendCommand(_command,ans1,ans2,500);
@@ -4013,15 +3832,14 @@ uint8_t arduPiLoRaWAN::setRadioReceivingBW(float bandwidth)
 uint8_t arduPiLoRaWAN::getRadioReceivingBW()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get rxbw" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[60])));
+  strcpy(_command, command_60);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -4056,22 +3874,23 @@ uint8_t arduPiLoRaWAN::getRadioReceivingBW()
 uint8_t arduPiLoRaWAN::setRadioBitRateFSK(uint32_t bitrate)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   //check bit rate
   if ((bitrate > 300000)&&(bitrate < 1)) return LORAWAN_INPUT_ERROR;
 
   // create "radio set bitrate" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[49])),bitrate);
+  if (snprintf(_command, sizeof(_command),command_49,bitrate) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -4103,15 +3922,14 @@ uint8_t arduPiLoRaWAN::setRadioBitRateFSK(uint32_t bitrate)
 uint8_t arduPiLoRaWAN::getRadioBitRateFSK()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get bitrate" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[61])));
+  strcpy(_command, command_61);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -4146,22 +3964,23 @@ uint8_t arduPiLoRaWAN::getRadioBitRateFSK()
 uint8_t arduPiLoRaWAN::setRadioFreqDeviation(uint32_t freqdeviation)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   //check freqdeviation
   if (freqdeviation > 200000) return LORAWAN_INPUT_ERROR;
 
   // create "radio set fdev" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[50])),freqdeviation);
+  if (snprintf(_command, sizeof(_command),command_50,freqdeviation) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -4192,15 +4011,14 @@ uint8_t arduPiLoRaWAN::setRadioFreqDeviation(uint32_t freqdeviation)
 uint8_t arduPiLoRaWAN::getRadioFreqDeviation()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get fdev" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[66])));
+  strcpy(_command, command_66);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -4235,19 +4053,20 @@ uint8_t arduPiLoRaWAN::getRadioFreqDeviation()
 uint8_t arduPiLoRaWAN::setRadioCRC(char* state)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "radio set crc" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[52])),state);
+  if (snprintf(_command, sizeof(_command),command_52,state) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -4280,23 +4099,20 @@ uint8_t arduPiLoRaWAN::setRadioCRC(char* state)
 uint8_t arduPiLoRaWAN::getRadioCRC()
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
-  char ans3[15];
+  char* ans1;
+  char* ans2;
+  char* ans3;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
-  memset(ans3,0x00,sizeof(ans3));
   
   // create "radio get crc" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[66])));
+  strcpy(_command, command_66);
   // create "on" anwser
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[9])));
+  ans1 = (char*)answer_09;
   // create "off" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[10])));
+  ans2 = (char*)answer_10;
   // create "invalid_param" answer
-  sprintf(ans3,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans3 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,ans3,500);
@@ -4336,19 +4152,20 @@ uint8_t arduPiLoRaWAN::getRadioCRC()
 uint8_t arduPiLoRaWAN::setRadioPreamble(uint16_t length)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "radio set prlen" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[51])),length);
+  if (snprintf(_command, sizeof(_command),command_51,length) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -4381,15 +4198,14 @@ uint8_t arduPiLoRaWAN::setRadioPreamble(uint16_t length)
 uint8_t arduPiLoRaWAN::getRadioPreamble()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get prlen" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[67])));
+  strcpy(_command, command_67);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -4425,19 +4241,20 @@ uint8_t arduPiLoRaWAN::getRadioPreamble()
 uint8_t arduPiLoRaWAN::setRadioCR(char* codingrate)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "radio set cr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[53])),codingrate);
+  if (snprintf(_command, sizeof(_command),command_53,codingrate) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -4470,23 +4287,23 @@ uint8_t arduPiLoRaWAN::setRadioCR(char* codingrate)
  */
 uint8_t arduPiLoRaWAN::getRadioCR()
 {
+  char* saveptr;
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get cr" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[62])));
+  strcpy(_command, command_62);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,100);
   
   if (status == 1)
   {
-    char* pch = strtok((char*)_buffer,"\r\n");
+    char* pch = strtok_r((char*)_buffer,"\r\n", &saveptr);
     if (pch != NULL)
     {
       memset(_radioCR, 0x00, sizeof(_radioCR));
@@ -4523,19 +4340,20 @@ uint8_t arduPiLoRaWAN::getRadioCR()
 uint8_t arduPiLoRaWAN::setRadioWDT(uint32_t time)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
   
   // create "radio set wdt" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[54])),time);
+  if (snprintf(_command, sizeof(_command),command_54,(unsigned long)time) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -4568,15 +4386,14 @@ uint8_t arduPiLoRaWAN::setRadioWDT(uint32_t time)
 uint8_t arduPiLoRaWAN::getRadioWDT()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get wdt" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[63])));
+  strcpy(_command, command_63);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -4612,23 +4429,24 @@ uint8_t arduPiLoRaWAN::getRadioWDT()
 uint8_t arduPiLoRaWAN::setRadioBW(uint16_t bandwidth)
 {
   uint8_t status;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   //check bandwidth
   if ((bandwidth == 125) || (bandwidth == 250) || (bandwidth == 500)){}
   else return LORAWAN_INPUT_ERROR;
 
   // create "radio set bw" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[55])),bandwidth);
+  if (snprintf(_command, sizeof(_command),command_55,bandwidth) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2,500);
@@ -4662,15 +4480,14 @@ uint8_t arduPiLoRaWAN::setRadioBW(uint16_t bandwidth)
 uint8_t arduPiLoRaWAN::getRadioBW()
 {
   uint8_t status;
-  char ans1[15];
+  char* ans1;
   
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
   
   // create "radio get bw" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[64])));
+  strcpy(_command, command_64);
   // create "invalid_param" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans1 = (char*)answer_01;
   
   //send command and wait for ans
   status = sendCommand(_command,(char*)"\r\n",ans1,500);
@@ -4713,12 +4530,10 @@ uint8_t arduPiLoRaWAN::setRX2Parameters(uint8_t datarate, uint32_t frequency)
 {
   uint8_t status;
   float dutycycle;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   switch (_version)
   {
@@ -4742,11 +4557,14 @@ uint8_t arduPiLoRaWAN::setRX2Parameters(uint8_t datarate, uint32_t frequency)
   }
 
   // create "mac set rx2" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[78])),datarate,frequency);
+  if (snprintf(_command, sizeof(_command),command_78,datarate,(unsigned long)frequency) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2);
@@ -4786,19 +4604,20 @@ uint8_t arduPiLoRaWAN::setRX1Delay(uint16_t delay)
 {
   uint8_t status;
   float dutycycle;
-  char ans1[15];
-  char ans2[15];
+  char* ans1;
+  char* ans2;
 
   memset(_command,0x00,sizeof(_command));
-  memset(ans1,0x00,sizeof(ans1));
-  memset(ans2,0x00,sizeof(ans2));
 
   // create "mac set rx1delay" command
-  sprintf(_command,(char*)pgm_read_word(&(table_LoRaWAN_COMMANDS[79])),delay);
+  if (snprintf(_command, sizeof(_command),command_79,delay) >= (int)sizeof(_command))
+  {
+    return LORAWAN_ANSWER_ERROR;
+  }
   // create "ok" answer
-  sprintf(ans1,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[0])));
+  ans1 = (char*)answer_00;
   // create "invalid_param" answer
-  sprintf(ans2,(char*)pgm_read_word(&(table_LoRaWAN_ANSWERS[1])));
+  ans2 = (char*)answer_01;
 
   //send command and wait for ans
   status = sendCommand(_command,ans1,ans2);
@@ -4829,8 +4648,9 @@ uint8_t arduPiLoRaWAN::setRX1Delay(uint16_t delay)
  */
 uint32_t arduPiLoRaWAN::parseValue(uint8_t base)
 {
+  char* saveptr;
   char * pch;
-  pch = strtok((char*) _buffer," \r\n");
+  pch = strtok_r((char*) _buffer," \r\n", &saveptr);
   if (pch != NULL)
   {
     return strtoul((char*)pch,NULL, base);
@@ -4845,8 +4665,9 @@ uint32_t arduPiLoRaWAN::parseValue(uint8_t base)
  */     
 uint32_t arduPiLoRaWAN::parseIntValue()
 {
+  char* saveptr;
   char * pch; 
-  pch = strtok((char*) _buffer,"\r\n");
+  pch = strtok_r((char*) _buffer,"\r\n", &saveptr);
   if (pch != NULL)
   {
     return atol(pch);
@@ -4861,8 +4682,9 @@ uint32_t arduPiLoRaWAN::parseIntValue()
  */
 float arduPiLoRaWAN::parseFloatValue()
 {
+  char* saveptr;
   char * pch; 
-  pch = strtok((char*) _buffer,"\r\n");
+  pch = strtok_r((char*) _buffer,"\r\n", &saveptr);
   if (pch != NULL)
   {
     return atof(pch);
@@ -4874,4 +4696,4 @@ float arduPiLoRaWAN::parseFloatValue()
 
 
 // Preinstantiate Objects /////////////////////////////////////////////////////
-arduPiLoRaWAN LoRaWAN = arduPiLoRaWAN();
+arduPiLoRaWAN LoRaWAN;
@@ -197,8 +197,9 @@ void arduPiSigfox::generator(uint8_t type, int n, const char *cmdCode, ...)
  */
 uint32_t arduPiSigfox::parseHexValue()
 {
+    char* saveptr;
     char * pch; 
-    pch = strtok((char*) _buffer,"\r\nOKERROR");
+    pch = strtok_r((char*) _buffer,"\r\nOKERROR", &saveptr);
     if (pch != NULL)
     {
         return strtoul(pch, NULL, 16);
@@ -213,8 +214,9 @@ uint32_t arduPiSigfox::parseHexValue()
  */
 uint8_t arduPiSigfox::parseUint8Value()
 {
+    char* saveptr;
     char * pch; 
-    pch = strtok((char*) _buffer,"\r\nOKERROR");
+    pch = strtok_r((char*) _buffer,"\r\nOKERROR", &saveptr);
     if (pch != NULL)
     {
         return strtoul(pch, NULL, 10);
@@ -229,8 +231,9 @@ uint8_t arduPiSigfox::parseUint8Value()
  */
 uint32_t arduPiSigfox::parseUint32Value()
 {
+    char* saveptr;
     char * pch; 
-    pch = strtok((char*) _buffer,"\r\nOKERROR");
+    pch = strtok_r((char*) _buffer,"\r\nOKERROR", &saveptr);
     if (pch != NULL)
     {
         return strtoul(pch, NULL, 10);
@@ -391,7 +394,10 @@ uint8_t arduPiSigfox::setPower(uint8_t power)
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), "ATS302=%u\r", power);
+    if (snprintf(_command, sizeof(_command), "ATS302=%u\r", power) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     // 1. send command
     answer = sendCommand(_command, AT_OK, AT_ERROR, 1000);  
@@ -427,7 +433,7 @@ uint8_t arduPiSigfox::getPower()
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), "ATS302?\r");
+    strcpy(_command, "ATS302?\r");
     
     // enter command mode
     if( sendCommand(_command, AT_EOL, AT_ERROR, 1000) != 1)
@@ -600,7 +606,7 @@ uint8_t arduPiSigfox::send(uint8_t* data, uint16_t length)
     }
     
     // convert from binary to ASCII
-    Utils.hex2str(data, ascii_command, length);
+    Utils.hexEncode(data, length, ascii_command, sizeof(ascii_command));
     
     #if DEBUG_SIGFOX > 1
         printf("[debug] ");
@@ -699,7 +705,7 @@ uint8_t arduPiSigfox::sendACK(uint8_t* data, uint16_t length)
     }
     
     // convert from binary to ASCII
-    Utils.hex2str(data, ascii_command, length);
+    Utils.hexEncode(data, length, ascii_command, sizeof(ascii_command));
     
     #if DEBUG_SIGFOX > 1
         printf("[debug] ");
@@ -835,7 +841,10 @@ uint8_t arduPiSigfox::sendKeepAlive()
 uint8_t arduPiSigfox::sendKeepAlive(uint8_t period)
 {
     // create "ATS300=<period>" command
-    snprintf(_command, sizeof(_command),"ATS300=%u\r", period);
+    if (snprintf(_command, sizeof(_command),"ATS300=%u\r", period) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     // set frequency setting
     if( sendCommand(_command, AT_OK, AT_ERROR, 10000) != 1)
@@ -863,7 +872,10 @@ uint8_t arduPiSigfox::continuosWave(uint32_t freq, bool enable)
     char param1[20];
         
     // create "AT$CW=<enable>" command
-    snprintf(_command, sizeof(_command),"ATS900=%lu\r", freq);
+    if (snprintf(_command, sizeof(_command),"ATS900=%lu\r", freq) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     // set frequency setting
     if( sendCommand(_command, AT_OK, AT_ERROR, 500) != 1)
@@ -902,7 +914,10 @@ uint8_t arduPiSigfox::continuosWave(uint32_t freq, bool enable)
 uint8_t arduPiSigfox::setAddressLAN(uint32_t naddress)
 {
     uint8_t status; 
-    snprintf( _command, sizeof(_command), "ATS400=%lu\r", naddress);
+    if (snprintf( _command, sizeof(_command), "ATS400=%lu\r", naddress) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     status = sendCommand(_command, AT_OK, AT_ERROR, 1000);
     if( status == 1 )
@@ -979,7 +994,10 @@ uint8_t arduPiSigfox::setMask(uint32_t nmask)
 {
     uint8_t status; 
     
-    snprintf(_command,sizeof(_command),"ATS401=%lu\r",nmask);
+    if (snprintf(_command,sizeof(_command),"ATS401=%lu\r",nmask) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     status = sendCommand(_command, AT_OK, AT_ERROR, 500);
     if( status == 1 )
@@ -1055,7 +1073,10 @@ uint8_t arduPiSigfox::getMask()
 uint8_t arduPiSigfox::setFrequency(uint32_t freq)
 {
     uint8_t status; 
-    snprintf(_command, sizeof(_command), "ATS403=%lu\r", freq);
+    if (snprintf(_command, sizeof(_command), "ATS403=%lu\r", freq) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     status = sendCommand(_command, AT_OK, AT_ERROR, 1000);
     if( status == 1 )
@@ -1131,7 +1152,10 @@ uint8_t arduPiSigfox::getFrequency()
 uint8_t arduPiSigfox::setPowerLAN(int power)
 {
     uint8_t status; 
-    snprintf(_command, sizeof(_command), "ATS404=%d\r", power);
+    if (snprintf(_command, sizeof(_command), "ATS404=%d\r", power) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     status = sendCommand(_command, AT_OK, AT_ERROR, 1000);
     if( status == 1 )
@@ -1209,8 +1233,11 @@ uint8_t arduPiSigfox::sendLAN(uint8_t* data, uint16_t length)
 {   
     //conversion to string
     char buffer[35];
-    memset(buffer, 0x00, sizeof(buffer));
-    Utils.hex2str(data, buffer, length);
+    
+    if (Utils.hexEncode(data, length, buffer, sizeof(buffer)) == 0)
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     return sendLAN(buffer);
 } 
@@ -1272,9 +1299,10 @@ uint8_t arduPiSigfox::sendLAN(char* data)
  */
 uint8_t arduPiSigfox::parsePacketLAN()
 {
+    char* saveptr;
     char* pch;  
     
-    pch = strtok((char*) _buffer,"\r\n+RX_LAN=");
+    pch = strtok_r((char*) _buffer,"\r\n+RX_LAN=", &saveptr);
     if (pch != NULL)
     {
         memset(_packet, 0x00, sizeof(_packet));
@@ -1300,7 +1328,10 @@ uint8_t arduPiSigfox::receive(uint32_t wait)
 {   
     uint8_t status; 
     
-    snprintf(_command, sizeof(_command), "AT$RL=1,%lu\r", wait);
+    if (snprintf(_command, sizeof(_command), "AT$RL=1,%lu\r", wait) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     status = sendCommand(_command, (char*)"\r\n", AT_ERROR, wait*1001);
     
@@ -1499,7 +1530,10 @@ uint8_t arduPiSigfox::setMacroChannelBitmask(char* bitmask)
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), (char *)"ATS306=%s\r", bitmask);
+    if (snprintf(_command, sizeof(_command), (char *)"ATS306=%s\r", bitmask) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     // 1. send command
     answer = sendCommand(_command, AT_OK, AT_ERROR, 1000);  
@@ -1538,7 +1572,7 @@ uint8_t arduPiSigfox::getMacroChannelBitmask()
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), (char *)"ATS306?\r");
+    strcpy(_command, "ATS306?\r");
     
     // enter command mode
     if (sendCommand(_command, AT_EOL, AT_ERROR, 1000) != 1)
@@ -1585,7 +1619,10 @@ uint8_t arduPiSigfox::setMacroChannel(uint8_t config)
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), (char *)"ATS307=%u\r", config);
+    if (snprintf(_command, sizeof(_command), (char *)"ATS307=%u\r", config) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
     
     // 1. send command
     answer = sendCommand(_command, AT_OK, AT_ERROR, 1000);  
@@ -1623,7 +1660,7 @@ uint8_t arduPiSigfox::getMacroChannel()
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), (char *)"ATS307?\r");
+    strcpy(_command, "ATS307?\r");
     
     // enter command mode
     if (sendCommand(_command, AT_EOL, AT_ERROR, 1000) != 1)
@@ -1668,7 +1705,10 @@ uint8_t arduPiSigfox::setDownFreqOffset(int32_t offset)
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), (char *)"ATS308=%li\r", offset);
+    if (snprintf(_command, sizeof(_command), (char *)"ATS308=%li\r", offset) >= (int)sizeof(_command))
+    {
+        return SIGFOX_ANSWER_ERROR;
+    }
 
     // 1. send command
     answer = sendCommand(_command, AT_OK, AT_ERROR, 1000);  
@@ -1706,7 +1746,7 @@ uint8_t arduPiSigfox::getDownFreqOffset()
 {
     uint8_t answer;
     
-    snprintf(_command, sizeof(_command), (char *)"ATS308?\r");
+    strcpy(_command, "ATS308?\r");
     
     // enter command mode
     if (sendCommand(_command, AT_EOL, AT_ERROR, 1000) != 1)
@@ -1735,6 +1775,6 @@ uint8_t arduPiSigfox::getDownFreqOffset()
 
 // Preinstantiate Objects /////////////////////////////////////////////////////
 
-arduPiSigfox Sigfox = arduPiSigfox();
+arduPiSigfox Sigfox;
 
 ///////////////////////////////////////////////////////////////////////////////